@@ -92,9 +92,11 @@ extension_strings = Extension("vaex.superstrings", [os.path.relpath(os.path.join
                                )
 extension_superutils = Extension("vaex.superutils", [
         os.path.relpath(os.path.join(dirname, "src/hash_object.cpp")),
+        os.path.relpath(os.path.join(dirname, "src/hash_combined.cpp")),
         os.path.relpath(os.path.join(dirname, "src/hash_primitives.cpp")),
         os.path.relpath(os.path.join(dirname, "src/superutils.cpp")),
         os.path.relpath(os.path.join(dirname, "src/hash_string.cpp")),
+        os.path.relpath(os.path.join(dirname, "src/sort.cpp")),
     ],
     include_dirs=[
         get_numpy_include(), get_pybind_include(),
@@ -1,9 +1,17 @@
+#ifndef VAEX_AGG_H
+#define VAEX_AGG_H
+
 #include <vector>
 #include <string>
+#include <limits>
+#include <algorithm>
+#include <memory>
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include "superstring.hpp"
+#include "thread_pool.hpp"
+#include "hash.hpp"
 
 namespace py = pybind11;
 
@@ -22,6 +30,8 @@ T _to_native(T value_non_native) {
 
 
 const int INDEX_BLOCK_SIZE = 1024;
+// number of cells a worker takes at once when reducing grids
+const int REDUCE_BLOCK_SIZE = 1024 * 16;
 const int MAX_DIM = 16;
 typedef uint64_t default_index_type;
 
@@ -33,6 +43,12 @@ public:
     virtual void to_bins(uint64_t offset, default_index_type* output, uint64_t length, uint64_t stride) = 0;
     virtual uint64_t size() = 0;
     virtual uint64_t shape() = 0;
+    // for binners that assign bins while binning (see BinnerHash), each thread has its own copy which should be
+    // reconciled: adds the bins of other to this binner, and returns for each bin of other the bin in this binner,
+    // bins beyond the returned mapping are the same, so an empty mapping means the bins already agree
+    virtual std::vector<uint64_t> merge_bins(Binner& other) {
+        return std::vector<uint64_t>();
+    }
     std::string expression;
 };
 
@@ -43,13 +59,70 @@ public:
     virtual bool can_release_gil() {
         return true;
     };
+    // bins and aggregates rows [begin, end) in a single pass, without the index buffer
+    // returns false when there is no fused kernel for these binners, so the generic path is used
+    virtual bool bin_fused(std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+        return false;
+    }
+    // sparse grids: makes sure we have state for length cells, new cells are empty
+    virtual void grow(size_t length) {
+        throw std::runtime_error("aggregator does not support sparse grids");
+    }
+    // sparse grids: moves cell i to cell mapping[i] in a grid of length cells
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        throw std::runtime_error("aggregator does not support sparse grids");
+    }
 };
 
+// calls f(begin, end) for ranges of cells in [0, length), in parallel and without the GIL for large grids
+// since cells are independent, reducing per range of cells needs no synchronization, and a block of
+// the target stays in cache while all others are added to it
+template<class F>
+void for_each_cell_range(size_t length, F f) {
+    ThreadPool& pool = default_thread_pool();
+    size_t block_count = (length + REDUCE_BLOCK_SIZE - 1) / REDUCE_BLOCK_SIZE;
+    size_t worker_count = std::min(pool.thread_count(), block_count);
+    if(worker_count <= 1) {
+        f(0, length);
+        return;
+    }
+    std::unique_ptr<py::gil_scoped_release> release;
+    if(PyGILState_Check()) {
+        release.reset(new py::gil_scoped_release());
+    }
+    WorkStealingRange range(length, REDUCE_BLOCK_SIZE, worker_count);
+    pool.run(worker_count, [&](size_t worker) {
+        uint64_t begin, end;
+        while(range.next(worker, begin, end)) {
+            f(begin, end);
+        }
+    });
+}
+
+template<class Op, class T>
+inline void reduce_block(T* __restrict target, const T* __restrict source, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        Op::apply(target[i], source[i]);
+    }
+}
+
+// reduces the grid_data of others into that of agg element wise using Op::apply
+template<class Op, class Agg, class Other>
+void reduce_grid_data(Agg* agg, std::vector<Other*>& others) {
+    for_each_cell_range(agg->grid->length1d, [&](size_t begin, size_t end) {
+        for(auto other : others) {
+            reduce_block<Op>(agg->grid_data + begin, other->grid_data + begin, end - begin);
+        }
+    });
+}
+
 template<class IndexType=default_index_type>
 class Grid {
 public:
     using index_type = IndexType;
-    Grid(std::vector<Binner*> binners) : binners(binners) {
+    // A sparse grid only keeps state for the cells (combinations of bins) that occur, which are
+    // numbered in order of appearance, length1d is then the number of cells seen so far.
+    Grid(std::vector<Binner*> binners, bool sparse=false) : binners(binners), sparse(sparse) {
         indices1d = (IndexType*)malloc(INDEX_BLOCK_SIZE * sizeof(IndexType));
         dimensions = binners.size();
         shapes = new uint64_t[dimensions];
@@ -57,6 +130,12 @@ public:
         length1d = 1;
         for(size_t i =  0; i < dimensions; i++) {
             shapes[i] = binners[i]->shape();
+            if(sparse && shapes[i] > 0 && length1d > std::numeric_limits<IndexType>::max() / shapes[i]) {
+                delete[] strides;
+                delete[] shapes;
+                free(indices1d);
+                throw std::runtime_error("too many bins for a sparse grid, the bin index would overflow");
+            }
             length1d *= shapes[i];
         }
         if(dimensions > 0) {
@@ -65,6 +144,9 @@ public:
                 strides[i] = strides[i-1] * shapes[i-1];
             }
         }
+        if(sparse) {
+            length1d = 0;
+        }
     }
     virtual ~Grid() {
         free(indices1d);
@@ -102,37 +184,114 @@ public:
             }
     }
     void bin_(std::vector<Aggregator*> aggregators, size_t length) {
+        this->bin_range(aggregators, 0, length, indices1d);
+    }
+    // bins rows [begin, end) using the indices buffer, which should hold INDEX_BLOCK_SIZE elements
+    void bin_range(std::vector<Aggregator*>& aggregators, uint64_t begin, uint64_t end, index_type* indices) {
         size_t binner_count = binners.size();
         size_t aggregator_count = aggregators.size();
-        uint64_t offset = 0;
-        bool done = false;
-        while(!done) {
-            uint64_t leftover = length - offset;
-            if(leftover < INDEX_BLOCK_SIZE) {
-                std::fill(indices1d, indices1d+leftover, 0);
-                for(size_t i = 0; i < binner_count; i++) {
-                    binners[i]->to_bins(offset, indices1d, leftover, this->strides[i]);
-                }
-            } else {
-                std::fill(indices1d, indices1d+INDEX_BLOCK_SIZE, 0);
-                for(size_t i = 0; i < binner_count; i++) {
-                    binners[i]->to_bins(offset, indices1d, INDEX_BLOCK_SIZE, this->strides[i]);
-                }
+        // with multiple aggregators, the bins are computed once and shared via the index buffer
+        if(aggregator_count == 1 && !sparse && aggregators[0]->bin_fused(binners, this->strides, begin, end)) {
+            return;
+        }
+        uint64_t offset = begin;
+        while(offset < end) {
+            uint64_t leftover = end - offset;
+            uint64_t block_length = leftover < INDEX_BLOCK_SIZE ? leftover : INDEX_BLOCK_SIZE;
+            std::fill(indices, indices+block_length, 0);
+            for(size_t i = 0; i < binner_count; i++) {
+                binners[i]->to_bins(offset, indices, block_length, this->strides[i]);
             }
-            if(leftover < INDEX_BLOCK_SIZE) {
+            if(sparse) {
+                this->to_cells(indices, block_length);
                 for(size_t i = 0; i < aggregator_count; i++) {
-                    aggregators[i]->aggregate(indices1d, leftover, offset);
+                    aggregators[i]->grow(length1d);
                 }
-            } else {
-                for(size_t i = 0; i < aggregator_count; i++) {
-                    aggregators[i]->aggregate(indices1d, INDEX_BLOCK_SIZE, offset);
+            }
+            for(size_t i = 0; i < aggregator_count; i++) {
+                aggregators[i]->aggregate(indices, block_length, offset);
+            }
+            offset += block_length;
+        }
+    }
+    // sparse grids: gives the cell for a (dense) bin index, adding a new cell when needed
+    index_type cell(index_type index) {
+        auto search = cells.find(index);
+        if(search == cells.end()) {
+            index_type cell = cell_indices.size();
+            cells.insert({index, cell});
+            cell_indices.push_back(index);
+            length1d = cell_indices.size();
+            return cell;
+        }
+        return search->second;
+    }
+    // sparse grids: replaces the bin indices by cells
+    void to_cells(index_type* indices, uint64_t length) {
+        for(uint64_t i = 0; i < length; i++) {
+            indices[i] = this->cell(indices[i]);
+        }
+    }
+    // sparse grids: adds the cells of other to this grid, and returns for each cell of other
+    // the corresponding cell in this grid
+    std::vector<uint64_t> align(Grid& other) {
+        if(!sparse || !other.sparse) {
+            throw std::runtime_error("can only align sparse grids");
+        }
+        if(other.dimensions != dimensions || !std::equal(shapes, shapes + dimensions, other.shapes)) {
+            throw std::runtime_error("cannot align grids with different shapes");
+        }
+        std::vector<std::vector<uint64_t>> bin_mappings(dimensions);
+        bool same_bins = true;
+        for(size_t d = 0; d < dimensions; d++) {
+            bin_mappings[d] = binners[d]->merge_bins(*other.binners[d]);
+            same_bins = same_bins && bin_mappings[d].empty();
+        }
+        std::vector<uint64_t> mapping(other.cell_indices.size());
+        for(size_t i = 0; i < mapping.size(); i++) {
+            index_type index = other.cell_indices[i];
+            if(!same_bins) {
+                index_type index_other = index;
+                index = 0;
+                for(size_t d = 0; d < dimensions; d++) {
+                    uint64_t bin = (index_other / strides[d]) % shapes[d];
+                    if(bin < bin_mappings[d].size()) {
+                        bin = bin_mappings[d][bin];
+                    }
+                    index += bin * strides[d];
                 }
             }
-            offset += (leftover < INDEX_BLOCK_SIZE) ? leftover :  INDEX_BLOCK_SIZE;
-            done = offset == length;
+            mapping[i] = this->cell(index);
         }
+        return mapping;
+    }
+    // sparse grids: adds a cell for each combination of bins (columns of bins, a row per dimension), in order
+    std::vector<uint64_t> add_cells(const std::vector<std::vector<int64_t>>& bins) {
+        if(!sparse) {
+            throw std::runtime_error("can only add cells to sparse grids");
+        }
+        if(bins.size() != dimensions) {
+            throw std::runtime_error("expected bins for each dimension");
+        }
+        size_t count = dimensions > 0 ? bins[0].size() : 0;
+        std::vector<uint64_t> result(count);
+        for(size_t j = 0; j < count; j++) {
+            index_type index = 0;
+            for(size_t i = 0; i < dimensions; i++) {
+                if(bins[i].size() != count || bins[i][j] < 0 || (uint64_t)bins[i][j] >= shapes[i]) {
+                    throw std::runtime_error("bin out of range");
+                }
+                index += bins[i][j] * strides[i];
+            }
+            result[j] = this->cell(index);
+        }
+        return result;
     }
     std::vector<Binner*> binners;
+    bool sparse;
+    // sparse grids: bin index to cell, and the reverse
+    hashmap<index_type, index_type> cells;
+    std::vector<index_type> cell_indices;
     index_type *indices1d;
     uint64_t* strides;
     uint64_t* shapes;
@@ -140,24 +299,63 @@ public:
     size_t length1d;
 };
 
+// sparse grids: helpers for aggregators to grow or remap (see Aggregator::remap) a malloc'ed array with a value per cell
+template<class T>
+void grow_cells(T*& data, size_t length, size_t new_length, T fill_value) {
+    T* new_data = (T*)realloc(data, sizeof(T) * new_length);
+    if(new_data == nullptr) {
+        throw std::bad_alloc();
+    }
+    data = new_data;
+    std::fill(data+length, data+new_length, fill_value);
+}
+
+template<class T>
+void remap_cells(T*& data, const std::vector<uint64_t>& mapping, size_t length, T fill_value) {
+    T* new_data = (T*)malloc(sizeof(T) * std::max<size_t>(length, 1));
+    if(new_data == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::fill(new_data, new_data+length, fill_value);
+    for(size_t i = 0; i < mapping.size(); i++) {
+        new_data[mapping[i]] = data[i];
+    }
+    free(data);
+    data = new_data;
+}
+
 template<class GridType=double, class IndexType=default_index_type>
 class AggregatorBase : public Aggregator {
 public:
     using index_type = IndexType;
     using grid_type = GridType;
-    AggregatorBase(Grid<IndexType>* grid, grid_type fill_value) : grid(grid) {
+    AggregatorBase(Grid<IndexType>* grid, grid_type fill_value) : grid(grid), grid_length(grid->length1d), fill_value(fill_value) {
         grid_data = (grid_type*)malloc(sizeof(grid_type) * grid->length1d);
         std::fill(grid_data, grid_data+grid->length1d, fill_value);
     }
-    AggregatorBase(Grid<IndexType>* grid) : grid(grid) {
+    AggregatorBase(Grid<IndexType>* grid) : grid(grid), grid_length(grid->length1d), fill_value(0) {
         grid_data = (grid_type*)malloc(sizeof(grid_type) * grid->length1d);
         std::fill(grid_data, grid_data+grid->length1d, 0);
     }
     virtual ~AggregatorBase() {
         free(grid_data);
     }
+    virtual void grow(size_t length) {
+        if(length > grid_length) {
+            // grow geometrically, since a sparse grid gets new cells one block at a time
+            size_t new_length = std::max(length, grid_length * 2);
+            grow_cells(grid_data, grid_length, new_length, fill_value);
+            grid_length = new_length;
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        remap_cells(grid_data, mapping, length, fill_value);
+        grid_length = length;
+    }
     Grid<IndexType>* grid;
     grid_type* grid_data;
+    size_t grid_length; // number of cells allocated, can be larger than grid->length1d for sparse grids
+    grid_type fill_value;
 };
 
 template<class GridType, class IndexType=default_index_type>
@@ -201,7 +399,105 @@ public:
     uint64_t data_mask_size;
 };
 
+// Calls agg.reduce(others), but for sparse grids, we first add the cells of the grids of others
+// to our grid, and make the cells of others line up with ours, so they can be reduced element wise.
+// This leaves others in a state that is only useful for reducing.
+template<class Agg>
+void reduce_aligned(Agg& agg, std::vector<Agg*> others) {
+    if(agg.grid->sparse) {
+        std::vector<std::vector<uint64_t>> mappings;
+        for(auto other : others) {
+            if(other->grid != agg.grid) {
+                mappings.push_back(agg.grid->align(*other->grid));
+            } else {
+                mappings.push_back(std::vector<uint64_t>());
+            }
+        }
+        size_t length = agg.grid->length1d;
+        for(size_t i = 0; i < others.size(); i++) {
+            if(others[i]->grid != agg.grid) {
+                others[i]->remap(mappings[i], length);
+            } else {
+                others[i]->grow(length);
+            }
+        }
+        agg.grow(length);
+    }
+    agg.reduce(others);
+}
+
+// moves the state of agg to a new grid, where cell i goes to cell mapping[i], this is used when the shape of
+// the grid changes (e.g. when new groups appear in an incremental groupby)
+template<class Agg>
+void regrid(Agg& agg, Grid<>* grid, std::vector<uint64_t> mapping) {
+    if(mapping.size() != agg.grid->length1d) {
+        throw std::runtime_error("mapping should have an entry for each cell");
+    }
+    for(auto cell : mapping) {
+        if(cell >= grid->length1d) {
+            throw std::runtime_error("mapping refers to a cell outside of the grid");
+        }
+    }
+    agg.remap(mapping, grid->length1d);
+    agg.grid = grid;
+}
 
+// same as reduce_aligned, but also writes the result to out, which should have the same memory layout as the
+// grid (the first dimension varies fastest, see grid_buffer_info), so the caller can reduce multiple aggregators
+// into a single array
+template<class Agg>
+void reduce_aligned_into(Agg& agg, std::vector<Agg*> others, py::buffer out) {
+    typedef typename Agg::grid_type grid_type;
+    py::buffer_info info = out.request(true);
+    if(info.itemsize != sizeof(grid_type)) {
+        throw std::runtime_error("output buffer has the wrong itemsize");
+    }
+    ssize_t stride = info.itemsize;
+    for(ssize_t i = 0; i < info.ndim; i++) {
+        if(info.shape[i] > 1 && info.strides[i] != stride) {
+            throw std::runtime_error("output buffer should be Fortran contiguous");
+        }
+        stride *= info.shape[i];
+    }
+    // check everything before we merge, since a failed reduce leaves the others merged into agg
+    if(info.size != (ssize_t)agg.grid->length1d) {
+        throw std::runtime_error("output buffer has the wrong size");
+    }
+    reduce_aligned(agg, others);
+    grid_type* output = (grid_type*)info.ptr;
+    for_each_cell_range(agg.grid->length1d, [&](size_t begin, size_t end) {
+        std::copy(agg.grid_data + begin, agg.grid_data + end, output + begin);
+    });
+}
 
+// describes the grid of an aggregator as a buffer, which is 1d (a value per cell) for sparse grids
+template<class Agg>
+py::buffer_info grid_buffer_info(Agg &agg) {
+    if(agg.grid->sparse) {
+        agg.grow(agg.grid->length1d);
+        return py::buffer_info(
+            agg.grid_data,
+            sizeof(typename Agg::grid_type),
+            py::format_descriptor<typename Agg::grid_type>::format(),
+            1,
+            {(ssize_t)agg.grid->length1d},
+            {(ssize_t)sizeof(typename Agg::grid_type)}
+        );
+    }
+    std::vector<ssize_t> strides(agg.grid->dimensions);
+    std::vector<ssize_t> shapes(agg.grid->dimensions);
+    std::copy(&agg.grid->shapes[0], &agg.grid->shapes[agg.grid->dimensions], &shapes[0]);
+    std::transform(&agg.grid->strides[0], &agg.grid->strides[agg.grid->dimensions], &strides[0], [](uint64_t x) { return x*sizeof(typename Agg::grid_type); } );
+    return py::buffer_info(
+        agg.grid_data,                               /* Pointer to buffer */
+        sizeof(typename Agg::grid_type),                 /* Size of one scalar */
+        py::format_descriptor<typename Agg::grid_type>::format(), /* Python struct-style format descriptor */
+        agg.grid->dimensions,                       /* Number of dimensions */
+        shapes,                 /* Buffer dimensions */
+        strides
+    );
+}
 
 }
+
+#endif
@@ -1,5 +1,6 @@
 #include "agg.hpp"
 #include "hash_primitives.cpp"
+#include "hyperloglog.hpp"
 
 namespace vaex {
 
@@ -12,28 +13,58 @@ public:
     using data_type = DataType;
     AggNUnique(Grid<IndexType>* grid, bool dropmissing, bool dropnan) : grid(grid), grid_data(nullptr), data_ptr(nullptr), data_mask_ptr(nullptr), selection_mask_ptr(nullptr), dropmissing(dropmissing), dropnan(dropnan) {
         counters = new counter<data_type>[grid->length1d];
+        counters_length = grid->length1d;
     }
     virtual ~AggNUnique() {
         if(grid_data)
             free(grid_data);
         delete[] counters;
     }
+    virtual void grow(size_t length) {
+        if(length > counters_length) {
+            size_t new_length = std::max(length, counters_length * 2);
+            counter<data_type>* new_counters = new counter<data_type>[new_length];
+            for(size_t i = 0; i < counters_length; i++) {
+                std::swap(new_counters[i], counters[i]);
+            }
+            delete[] counters;
+            counters = new_counters;
+            counters_length = new_length;
+            if(grid_data) {
+                free(grid_data);
+                grid_data = nullptr;
+            }
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        counter<data_type>* new_counters = new counter<data_type>[length];
+        for(size_t i = 0; i < mapping.size(); i++) {
+            std::swap(new_counters[mapping[i]], counters[i]);
+        }
+        delete[] counters;
+        counters = new_counters;
+        counters_length = length;
+        if(grid_data) {
+            free(grid_data);
+            grid_data = nullptr;
+        }
+    }
     virtual void reduce(std::vector<Type*> others) {
         if(grid_data == nullptr) {
             grid_data = (grid_type*)malloc(sizeof(grid_type) * grid->length1d);
         }
-        for(size_t i = 0; i < this->grid->length1d; i++) {
-            for(auto other: others) {
-                this->counters[i].merge(other->counters[i]);
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                for(auto other: others) {
+                    this->counters[i].merge(other->counters[i]);
+                }
+                grid_data[i] = counters[i].size();
+                if(!dropmissing)
+                    grid_data[i] += counters[i].null_count;
+                if(!dropnan)
+                    grid_data[i] += counters[i].nan_count;
             }
-            grid_data[i] = counters[i].map.size();
-            if(!dropmissing)
-                grid_data[i] += counters[i].null_count;
-            if(!dropnan)
-                grid_data[i] += counters[i].nan_count;
-            
-        }
-
+        });
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->data_ptr == nullptr) {
@@ -85,6 +116,7 @@ public:
     Grid<IndexType>* grid;
     grid_type* grid_data;
     counter<data_type>* counters;
+    size_t counters_length;
     data_type* data_ptr;
     uint64_t data_size;
     uint8_t* data_mask_ptr;
@@ -95,25 +127,56 @@ public:
     bool dropnan;
 };
 
+template<class DataType=double, class GridType=uint64_t, class IndexType=default_index_type, bool FlipEndian=false>
+class AggApproxNUnique : public AggApproxNUniqueBase<GridType, IndexType> {
+public:
+    using Base = AggApproxNUniqueBase<GridType, IndexType>;
+    using Type = AggApproxNUnique<DataType, GridType, IndexType, FlipEndian>;
+    using data_type = DataType;
+    AggApproxNUnique(Grid<IndexType>* grid, bool dropmissing, bool dropnan, int precision) : Base(grid, dropmissing, dropnan, precision), data_ptr(nullptr) {
+    }
+    virtual void reduce(std::vector<Type*> others) {
+        this->reduce_registers(others);
+    }
+    virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
+        if(this->data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
+        }
+        for(size_t j = 0; j < length; j++) {
+            if(this->selection_mask_ptr && this->selection_mask_ptr[j+offset] == 0)
+                continue; // if value is not in selection/filter, don't even consider it
+            IndexType i = indices1d[j];
+            if(this->data_mask_ptr && this->data_mask_ptr[j+offset] == 0) {
+                this->flags[i] |= Base::FLAG_NULL;
+            } else {
+                data_type value = this->data_ptr[j+offset];
+                if(FlipEndian)
+                    value = _to_native(value);
+                if(value != value) // nan
+                    this->flags[i] |= Base::FLAG_NAN;
+                else
+                    hll_add(this->registers + i * this->register_count, this->precision, hash_value64(value));
+            }
+        }
+    }
+    void set_data(py::buffer ar, size_t index) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_ptr = (data_type*)info.ptr;
+        this->data_size = info.shape[0];
+    }
+    data_type* data_ptr;
+    uint64_t data_size;
+};
+
 
 template<class Agg, class Base, class Module>
 void add_agg(Module m, Base& base, const char* class_name) {
     py::class_<Agg>(m, class_name, py::buffer_protocol(), base)
         .def(py::init<Grid<>*, bool, bool>(), py::keep_alive<1, 2>())
-        .def_buffer([](Agg &agg) -> py::buffer_info {
-            std::vector<ssize_t> strides(agg.grid->dimensions);
-            std::vector<ssize_t> shapes(agg.grid->dimensions);
-            std::copy(&agg.grid->shapes[0], &agg.grid->shapes[agg.grid->dimensions], &shapes[0]);
-            std::transform(&agg.grid->strides[0], &agg.grid->strides[agg.grid->dimensions], &strides[0], [](uint64_t x) { return x*sizeof(typename Agg::grid_type); } );
-            return py::buffer_info(
-                agg.grid_data,                               /* Pointer to buffer */
-                sizeof(typename Agg::grid_type),                 /* Size of one scalar */
-                py::format_descriptor<typename Agg::grid_type>::format(), /* Python struct-style format descriptor */
-                agg.grid->dimensions,                       /* Number of dimensions */
-                shapes,                 /* Buffer dimensions */
-                strides
-            );
-        })
+        .def_buffer(&grid_buffer_info<Agg>)
         .def_property_readonly("grid", [](const Agg &agg) {
                 return agg.grid;
             }
@@ -121,7 +184,9 @@ void add_agg(Module m, Base& base, const char* class_name) {
         .def("set_data", &Agg::set_data)
         .def("set_data_mask", &Agg::set_data_mask)
         .def("set_selection_mask", &Agg::set_selection_mask)
-        .def("reduce", &Agg::reduce)
+        .def("reduce", &reduce_aligned<Agg>)
+        .def("reduce", &reduce_aligned_into<Agg>)
+        .def("regrid", &regrid<Agg>, py::keep_alive<1, 2>())
     ;
 }
 
@@ -130,6 +195,7 @@ template<class T, class Base, class Module, bool FlipEndian=false>
 void add_agg_primitives_(Module m, Base& base, std::string postfix) {
     // add_agg<AggCount<T, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggCount_" + postfix).c_str());
     add_agg<AggNUnique<T, uint64_t, default_index_type, FlipEndian>>(m, base, ("AggNUnique_" + postfix).c_str());
+    add_agg_approx_nunique<AggApproxNUnique<T, uint64_t, default_index_type, FlipEndian>>(m, base, ("AggApproxNUnique_" + postfix).c_str());
 }
 template<class T, class Base, class Module>
 void add_agg_primitives(Module m, Base& base, std::string postfix) {
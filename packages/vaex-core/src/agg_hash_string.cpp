@@ -1,5 +1,6 @@
 #include "agg.hpp"
 #include "hash_string.cpp"
+#include "hyperloglog.hpp"
 
 namespace vaex {
 
@@ -11,26 +12,56 @@ public:
     using grid_type = GridType;
     AggStringNUnique(Grid<IndexType>* grid, bool dropmissing, bool dropnan) : grid(grid), grid_data(nullptr), string_sequence(nullptr), data_mask_ptr(nullptr), selection_mask_ptr(nullptr), dropmissing(dropmissing), dropnan(dropnan) {
         counters = new counter<>[grid->length1d];
+        counters_length = grid->length1d;
     }
     virtual ~AggStringNUnique() {
         if(grid_data)
             free(grid_data);
         delete[] counters;
     }
+    virtual void grow(size_t length) {
+        if(length > counters_length) {
+            size_t new_length = std::max(length, counters_length * 2);
+            counter<>* new_counters = new counter<>[new_length];
+            for(size_t i = 0; i < counters_length; i++) {
+                std::swap(new_counters[i], counters[i]);
+            }
+            delete[] counters;
+            counters = new_counters;
+            counters_length = new_length;
+            if(grid_data) {
+                free(grid_data);
+                grid_data = nullptr;
+            }
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        counter<>* new_counters = new counter<>[length];
+        for(size_t i = 0; i < mapping.size(); i++) {
+            std::swap(new_counters[mapping[i]], counters[i]);
+        }
+        delete[] counters;
+        counters = new_counters;
+        counters_length = length;
+        if(grid_data) {
+            free(grid_data);
+            grid_data = nullptr;
+        }
+    }
     virtual void reduce(std::vector<Type*> others) {
         if(grid_data == nullptr)
             grid_data = (grid_type*)malloc(sizeof(grid_type) * grid->length1d);
-        for(size_t i = 0; i < this->grid->length1d; i++) {
-            for(auto other: others) {
-                this->counters[i].merge(other->counters[i]);
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                for(auto other: others) {
+                    this->counters[i].merge(other->counters[i]);
+                }
+                if(dropmissing)
+                    grid_data[i] = counters[i].map.size();
+                else
+                    grid_data[i] = counters[i].map.size() + counters[i].null_count;
             }
-            if(dropmissing)
-                grid_data[i] = counters[i].map.size();
-            else
-                grid_data[i] = counters[i].map.size() + counters[i].null_count;
-            
-        }
-
+        });
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->string_sequence == nullptr) {
@@ -47,8 +78,9 @@ public:
             if(masked) {
                 this->counters[indices1d[j]].update1_null();
             } else {
-                string s = this->string_sequence->get(j+offset);
-                this->counters[indices1d[j]].update1(s);
+                auto& counter = this->counters[indices1d[j]];
+                string_view value = this->string_sequence->view(j+offset);
+                counter.update1(value, counter.hash_of(this->string_sequence, j+offset, value), 0);
             }
         }
     }
@@ -75,6 +107,7 @@ public:
     Grid<IndexType>* grid;
     grid_type* grid_data;
     counter<>* counters;
+    size_t counters_length;
     StringSequence* string_sequence;
     uint8_t* data_mask_ptr;
     uint64_t data_mask_size;
@@ -84,25 +117,45 @@ public:
     bool dropnan; // not used for strings
 };
 
+template<class GridType=uint64_t, class IndexType=default_index_type>
+class AggStringApproxNUnique : public AggApproxNUniqueBase<GridType, IndexType> {
+public:
+    using Base = AggApproxNUniqueBase<GridType, IndexType>;
+    using Type = AggStringApproxNUnique<GridType, IndexType>;
+    AggStringApproxNUnique(Grid<IndexType>* grid, bool dropmissing, bool dropnan, int precision) : Base(grid, dropmissing, dropnan, precision), string_sequence(nullptr) {
+    }
+    virtual void reduce(std::vector<Type*> others) {
+        this->reduce_registers(others);
+    }
+    virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
+        if(this->string_sequence == nullptr) {
+            throw std::runtime_error("string_sequence not set");
+        }
+        for(size_t j = 0; j < length; j++) {
+            if(this->selection_mask_ptr && this->selection_mask_ptr[j+offset] == 0)
+                continue; // if value is not in selection/filter, don't even consider it
+            IndexType i = indices1d[j];
+            if((this->data_mask_ptr && this->data_mask_ptr[j+offset] == 0) || this->string_sequence->is_null(j+offset)) {
+                this->flags[i] |= Base::FLAG_NULL;
+            } else {
+                const uint64_t* hashes = this->string_sequence->hashes;
+                auto s = this->string_sequence->view(j+offset);
+                hll_add(this->registers + i * this->register_count, this->precision, hashes ? hashes[j+offset] : hash_bytes(s.data(), s.length()));
+            }
+        }
+    }
+    void set_data(StringSequence* string_sequence, size_t index) {
+        this->string_sequence = string_sequence;
+    }
+    StringSequence* string_sequence;
+};
+
 
 template<class Agg, class Base, class Module>
 void add_agg(Module m, Base& base, const char* class_name) {
     py::class_<Agg>(m, class_name, py::buffer_protocol(), base)
         .def(py::init<Grid<>*, bool, bool>(), py::keep_alive<1, 2>())
-        .def_buffer([](Agg &agg) -> py::buffer_info {
-            std::vector<ssize_t> strides(agg.grid->dimensions);
-            std::vector<ssize_t> shapes(agg.grid->dimensions);
-            std::copy(&agg.grid->shapes[0], &agg.grid->shapes[agg.grid->dimensions], &shapes[0]);
-            std::transform(&agg.grid->strides[0], &agg.grid->strides[agg.grid->dimensions], &strides[0], [](uint64_t x) { return x*sizeof(typename Agg::grid_type); } );
-            return py::buffer_info(
-                agg.grid_data,                               /* Pointer to buffer */
-                sizeof(typename Agg::grid_type),                 /* Size of one scalar */
-                py::format_descriptor<typename Agg::grid_type>::format(), /* Python struct-style format descriptor */
-                agg.grid->dimensions,                       /* Number of dimensions */
-                shapes,                 /* Buffer dimensions */
-                strides
-            );
-        })
+        .def_buffer(&grid_buffer_info<Agg>)
         .def_property_readonly("grid", [](const Agg &agg) {
                 return agg.grid;
             }
@@ -110,13 +163,16 @@ void add_agg(Module m, Base& base, const char* class_name) {
         .def("set_data", &Agg::set_data)
         .def("set_data_mask", &Agg::set_data_mask)
         .def("set_selection_mask", &Agg::set_selection_mask)
-        .def("reduce", &Agg::reduce)
+        .def("reduce", &reduce_aligned<Agg>)
+        .def("reduce", &reduce_aligned_into<Agg>)
+        .def("regrid", &regrid<Agg>, py::keep_alive<1, 2>())
     ;
 }
 
 void add_agg_nunique_string(py::module& m, py::class_<Aggregator>& base) {
     std::string postfix = "string";
     add_agg<AggStringNUnique<>>(m, base, ("AggNUnique_" + postfix).c_str());
+    add_agg_approx_nunique<AggStringApproxNUnique<>>(m, base, ("AggApproxNUnique_" + postfix).c_str());
 }
 
 
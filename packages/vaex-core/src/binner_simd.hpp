@@ -0,0 +1,206 @@
+#ifndef VAEX_BINNER_SIMD_H
+#define VAEX_BINNER_SIMD_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// We compile for generic x86-64 (so wheels work everywhere), and compile the AVX2/AVX-512 kernels
+// using function level target attributes, the best one is picked at runtime.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define VAEX_SIMD_X86
+#include <immintrin.h>
+#define VAEX_TARGET_AVX2 __attribute__((target("avx2")))
+#define VAEX_TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+#endif
+
+namespace vaex {
+namespace simd {
+
+enum {
+    LEVEL_NONE = 0,
+    LEVEL_AVX2 = 1,
+    LEVEL_AVX512 = 2
+};
+
+inline int detect_level() {
+    int level = LEVEL_NONE;
+#ifdef VAEX_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        level = LEVEL_AVX512;
+    } else if(__builtin_cpu_supports("avx2")) {
+        level = LEVEL_AVX2;
+    }
+#endif
+    // VAEX_SIMD=0 disables the vectorized kernels, 1 limits it to AVX2 (useful for testing/benchmarking)
+    const char* env = std::getenv("VAEX_SIMD");
+    if(env) {
+        int max_level = std::atoi(env);
+        if(max_level < level)
+            level = max_level;
+    }
+    return level;
+}
+
+inline int level() {
+    static int level = detect_level();
+    return level;
+}
+
+// same as the scalar code in BinnerScalar: nan and masked go to 0, underflow to 1, overflow to the last bin
+inline uint64_t scalar_bin_index(double value, bool masked, double vmin, double scale_v, uint64_t bins) {
+    double scaled = (value - vmin) * scale_v;
+    uint64_t index = 0;
+    if(scaled != scaled || masked) {
+    } else if (scaled < 0) {
+        index = 1;
+    } else if (scaled >= 1) {
+        index = bins-1+3;
+    } else {
+        index = (int)(scaled * (bins)) + 2;
+    }
+    return index;
+}
+
+template<class T>
+inline void to_bins_scalar_tail(const T* data, const uint8_t* mask, uint64_t* output, uint64_t length, uint64_t stride, double vmin, double scale_v, uint64_t bins) {
+    for(uint64_t i = 0; i < length; i++) {
+        bool masked = mask && mask[i] == 1;
+        output[i] += scalar_bin_index((double)data[i], masked, vmin, scale_v, bins) * stride;
+    }
+}
+
+#ifdef VAEX_SIMD_X86
+
+// load 4 values, converted to double
+VAEX_TARGET_AVX2 inline __m256d load4(const double* p) { return _mm256_loadu_pd(p); }
+VAEX_TARGET_AVX2 inline __m256d load4(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+VAEX_TARGET_AVX2 inline __m256d load4(const int64_t* p) { return _mm256_set_pd((double)p[3], (double)p[2], (double)p[1], (double)p[0]); }
+VAEX_TARGET_AVX2 inline __m256d load4(const uint64_t* p) { return _mm256_set_pd((double)p[3], (double)p[2], (double)p[1], (double)p[0]); }
+VAEX_TARGET_AVX2 inline __m256d load4(const int32_t* p) { return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)p)); }
+VAEX_TARGET_AVX2 inline __m256d load4(const uint32_t* p) {
+    // flip the sign bit, convert as signed, and add 2**31 back
+    __m128i flipped = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi32(INT32_MIN));
+    return _mm256_add_pd(_mm256_cvtepi32_pd(flipped), _mm256_set1_pd(2147483648.));
+}
+VAEX_TARGET_AVX2 inline __m128i load4_bytes(const void* p) {
+    int32_t bytes;
+    memcpy(&bytes, p, sizeof(bytes));
+    return _mm_cvtsi32_si128(bytes);
+}
+VAEX_TARGET_AVX2 inline __m128i load4_shorts(const void* p) {
+    int64_t shorts;
+    memcpy(&shorts, p, sizeof(shorts));
+    return _mm_cvtsi64_si128(shorts);
+}
+VAEX_TARGET_AVX2 inline __m256d load4(const int16_t* p) { return _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(load4_shorts(p))); }
+VAEX_TARGET_AVX2 inline __m256d load4(const uint16_t* p) { return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(load4_shorts(p))); }
+VAEX_TARGET_AVX2 inline __m256d load4(const int8_t* p) { return _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(load4_bytes(p))); }
+VAEX_TARGET_AVX2 inline __m256d load4(const uint8_t* p) { return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(load4_bytes(p))); }
+VAEX_TARGET_AVX2 inline __m256d load4(const bool* p) { return load4((const uint8_t*)p); }
+
+// only valid when stride < 2**32 and bins < 2**30, since we multiply using 32 bit integers
+template<class T>
+VAEX_TARGET_AVX2 void to_bins_scalar_avx2(const T* data, const uint8_t* mask, uint64_t* output, uint64_t length, uint64_t stride, double vmin, double scale_v, uint64_t bins) {
+    const __m256d vmin4 = _mm256_set1_pd(vmin);
+    const __m256d scale4 = _mm256_set1_pd(scale_v);
+    const __m256d bins4 = _mm256_set1_pd((double)bins);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.);
+    const __m256d index_underflow = _mm256_set1_pd(1.);
+    const __m256d index_overflow = _mm256_set1_pd((double)(bins-1+3));
+    const __m256d index_offset = _mm256_set1_pd(2.);
+    const __m256i stride4 = _mm256_set1_epi64x(stride);
+    const __m256i masked_value = _mm256_set1_epi64x(1);
+    uint64_t i = 0;
+    for(; i + 4 <= length; i += 4) {
+        __m256d scaled = _mm256_mul_pd(_mm256_sub_pd(load4(data + i), vmin4), scale4);
+        __m256d index = _mm256_round_pd(_mm256_mul_pd(scaled, bins4), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        index = _mm256_add_pd(index, index_offset);
+        index = _mm256_blendv_pd(index, index_overflow, _mm256_cmp_pd(scaled, one, _CMP_GE_OQ));
+        index = _mm256_blendv_pd(index, index_underflow, _mm256_cmp_pd(scaled, zero, _CMP_LT_OQ));
+        __m256d invalid = _mm256_cmp_pd(scaled, scaled, _CMP_UNORD_Q);
+        if(mask) {
+            __m256i mask4 = _mm256_cvtepu8_epi64(load4_bytes(mask + i));
+            invalid = _mm256_or_pd(invalid, _mm256_castsi256_pd(_mm256_cmpeq_epi64(mask4, masked_value)));
+        }
+        // all bits zero is 0.0, which is the nan/masked bin
+        index = _mm256_andnot_pd(invalid, index);
+        __m256i index4 = _mm256_cvtepi32_epi64(_mm256_cvttpd_epi32(index));
+        __m256i out = _mm256_loadu_si256((const __m256i*)(output + i));
+        out = _mm256_add_epi64(out, _mm256_mul_epu32(index4, stride4));
+        _mm256_storeu_si256((__m256i*)(output + i), out);
+    }
+    to_bins_scalar_tail(data + i, mask ? mask + i : nullptr, output + i, length - i, stride, vmin, scale_v, bins);
+}
+
+// load 8 values, converted to double
+VAEX_TARGET_AVX512 inline __m512d load8(const double* p) { return _mm512_loadu_pd(p); }
+VAEX_TARGET_AVX512 inline __m512d load8(const float* p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+VAEX_TARGET_AVX512 inline __m512d load8(const int64_t* p) { return _mm512_cvtepi64_pd(_mm512_loadu_si512(p)); }
+VAEX_TARGET_AVX512 inline __m512d load8(const uint64_t* p) { return _mm512_cvtepu64_pd(_mm512_loadu_si512(p)); }
+VAEX_TARGET_AVX512 inline __m512d load8(const int32_t* p) { return _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)p)); }
+VAEX_TARGET_AVX512 inline __m512d load8(const uint32_t* p) { return _mm512_cvtepu32_pd(_mm256_loadu_si256((const __m256i*)p)); }
+VAEX_TARGET_AVX512 inline __m512d load8(const int16_t* p) { return _mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+VAEX_TARGET_AVX512 inline __m512d load8(const uint16_t* p) { return _mm512_cvtepi32_pd(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+VAEX_TARGET_AVX512 inline __m512d load8(const int8_t* p) { return _mm512_cvtepi32_pd(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+VAEX_TARGET_AVX512 inline __m512d load8(const uint8_t* p) { return _mm512_cvtepi32_pd(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+VAEX_TARGET_AVX512 inline __m512d load8(const bool* p) { return load8((const uint8_t*)p); }
+
+template<class T>
+VAEX_TARGET_AVX512 void to_bins_scalar_avx512(const T* data, const uint8_t* mask, uint64_t* output, uint64_t length, uint64_t stride, double vmin, double scale_v, uint64_t bins) {
+    const __m512d vmin8 = _mm512_set1_pd(vmin);
+    const __m512d scale8 = _mm512_set1_pd(scale_v);
+    const __m512d bins8 = _mm512_set1_pd((double)bins);
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.);
+    const __m512d index_underflow = _mm512_set1_pd(1.);
+    const __m512d index_overflow = _mm512_set1_pd((double)(bins-1+3));
+    const __m512d index_offset = _mm512_set1_pd(2.);
+    const __m512i stride8 = _mm512_set1_epi64(stride);
+    const __m512i masked_value = _mm512_set1_epi64(1);
+    uint64_t i = 0;
+    for(; i + 8 <= length; i += 8) {
+        __m512d scaled = _mm512_mul_pd(_mm512_sub_pd(load8(data + i), vmin8), scale8);
+        __m512d index = _mm512_roundscale_pd(_mm512_mul_pd(scaled, bins8), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        index = _mm512_add_pd(index, index_offset);
+        index = _mm512_mask_mov_pd(index, _mm512_cmp_pd_mask(scaled, one, _CMP_GE_OQ), index_overflow);
+        index = _mm512_mask_mov_pd(index, _mm512_cmp_pd_mask(scaled, zero, _CMP_LT_OQ), index_underflow);
+        __mmask8 invalid = _mm512_cmp_pd_mask(scaled, scaled, _CMP_UNORD_Q);
+        if(mask) {
+            __m512i mask8 = _mm512_cvtepu8_epi64(_mm_loadl_epi64((const __m128i*)(mask + i)));
+            invalid |= _mm512_cmpeq_epi64_mask(mask8, masked_value);
+        }
+        __m512i index8 = _mm512_maskz_cvttpd_epi64((__mmask8)~invalid, index);
+        __m512i out = _mm512_loadu_si512(output + i);
+        out = _mm512_add_epi64(out, _mm512_mullo_epi64(index8, stride8));
+        _mm512_storeu_si512(output + i, out);
+    }
+    to_bins_scalar_tail(data + i, mask ? mask + i : nullptr, output + i, length - i, stride, vmin, scale_v, bins);
+}
+
+#endif
+
+// vectorized version of BinnerScalar::to_bins for native endian data, with data, mask and output
+// already offset, returns false when no vectorized kernel can be used (and nothing was done)
+template<class T>
+inline bool to_bins_scalar(const T* data, const uint8_t* mask, uint64_t* output, uint64_t length, uint64_t stride, double vmin, double scale_v, uint64_t bins) {
+#ifdef VAEX_SIMD_X86
+    int simd_level = level();
+    if(simd_level >= LEVEL_AVX512) {
+        to_bins_scalar_avx512(data, mask, output, length, stride, vmin, scale_v, bins);
+        return true;
+    }
+    if(simd_level >= LEVEL_AVX2 && stride < (1ull << 32) && bins < (1ull << 30)) {
+        to_bins_scalar_avx2(data, mask, output, length, stride, vmin, scale_v, bins);
+        return true;
+    }
+#endif
+    return false;
+}
+
+}
+}
+
+#endif
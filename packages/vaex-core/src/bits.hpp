@@ -0,0 +1,91 @@
+#ifndef VAEX_BITS_H
+#define VAEX_BITS_H
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// Bit tricks we use for packed masks, the hash maps and the sketches. gcc and clang have builtins for
+// them, MSVC has intrinsics with a different interface, so we only use these (and not the builtins).
+
+namespace vaex {
+
+// number of trailing zero bits, x should not be 0
+inline int ctz32(uint32_t x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+// number of trailing zero bits, x should not be 0
+inline int ctz64(uint64_t x) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#elif defined(_MSC_VER)
+    uint32_t low = (uint32_t)x;
+    return low ? ctz32(low) : 32 + ctz32((uint32_t)(x >> 32));
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// number of leading zero bits, x should not be 0
+inline int clz64(uint64_t x) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    uint32_t high = (uint32_t)(x >> 32);
+    if(high) {
+        _BitScanReverse(&index, high);
+        return 31 - (int)index;
+    }
+    _BitScanReverse(&index, (uint32_t)x);
+    return 63 - (int)index;
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+// 1 + the index of the lowest set bit, or 0 when x is 0
+inline int ffs64(uint64_t x) {
+    return x ? ctz64(x) + 1 : 0;
+}
+
+inline int popcount64(uint64_t x) {
+#ifdef _MSC_VER
+    // __popcnt64 needs the POPCNT instruction, which MSVC does not check for
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+// hint to load the cache line of address, for reading
+inline void prefetch(const void* address) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_prefetch((const char*)address, _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+} // namespace vaex
+#endif
@@ -0,0 +1,321 @@
+#ifndef VAEX_FLAT_HASH_MAP_H
+#define VAEX_FLAT_HASH_MAP_H
+
+#include "bits.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace vaex {
+
+// finalizer of MurmurHash3, spreads the bits of a (possibly weak, e.g. identity for integers) hash over all 64 bits
+inline uint64_t flat_hash_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+namespace flat_hash_detail {
+
+// control byte of an empty slot, a full slot holds the lower 7 bits of the hash
+const int8_t CTRL_EMPTY = -128;
+const size_t GROUP_WIDTH = 16;
+
+// 16 control bytes, that are compared at once
+struct Group {
+#if defined(__SSE2__)
+    explicit Group(const int8_t* ctrl) : ctrl(_mm_loadu_si128((const __m128i*)ctrl)) {}
+    // bit i is set when slot i has this h2
+    uint32_t match(int8_t h2) const {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+    }
+    // bit i is set when slot i is empty (the only negative control byte)
+    uint32_t match_empty() const {
+        return _mm_movemask_epi8(ctrl);
+    }
+    __m128i ctrl;
+#else
+    explicit Group(const int8_t* ctrl) {
+        memcpy(bytes, ctrl, GROUP_WIDTH);
+    }
+    uint32_t match(int8_t h2) const {
+        uint32_t mask = 0;
+        for(size_t i = 0; i < GROUP_WIDTH; i++) {
+            mask |= uint32_t(bytes[i] == h2) << i;
+        }
+        return mask;
+    }
+    uint32_t match_empty() const {
+        uint32_t mask = 0;
+        for(size_t i = 0; i < GROUP_WIDTH; i++) {
+            mask |= uint32_t(bytes[i] < 0) << i;
+        }
+        return mask;
+    }
+    int8_t bytes[GROUP_WIDTH];
+#endif
+};
+
+} // namespace flat_hash_detail
+
+// Open addressing hash map in the style of Swiss tables (absl::flat_hash_map): a control byte per slot
+// holds 7 bits of the hash, and a lookup compares 16 control bytes with a single SSE2 instruction, so
+// it mostly touches one cache line of control bytes and one slot. Slots are probed a group at a time
+// (quadratic probing over groups), and the table grows at a load of 7/8. There is no erase.
+// It has the subset of the tsl::hopscotch_map interface we use, and hash/prefetch/find(key, hash)
+// so a block of keys can be hashed and prefetched before probing (see hash_base::update).
+template<class Key, class Value, class Hash=std::hash<Key>, class Compare=std::equal_to<Key>>
+class flat_hash_map {
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+
+    template<class Map, class Reference>
+    class iterator_base {
+    public:
+        iterator_base(Map* map, size_t index) : map(map), index(index) {}
+        Reference operator*() const { return map->slots[index]; }
+        typename std::remove_reference<Reference>::type* operator->() const { return &map->slots[index]; }
+        iterator_base& operator++() {
+            index = map->next_full(index + 1);
+            return *this;
+        }
+        bool operator==(const iterator_base& other) const { return index == other.index; }
+        bool operator!=(const iterator_base& other) const { return index != other.index; }
+        // tsl::hopscotch_map compatible way to modify the value, see set_second
+        Value& value() const { return map->slots[index].second; }
+    private:
+        Map* map;
+        size_t index;
+    };
+    using iterator = iterator_base<flat_hash_map, value_type&>;
+    using const_iterator = iterator_base<const flat_hash_map, const value_type&>;
+
+    flat_hash_map() : ctrl(nullptr), slots(nullptr), capacity(0), count(0) {}
+    flat_hash_map(const flat_hash_map& other) : ctrl(nullptr), slots(nullptr), capacity(0), count(0) {
+        if(other.capacity) {
+            allocate(other.capacity);
+            memcpy(ctrl, other.ctrl, capacity + flat_hash_detail::GROUP_WIDTH);
+            for(size_t i = 0; i < capacity; i++) {
+                if(ctrl[i] >= 0) {
+                    new(&slots[i]) value_type(other.slots[i]);
+                }
+            }
+            count = other.count;
+        }
+    }
+    flat_hash_map(flat_hash_map&& other) : ctrl(other.ctrl), slots(other.slots), capacity(other.capacity), count(other.count) {
+        other.ctrl = nullptr;
+        other.slots = nullptr;
+        other.capacity = 0;
+        other.count = 0;
+    }
+    flat_hash_map& operator=(flat_hash_map other) {
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+        return *this;
+    }
+    ~flat_hash_map() {
+        destroy();
+    }
+
+    uint64_t hash(const Key& key) const {
+        return hash_from(hasher(key));
+    }
+    // the hash of a key of which the value of the Hash functor was computed before (e.g. cached string hashes)
+    uint64_t hash_from(uint64_t hasher_value) const {
+        return flat_hash_mix(hasher_value);
+    }
+    // brings the control bytes and first slot of the probe sequence of this hash into the cache
+    void prefetch(uint64_t hash) const {
+        if(capacity) {
+            size_t pos = (hash >> 7) & (capacity - 1);
+            vaex::prefetch(ctrl + pos);
+            vaex::prefetch(slots + pos);
+        }
+    }
+
+    iterator find(const Key& key) { return iterator(this, find_index(key, hash(key))); }
+    iterator find(const Key& key, uint64_t hash) { return iterator(this, find_index(key, hash)); }
+    const_iterator find(const Key& key) const { return const_iterator(this, find_index(key, hash(key))); }
+    const_iterator find(const Key& key, uint64_t hash) const { return const_iterator(this, find_index(key, hash)); }
+
+    template<class K, class V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value) {
+        return emplace_hashed(hash(key), std::forward<K>(key), std::forward<V>(value));
+    }
+    std::pair<iterator, bool> emplace(const value_type& pair) {
+        return emplace_hashed(hash(pair.first), pair.first, pair.second);
+    }
+    std::pair<iterator, bool> insert(const value_type& pair) {
+        return emplace(pair);
+    }
+    template<class K, class V>
+    std::pair<iterator, bool> emplace_hashed(uint64_t hash, K&& key, V&& value) {
+        size_t index = find_index(key, hash);
+        if(index != capacity) {
+            return std::make_pair(iterator(this, index), false);
+        }
+        if(count + 1 > growth_limit()) {
+            rehash(capacity ? capacity * 2 : flat_hash_detail::GROUP_WIDTH);
+        }
+        index = find_empty(hash);
+        new(&slots[index]) value_type(std::forward<K>(key), std::forward<V>(value));
+        set_ctrl(index, hash & 0x7f);
+        count++;
+        return std::make_pair(iterator(this, index), true);
+    }
+    Value& operator[](const Key& key) {
+        uint64_t h = hash(key);
+        size_t index = find_index(key, h);
+        if(index == capacity) {
+            return emplace_hashed(h, key, Value()).first.value();
+        }
+        return slots[index].second;
+    }
+
+    // makes room for n keys without growing
+    void reserve(size_t n) {
+        size_t new_capacity = flat_hash_detail::GROUP_WIDTH;
+        while(new_capacity - new_capacity / 8 < n) {
+            new_capacity *= 2;
+        }
+        if(new_capacity > capacity) {
+            rehash(new_capacity);
+        }
+    }
+
+    iterator begin() { return iterator(this, next_full(0)); }
+    iterator end() { return iterator(this, capacity); }
+    const_iterator begin() const { return const_iterator(this, next_full(0)); }
+    const_iterator end() const { return const_iterator(this, capacity); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    size_t growth_limit() const {
+        return capacity - capacity / 8;
+    }
+    size_t next_full(size_t index) const {
+        while(index < capacity && ctrl[index] < 0) {
+            index++;
+        }
+        return index;
+    }
+    // index of the slot of key, or capacity when not present
+    size_t find_index(const Key& key, uint64_t hash) const {
+        if(capacity == 0) {
+            return 0;
+        }
+        const size_t mask = capacity - 1;
+        const int8_t h2 = hash & 0x7f;
+        size_t pos = (hash >> 7) & mask;
+        size_t step = 0;
+        while(true) {
+            flat_hash_detail::Group group(ctrl + pos);
+            uint32_t matches = group.match(h2);
+            while(matches) {
+                size_t index = (pos + ctz32(matches)) & mask;
+                if(equal(slots[index].first, key)) {
+                    return index;
+                }
+                matches &= matches - 1;
+            }
+            // an empty slot ends the probe sequence, since we do not erase
+            if(group.match_empty()) {
+                return capacity;
+            }
+            step += flat_hash_detail::GROUP_WIDTH;
+            pos = (pos + step) & mask;
+        }
+    }
+    // the first empty slot in the probe sequence of hash (there always is one, see growth_limit)
+    size_t find_empty(uint64_t hash) const {
+        const size_t mask = capacity - 1;
+        size_t pos = (hash >> 7) & mask;
+        size_t step = 0;
+        while(true) {
+            uint32_t empty = flat_hash_detail::Group(ctrl + pos).match_empty();
+            if(empty) {
+                return (pos + ctz32(empty)) & mask;
+            }
+            step += flat_hash_detail::GROUP_WIDTH;
+            pos = (pos + step) & mask;
+        }
+    }
+    void set_ctrl(size_t index, int8_t h2) {
+        ctrl[index] = h2;
+        // the first group is repeated after the end, so a group can be loaded at any position
+        if(index < flat_hash_detail::GROUP_WIDTH) {
+            ctrl[capacity + index] = h2;
+        }
+    }
+    // on failure the map is left untouched
+    void allocate(size_t new_capacity) {
+        int8_t* new_ctrl = (int8_t*)malloc(new_capacity + flat_hash_detail::GROUP_WIDTH);
+        value_type* new_slots = (value_type*)malloc(sizeof(value_type) * new_capacity);
+        if(new_ctrl == nullptr || new_slots == nullptr) {
+            free(new_ctrl);
+            free(new_slots);
+            throw std::bad_alloc();
+        }
+        memset(new_ctrl, flat_hash_detail::CTRL_EMPTY, new_capacity + flat_hash_detail::GROUP_WIDTH);
+        ctrl = new_ctrl;
+        slots = new_slots;
+        capacity = new_capacity;
+    }
+    void rehash(size_t new_capacity) {
+        int8_t* old_ctrl = ctrl;
+        value_type* old_slots = slots;
+        size_t old_capacity = capacity;
+        allocate(new_capacity);
+        for(size_t i = 0; i < old_capacity; i++) {
+            if(old_ctrl[i] >= 0) {
+                uint64_t h = hash(old_slots[i].first);
+                size_t index = find_empty(h);
+                new(&slots[index]) value_type(std::move(old_slots[i]));
+                set_ctrl(index, h & 0x7f);
+                old_slots[i].~value_type();
+            }
+        }
+        free(old_ctrl);
+        free(old_slots);
+    }
+    void destroy() {
+        for(size_t i = 0; i < capacity; i++) {
+            if(ctrl[i] >= 0) {
+                slots[i].~value_type();
+            }
+        }
+        free(ctrl);
+        free(slots);
+        ctrl = nullptr;
+        slots = nullptr;
+        capacity = 0;
+        count = 0;
+    }
+
+    int8_t* ctrl;
+    value_type* slots;
+    size_t capacity;
+    size_t count;
+    Hash hasher;
+    Compare equal;
+};
+
+} // namespace vaex
+
+#endif
@@ -1,21 +1,212 @@
-// #include "flat_hash_map.hpp"
+#ifndef VAEX_HASH_H
+#define VAEX_HASH_H
+
+#include "flat_hash_map.hpp"
 // #include "unordered_map.hpp"
-#include "tsl/hopscotch_set.h"
-#include "tsl/hopscotch_map.h"
+// #include "tsl/hopscotch_set.h"
+// #include "tsl/hopscotch_map.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <pybind11/pybind11.h>
 
 namespace vaex {
 
 template<class Key, class Value, class Hash=std::hash<Key>, class Compare=std::equal_to<Key>>
 // using hashmap = ska::flat_hash_map<Key, Value, Hash, Compare>;
-using hashmap = tsl::hopscotch_map<Key, Value, Hash, Compare>;
+// using hashmap = tsl::hopscotch_map<Key, Value, Hash, Compare>;
+using hashmap = flat_hash_map<Key, Value, Hash, Compare>;
 // template<class Key,  class Hash, class Compare>
 // using hashset = tsl::hopscotch_set<Key, Hash, Compare>;
 
+// reads 8 bytes as a little endian word, so hashes do not depend on the byte order of the machine
+inline uint64_t load_le64(const char* data) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// 64 bit hash of a byte string, that reads 8 bytes at a time (in the spirit of xxhash, but simpler).
+// These hashes can be cached and stored (see StringSequence::hashes), so do not change it.
+inline uint64_t hash_bytes(const char* data, size_t length) {
+    const uint64_t prime1 = 0x9e3779b185ebca87ULL;
+    const uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+    uint64_t hash = length * prime1;
+    size_t i = 0;
+    for(; i + 8 <= length; i += 8) {
+        hash ^= load_le64(data + i) * prime2;
+        hash = ((hash << 31) | (hash >> 33)) * prime1;
+    }
+    if(i < length) {
+        char tail[8] = {0};
+        memcpy(tail, data + i, length - i);
+        hash ^= load_le64(tail) * prime2;
+        hash = ((hash << 31) | (hash >> 33)) * prime1;
+    }
+    return flat_hash_mix(hash);
+}
+
+// hashes a string (view) with hash_bytes
+struct hash_string_view {
+    template<class String>
+    std::size_t operator()(const String& value) const {
+        return hash_bytes(value.data(), value.size());
+    }
+};
+
+// Releases the GIL only when the calling thread holds it, since merges of the counters also run
+// on the native threads of the aggregator reduce (see for_each_cell_range), which never had it.
+class gil_release_if_held {
+public:
+    gil_release_if_held() {
+        if(PyGILState_Check()) {
+            release.reset(new pybind11::gil_scoped_release());
+        }
+    }
+private:
+    std::unique_ptr<pybind11::gil_scoped_release> release;
+};
+
 // we cannot modify .second, instead use .value()
-// see https://github.com/Tessil/hopscotch-map
+// see https://github.com/Tessil/hopscotch-map (flat_hash_map follows this)
 template<class I, class V>
 inline void set_second(I& it, V &&value) {
     it.value() = value;
 }
 
+// A map for keys with a small domain (bool and 8 or 16 bit integers), where the key directly indexes
+// an array of slots, so no hashing or probing is needed. It implements the part of the hashmap
+// interface that the hash_primitives templates use.
+// The slots are only allocated on the first insert, since the aggregators keep a (mostly empty)
+// counter per cell, and iterating only visits the range of slots [low, high] that was ever used.
+template<class Key, class Value>
+class dense_map {
+public:
+    using value_type = std::pair<Key, Value>;
+    using unsigned_key = typename std::conditional<sizeof(Key) == 1, uint8_t, uint16_t>::type;
+    static const size_t slot_count = std::is_same<Key, bool>::value ? 2 : (size_t(1) << (8 * sizeof(Key)));
+
+    template<class Map, class Reference>
+    class iterator_base {
+    public:
+        iterator_base(Map* map, size_t index) : map(map), index(index) {
+            skip();
+        }
+        Reference operator*() const { return map->slots[index]; }
+        typename std::remove_reference<Reference>::type* operator->() const { return &map->slots[index]; }
+        iterator_base& operator++() {
+            index++;
+            skip();
+            return *this;
+        }
+        bool operator==(const iterator_base& other) const { return index == other.index; }
+        bool operator!=(const iterator_base& other) const { return index != other.index; }
+        Value& value() const { return map->slots[index].second; }
+    private:
+        // move to the next occupied slot, or to the end
+        void skip() {
+            while(index <= map->high && !map->occupied[index]) {
+                index++;
+            }
+            if(index > map->high) {
+                index = slot_count;
+            }
+        }
+        Map* map;
+        size_t index;
+    };
+    using iterator = iterator_base<dense_map, value_type&>;
+    using const_iterator = iterator_base<const dense_map, const value_type&>;
+
+    // an empty map has low > high
+    dense_map() : count(0), low(slot_count), high(0) {}
+
+    static size_t slot(Key key) {
+        return (size_t)(unsigned_key)key;
+    }
+    // same interface as flat_hash_map, but there is nothing to hash or prefetch
+    uint64_t hash(Key key) const {
+        return 0;
+    }
+    void prefetch(uint64_t hash) const {
+    }
+    void reserve(size_t n) {
+    }
+    iterator find(Key key, uint64_t hash) {
+        return find(key);
+    }
+    const_iterator find(Key key, uint64_t hash) const {
+        return find(key);
+    }
+    iterator find(Key key) {
+        return iterator(this, contains(slot(key)) ? slot(key) : slot_count);
+    }
+    const_iterator find(Key key) const {
+        return const_iterator(this, contains(slot(key)) ? slot(key) : slot_count);
+    }
+    std::pair<iterator, bool> emplace(Key key, Value value) {
+        size_t index = slot(key);
+        bool inserted = !contains(index);
+        if(inserted) {
+            if(occupied.empty()) {
+                slots.resize(slot_count);
+                occupied.resize(slot_count, 0);
+            }
+            slots[index] = value_type(key, value);
+            occupied[index] = 1;
+            count++;
+            low = std::min(low, index);
+            high = std::max(high, index);
+        }
+        return std::make_pair(iterator(this, index), inserted);
+    }
+    std::pair<iterator, bool> emplace(const value_type& pair) {
+        return emplace(pair.first, pair.second);
+    }
+    std::pair<iterator, bool> emplace_hashed(uint64_t hash, Key key, Value value) {
+        return emplace(key, value);
+    }
+    Value& operator[](Key key) {
+        size_t index = slot(key);
+        if(!contains(index)) {
+            emplace(key, Value());
+        }
+        return slots[index].second;
+    }
+    iterator begin() { return iterator(this, low); }
+    iterator end() { return iterator(this, slot_count); }
+    const_iterator begin() const { return const_iterator(this, low); }
+    const_iterator end() const { return const_iterator(this, slot_count); }
+    size_t size() const { return count; }
+
+    std::vector<value_type> slots;
+    std::vector<uint8_t> occupied;
+    size_t count;
+    size_t low; // the range of slots [low, high] that can be occupied
+    size_t high;
+private:
+    bool contains(size_t index) const {
+        return !occupied.empty() && occupied[index];
+    }
+};
+
+template<class Map>
+struct is_dense_map : std::false_type {};
+template<class Key, class Value>
+struct is_dense_map<dense_map<Key, Value>> : std::true_type {};
+
+// primitive keys with a small domain use a dense_map instead of hashing
+template<class Key, class Value>
+struct primitive_map {
+    using type = typename std::conditional<std::is_integral<Key>::value && sizeof(Key) <= 2, dense_map<Key, Value>, hashmap<Key, Value>>::type;
+};
+
 }
+
+#endif
@@ -0,0 +1,201 @@
+#include "hash_string.hpp"
+#include <cmath>
+
+namespace vaex {
+
+// The values of several key columns (numbers and strings mixed), encoded per row as a single byte string,
+// so that a combination of values can be hashed and compared by the string sets and index (e.g. a groupby
+// or join on multiple columns gives a single group id or row index, without a grid over all combinations).
+// Each value is a tag byte followed by: the 8 bytes of a number (integers as int64, floats as float64),
+// or the length (8 bytes) and the bytes of a string. Missing values and nan only have the tag.
+class combined_keys : public StringSequence {
+public:
+    enum {
+        TAG_VALUE = 0,
+        TAG_MISSING = 1,
+        TAG_NAN = 2
+    };
+    struct Column {
+        char kind; // 'i', 'f' or 's'
+        const int64_t* integers;
+        const double* floats;
+        const uint8_t* mask;
+        const StringSequence* strings;
+    };
+    combined_keys(int64_t length) : StringSequence(length), offsets(length + 1, 0) {}
+
+    void add_int64(py::array_t<int64_t, py::array::c_style>& values, py::object mask) {
+        Column column = {'i', values.data(), nullptr, check_mask(values.size(), mask), nullptr};
+        add(column, values, mask);
+    }
+    void add_float64(py::array_t<double, py::array::c_style>& values, py::object mask) {
+        Column column = {'f', nullptr, values.data(), check_mask(values.size(), mask), nullptr};
+        add(column, values, mask);
+    }
+    void add_string(StringSequence* strings) {
+        if(strings->length != length) {
+            throw std::runtime_error("the key columns should have the same length");
+        }
+        Column column = {'s', nullptr, nullptr, nullptr, strings};
+        columns.push_back(column);
+    }
+    // encodes the rows, the columns should not be added after this
+    void encode() {
+        py::gil_scoped_release gil;
+        bytes.clear();
+        bytes.reserve(length * (columns.size() * 9));
+        for(size_t i = 0; i < length; i++) {
+            offsets[i] = bytes.size();
+            for(const Column& column : columns) {
+                encode_value(column, i);
+            }
+        }
+        offsets[length] = bytes.size();
+    }
+    virtual string_view view(int64_t i) const {
+        return string_view(bytes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    virtual const std::string get(int64_t i) const {
+        return std::string(bytes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    virtual size_t byte_size() const {
+        return bytes.size();
+    }
+    std::string kinds() const {
+        std::string kinds;
+        for(const Column& column : columns) {
+            kinds.push_back(column.kind);
+        }
+        return kinds;
+    }
+private:
+    const uint8_t* check_mask(int64_t size, py::object mask) {
+        if(mask.is_none()) {
+            return nullptr;
+        }
+        py::array_t<uint8_t, py::array::c_style> mask_array = mask.cast<py::array_t<uint8_t, py::array::c_style>>();
+        if(mask_array.size() != (int64_t)length || size != (int64_t)length) {
+            throw std::runtime_error("the key columns should have the same length");
+        }
+        keep_alive.push_back(mask_array);
+        return mask_array.data();
+    }
+    void add(const Column& column, py::object values, py::object mask) {
+        if(py::len(values) != length) {
+            throw std::runtime_error("the key columns should have the same length");
+        }
+        keep_alive.push_back(values);
+        columns.push_back(column);
+    }
+    void encode_value(const Column& column, size_t i) {
+        if((column.mask && column.mask[i]) || (column.strings && column.strings->is_null(i))) {
+            bytes.push_back(TAG_MISSING);
+        } else if(column.kind == 'i') {
+            append_value(column.integers[i]);
+        } else if(column.kind == 'f') {
+            double value = column.floats[i];
+            if(std::isnan(value)) {
+                bytes.push_back(TAG_NAN);
+            } else {
+                // -0 and 0 are the same key
+                append_value(value == 0 ? 0.0 : value);
+            }
+        } else {
+            string_view value = column.strings->view(i);
+            append_value((int64_t)value.size());
+            bytes.insert(bytes.end(), value.begin(), value.end());
+        }
+    }
+    template<class T>
+    void append_value(T value) {
+        bytes.push_back(TAG_VALUE);
+        const char* data = (const char*)&value;
+        bytes.insert(bytes.end(), data, data + sizeof(T));
+    }
+    std::vector<Column> columns;
+    std::vector<py::object> keep_alive;
+    std::vector<char> bytes;
+    std::vector<size_t> offsets;
+};
+
+// decodes the keys of an ordered set of combined_keys, in order of their ordinal, into a list
+// with per column a (values, mask) tuple for numbers, or a list (with None for missing values) for strings
+py::list decode_combined_keys(const ordered_set<>& set, std::string kinds) {
+    int64_t size = set.map.size();
+    std::vector<py::array_t<int64_t>> integers;
+    std::vector<py::array_t<double>> floats;
+    std::vector<std::vector<std::string>> strings;
+    std::vector<py::array_t<bool>> masks;
+    for(char kind : kinds) {
+        integers.push_back(py::array_t<int64_t>(kind == 'i' ? size : 0));
+        floats.push_back(py::array_t<double>(kind == 'f' ? size : 0));
+        strings.push_back(std::vector<std::string>(kind == 's' ? size : 0));
+        masks.push_back(py::array_t<bool>(size));
+    }
+    for(auto& el : set.map) {
+        const string_view& key = el.first;
+        int64_t ordinal = el.second;
+        size_t position = 0;
+        for(size_t c = 0; c < kinds.size(); c++) {
+            char tag = key[position++];
+            masks[c].mutable_data()[ordinal] = tag == combined_keys::TAG_MISSING;
+            if(kinds[c] == 'i') {
+                int64_t value = 0;
+                if(tag == combined_keys::TAG_VALUE) {
+                    memcpy(&value, key.data() + position, sizeof(value));
+                    position += sizeof(value);
+                }
+                integers[c].mutable_data()[ordinal] = value;
+            } else if(kinds[c] == 'f') {
+                double value = tag == combined_keys::TAG_NAN ? NAN : 0;
+                if(tag == combined_keys::TAG_VALUE) {
+                    memcpy(&value, key.data() + position, sizeof(value));
+                    position += sizeof(value);
+                }
+                floats[c].mutable_data()[ordinal] = value;
+            } else if(tag == combined_keys::TAG_VALUE) {
+                int64_t length;
+                memcpy(&length, key.data() + position, sizeof(length));
+                position += sizeof(length);
+                strings[c][ordinal] = std::string(key.data() + position, length);
+                position += length;
+            }
+        }
+    }
+    py::list result;
+    for(size_t c = 0; c < kinds.size(); c++) {
+        if(kinds[c] == 's') {
+            py::list values;
+            for(int64_t i = 0; i < size; i++) {
+                if(masks[c].data()[i]) {
+                    values.append(py::none());
+                } else {
+                    values.append(py::str(strings[c][i]));
+                }
+            }
+            result.append(values);
+        } else if(kinds[c] == 'i') {
+            result.append(py::make_tuple(integers[c], masks[c]));
+        } else {
+            result.append(py::make_tuple(floats[c], masks[c]));
+        }
+    }
+    return result;
+}
+
+void init_hash_combined(py::module &m) {
+    // combined_keys is a StringSequence, which is defined in vaex.superstrings
+    py::module::import("vaex.superstrings");
+    py::class_<combined_keys, StringSequence>(m, "combined_keys")
+        .def(py::init<int64_t>(), py::arg("length"))
+        .def("add_int64", &combined_keys::add_int64, py::arg("values"), py::arg("mask") = py::none())
+        .def("add_float64", &combined_keys::add_float64, py::arg("values"), py::arg("mask") = py::none())
+        .def("add_string", &combined_keys::add_string, py::keep_alive<1, 2>())
+        .def("encode", &combined_keys::encode)
+        .def_property_readonly("kinds", &combined_keys::kinds)
+        .def("__len__", [](const combined_keys &keys) { return keys.length; })
+    ;
+    m.def("decode_combined_keys", &decode_combined_keys, "the key values of an ordered set of combined keys, per column");
+}
+
+} // namespace vaex
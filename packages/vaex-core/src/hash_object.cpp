@@ -259,6 +259,57 @@ public:
 };
 
 
+// Tells if the (non masked) values of an object array are all str, all int (that fit in 64 bit) or all
+// float, so they can be converted to a typed array once, and hashed or aggregated without the GIL.
+// Returns an empty string for other arrays (e.g. mixed types, None or no values).
+std::string classify_objects_(py::buffer object_array, const bool* mask) {
+    py::buffer_info info = object_array.request();
+    if(info.ndim != 1 || info.format != "O") {
+        throw std::runtime_error("Expected a 1d object array");
+    }
+    int64_t length = info.shape[0];
+    PyObject** array = (PyObject**)info.ptr;
+    enum { NONE, STR, INT, FLOAT, MIXED } kind = NONE;
+    for(int64_t i = 0; i < length && kind != MIXED; i++) {
+        if(mask && mask[i]) {
+            continue;
+        }
+        PyObject* value = array[i];
+        int value_kind = MIXED;
+        if(PyUnicode_CheckExact(value)) {
+            value_kind = STR;
+        } else if(PyFloat_CheckExact(value)) {
+            value_kind = FLOAT;
+        } else if(PyLong_CheckExact(value)) {
+            int overflow = 0;
+            PyLong_AsLongLongAndOverflow(value, &overflow);
+            value_kind = overflow ? MIXED : INT;
+        }
+        if(kind == NONE) {
+            kind = (decltype(kind))value_kind;
+        } else if(kind != value_kind) {
+            kind = MIXED;
+        }
+    }
+    switch(kind) {
+        case STR: return "str";
+        case INT: return "int";
+        case FLOAT: return "float";
+        default: return "";
+    }
+}
+
+std::string classify_objects(py::buffer object_array) {
+    return classify_objects_(object_array, nullptr);
+}
+
+std::string classify_objects_with_mask(py::buffer object_array, py::array_t<bool>& masks) {
+    if(masks.size() != object_array.request().shape[0]) {
+        throw std::runtime_error("Expected a mask of the same length");
+    }
+    return classify_objects_(object_array, masks.data());
+}
+
 void init_hash_object(py::module &m) {
     {
         typedef counter<> Type;
@@ -273,6 +324,8 @@ void init_hash_object(py::module &m) {
             .def_property_readonly("null_count", [](const Type &c) { return c.null_count; })
         ;
     }
+    m.def("classify_objects", &classify_objects);
+    m.def("classify_objects", &classify_objects_with_mask);
     {
         std::string ordered_setname = "ordered_set_object";
         typedef ordered_set<> Type;
@@ -7,12 +7,17 @@ void init_hash(M m, std::string name) {
     std::string countername = "counter_" + name;
     py::class_<counter_type>(m, countername.c_str())
         .def(py::init<>())
+        .def(py::init<int64_t>(), py::arg("partitions"))
         .def("update", &counter_type::update, "add values", py::arg("values"), py::arg("start_index") = 0)
         .def("update", &counter_type::update_with_mask, "add masked values", py::arg("values"), py::arg("masks"), py::arg("start_index") = 0)
+        .def("reserve", &counter_type::reserve, "presize for an expected number of unique values", py::arg("count"))
         .def("merge", &counter_type::merge)
+        .def("merge", &counter_type::merge_many, "merge a list of counters, a thread per partition")
         .def("extract", &counter_type::extract)
         .def("keys", &counter_type::keys)
         .def_property_readonly("count", [](const counter_type &c) { return c.count; })
+        .def_property_readonly("partitions", [](const counter_type &c) { return c.maps.size(); })
+        .def_property_readonly_static("dense", [](py::object) { return counter_type::dense; })
         .def_property_readonly("nan_count", [](const counter_type &c) { return c.nan_count; })
         .def_property_readonly("null_count", [](const counter_type &c) { return c.null_count; })
         .def_property_readonly("has_nan", [](const counter_type &c) { return c.nan_count > 0; })
@@ -23,14 +28,19 @@ void init_hash(M m, std::string name) {
         typedef ordered_set<T> Type;
         py::class_<Type>(m, ordered_setname.c_str())
             .def(py::init<>())
+            .def(py::init<int64_t>(), py::arg("partitions"))
             .def(py::init(&Type::create))
             .def("update", &Type::update, "add values", py::arg("values"), py::arg("start_index") = 0)
             .def("update", &Type::update_with_mask, "add masked values", py::arg("values"), py::arg("masks"), py::arg("start_index") = 0)
+            .def("reserve", &Type::reserve, "presize for an expected number of unique values", py::arg("count"))
             .def("merge", &Type::merge)
+            .def("merge", &Type::merge_many, "merge a list of sets, a thread per partition")
             .def("extract", &Type::extract)
             .def("keys", &Type::keys)
             .def("map_ordinal", &Type::map_ordinal)
             .def_property_readonly("count", [](const Type &c) { return c.count; })
+            .def_property_readonly("partitions", [](const Type &c) { return c.maps.size(); })
+            .def_property_readonly_static("dense", [](py::object) { return Type::dense; })
             .def_property_readonly("nan_count", [](const Type &c) { return c.nan_count; })
             .def_property_readonly("null_count", [](const Type &c) { return c.null_count; })
             .def_property_readonly("has_nan", [](const Type &c) { return c.nan_count > 0; })
@@ -42,15 +52,22 @@ void init_hash(M m, std::string name) {
         typedef index_hash<T> Type;
         py::class_<Type>(m, index_hashname.c_str())
             .def(py::init<>())
+            .def(py::init<int64_t>(), py::arg("partitions"))
             .def("update", &Type::update)
             .def("update", &Type::update_with_mask)
+            .def("reserve", &Type::reserve)
             .def("merge", &Type::merge)
+            .def("merge", &Type::merge_many, "merge a list of sets, a thread per partition")
             .def("extract", &Type::extract)
             .def("keys", &Type::keys)
             .def("map_index", &Type::map_index)
             .def("map_index", &Type::map_index_with_mask)
             .def("map_index_duplicates", &Type::map_index_duplicates)
+            .def("join", &Type::join, "left and right row indices of the matching rows", py::arg("values"), py::arg("start_index"), py::arg("keep_unmatched"))
+            .def("join", &Type::join_with_mask, "left and right row indices of the matching rows", py::arg("values"), py::arg("mask"), py::arg("start_index"), py::arg("keep_unmatched"))
             .def("__len__", [](const Type &c) { return c.count + (c.null_count > 0) + (c.nan_count > 0); })
+            .def_property_readonly("partitions", [](const Type &c) { return c.maps.size(); })
+            .def_property_readonly_static("dense", [](py::object) { return Type::dense; })
             .def_property_readonly("nan_count", [](const Type &c) { return c.nan_count; })
             .def_property_readonly("null_count", [](const Type &c) { return c.null_count; })
             .def_property_readonly("has_nan", [](const Type &c) { return c.nan_count > 0; })
@@ -1,4 +1,6 @@
 #include "hash.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
@@ -12,24 +14,58 @@ namespace py = pybind11;
 
 namespace vaex {
 
+// number of values hash_base::update hashes (and prefetches) before probing
+const int64_t HASH_BLOCK_SIZE = 64;
+const int64_t HASH_PARTITIONS_MAX = 1024;
+
+// The keys are spread over a number (a power of 2) of sub-maps, by the high bits of their hash.
+// Sets built by different threads can then be merged by a thread per partition (see merge_many).
 template<class Derived, class T>
 class hash_base {
 public:
     using value_type = T;
-    hash_base() : count(0), nan_count(0), null_count(0) {}  ;
+    using map_type = typename primitive_map<value_type, int64_t>::type;
+    // a dense_map does not hash, so all keys would end up in the first partition
+    static const bool dense = is_dense_map<map_type>::value;
+    hash_base(int64_t partitions=1) : maps(partition_count(partitions)), partition_bits(0), count(0), nan_count(0), null_count(0) {
+        while((size_t(1) << partition_bits) < maps.size()) {
+            partition_bits++;
+        }
+    }
+    static size_t partition_count(int64_t partitions) {
+        if(dense) {
+            return 1;
+        }
+        size_t count = 1;
+        while((int64_t)count < std::min(partitions, HASH_PARTITIONS_MAX)) {
+            count *= 2;
+        }
+        return count;
+    }
+    uint64_t hash(const value_type& value) const {
+        return maps[0].hash(value);
+    }
+    size_t partition(uint64_t hash) const {
+        return partition_bits ? size_t(hash >> (64 - partition_bits)) : 0;
+    }
     void update(py::array_t<value_type>& values, int64_t start_index=0) {
         py::gil_scoped_release gil;
         auto ar = values.template unchecked<1>();
         int64_t size = ar.size();
-        for(int64_t i = 0; i < size; i++) {
+        uint64_t hashes[HASH_BLOCK_SIZE];
+        for(int64_t block = 0; block < size; block += HASH_BLOCK_SIZE) {
+            int64_t block_end = std::min(size, block + HASH_BLOCK_SIZE);
+            hash_block(ar, hashes, block, block_end);
+            for(int64_t i = block; i < block_end; i++) {
                 value_type value = ar(i);
                 if(custom_isnan(value)) {
                     // this->nan_count++;
                     // static_cast<Derived&>(*this).add_nan(start_index + i);
                     update1_nan(start_index + i);
                 } else {
-                    update1(value, start_index + i);
+                    update1(value, hashes[i - block], start_index + i);
                 }
+            }
         }
     }
     void update_with_mask(py::array_t<value_type>& values, py::array_t<bool>& masks, int64_t start_index=0) {
@@ -38,7 +74,11 @@ public:
         auto m = masks.template unchecked<1>();
         assert(m.size() == ar.size());
         int64_t size = ar.size();
-        for(int64_t i = 0; i < size; i++) {
+        uint64_t hashes[HASH_BLOCK_SIZE];
+        for(int64_t block = 0; block < size; block += HASH_BLOCK_SIZE) {
+            int64_t block_end = std::min(size, block + HASH_BLOCK_SIZE);
+            hash_block(ar, hashes, block, block_end);
+            for(int64_t i = block; i < block_end; i++) {
                 value_type value = ar(i);
                 if(m[i]) {
                     // this->null_count++;
@@ -49,17 +89,31 @@ public:
                     // static_cast<Derived&>(*this).add_nan(start_index + i);
                     update1_nan(start_index + i);
                 } else {
-                    update1(value, start_index + i);
+                    update1(value, hashes[i - block], start_index + i);
                 }
+            }
+        }
+    }
+    // hashes a block of values and prefetches their buckets, so the cache misses of the lookups overlap
+    template<class Array>
+    void hash_block(Array& ar, uint64_t* hashes, int64_t begin, int64_t end) {
+        for(int64_t i = begin; i < end; i++) {
+            uint64_t hash = this->hash(ar(i));
+            hashes[i - begin] = hash;
+            this->maps[partition(hash)].prefetch(hash);
         }
     }
     void update1(value_type& value, int64_t index=0) {
-        auto search = this->map.find(value);
-        auto end = this->map.end();
+        update1(value, this->hash(value), index);
+    }
+    void update1(value_type& value, uint64_t hash, int64_t index) {
+        map_type& map = this->maps[partition(hash)];
+        auto search = map.find(value, hash);
+        auto end = map.end();
         if(search == end) {
-            static_cast<Derived&>(*this).add(value, index);
+            static_cast<Derived&>(*this).add(map, hash, value, index);
         } else {
-            static_cast<Derived&>(*this).add(search, value, index);
+            static_cast<Derived&>(*this).add(search, hash, value, index);
         }
     }
     void update1_null(int64_t index=0) {
@@ -70,26 +124,92 @@ public:
         nan_count++;
         static_cast<Derived&>(*this).add_nan(index);
     }
+    void merge(const Derived& other) {
+        gil_release_if_held gil;
+        std::vector<const Derived*> others(1, &other);
+        for(size_t partition = 0; partition < maps.size(); partition++) {
+            count += static_cast<Derived&>(*this).merge_partition(others, partition);
+        }
+        static_cast<Derived&>(*this).merge_counts(others);
+    }
+    // merges all others into this, each partition is merged by a single thread
+    void merge_many(std::vector<Derived*> others_) {
+        std::vector<const Derived*> others(others_.begin(), others_.end());
+        py::gil_scoped_release gil;
+        size_t partitions = maps.size();
+        std::vector<int64_t> counts(partitions, 0);
+        std::atomic<size_t> next(0);
+        ThreadPool& pool = default_thread_pool();
+        pool.run(std::min(pool.thread_count(), partitions), [&](size_t worker) {
+            for(size_t partition = next++; partition < partitions; partition = next++) {
+                counts[partition] = static_cast<Derived&>(*this).merge_partition(others, partition);
+            }
+        });
+        for(int64_t partition_count : counts) {
+            count += partition_count;
+        }
+        static_cast<Derived&>(*this).merge_counts(others);
+    }
+    void merge_counts(const std::vector<const Derived*>& others) {
+        for(auto other : others) {
+            nan_count += other->nan_count;
+            null_count += other->null_count;
+        }
+    }
+    // calls f(key, value, hash) for each element of other_maps (the maps of another set) that belongs in the given partition
+    template<class Map, class F>
+    void for_each_in_partition(const std::vector<Map>& other_maps, size_t partition, F f) const {
+        if(other_maps.size() == maps.size()) {
+            for(auto& el : other_maps[partition]) {
+                f(el.first, el.second, hash(el.first));
+            }
+        } else {
+            for(auto& other_map : other_maps) {
+                for(auto& el : other_map) {
+                    uint64_t hash = this->hash(el.first);
+                    if(this->partition(hash) == partition) {
+                        f(el.first, el.second, hash);
+                    }
+                }
+            }
+        }
+    }
     std::vector<value_type> keys() {
         std::vector<value_type> v;
-        for(auto el : this->map) {
-            value_type value = el.first;
-            v.push_back(value);
-
+        for(auto& map : this->maps) {
+            for(auto el : map) {
+                value_type value = el.first;
+                v.push_back(value);
+            }
         }
         return v;
     }
+    size_t size() const {
+        size_t size = 0;
+        for(auto& map : this->maps) {
+            size += map.size();
+        }
+        return size;
+    }
+    // presize for the expected number of unique values (e.g. from an approximate count)
+    void reserve(int64_t count) {
+        for(auto& map : this->maps) {
+            map.reserve((count + maps.size() - 1) / maps.size());
+        }
+    }
     std::map<value_type, int64_t> extract() {
         std::map<value_type, int64_t> m;
-        for(auto el : this->map) {
-            value_type value = el.first;
-            m[value] = el.second;
-
+        for(auto& map : this->maps) {
+            for(auto el : map) {
+                value_type value = el.first;
+                m[value] = el.second;
+            }
         }
         return m;
 
     }
-    hashmap<value_type, int64_t> map;
+    std::vector<map_type> maps;
+    int partition_bits;
     int64_t count;
     int64_t nan_count;
     int64_t null_count;
@@ -99,45 +219,51 @@ template<class T>
 class counter : public hash_base<counter<T>, T> {
 public:
     using typename hash_base<counter<T>, T>::value_type;
+    using typename hash_base<counter<T>, T>::map_type;
+    counter(int64_t partitions=1) : hash_base<counter<T>, T>(partitions) {}
 
     void add_missing(int64_t index) {
     }
     void add_nan(int64_t index) {
     }
-    void add(value_type& value, int64_t index) {
-        this->map.emplace(value, 1);
+    void add(map_type& map, uint64_t hash, value_type& value, int64_t index) {
+        map.emplace_hashed(hash, value, 1);
     }
     template<class Bucket>
-    void add(Bucket& bucket, value_type& value, int64_t index) {
+    void add(Bucket& bucket, uint64_t hash, value_type& value, int64_t index) {
         set_second(bucket, bucket->second + 1);
     }
-    void merge(const counter & other) {
-        py::gil_scoped_release gil;
-        for (auto & elem : other.map) {
-            const value_type& value = elem.first;
-            auto search = this->map.find(value);
-            auto end = this->map.end();
-            if(search == end) {
-                this->map.emplace(elem);
-            } else {
-                set_second(search, search->second + elem.second);
-            }
+    int64_t merge_partition(const std::vector<const counter*>& others, size_t partition) {
+        map_type& map = this->maps[partition];
+        for(auto other : others) {
+            this->for_each_in_partition(other->maps, partition, [&](const value_type& value, int64_t count, uint64_t hash) {
+                auto search = map.find(value, hash);
+                auto end = map.end();
+                if(search == end) {
+                    map.emplace_hashed(hash, value, count);
+                } else {
+                    set_second(search, search->second + count);
+                }
+            });
         }
-        this->nan_count += other.nan_count;
-        this->null_count += other.null_count;
+        return 0;
     }
 };
 
+// Keys are numbered in order of insertion per partition, the ordinal of a key is its number plus
+// the number of keys in the partitions before it.
 template<class T>
 class ordered_set : public hash_base<ordered_set<T>, T> {
 public:
     using typename hash_base<ordered_set<T>, T>::value_type;
+    using typename hash_base<ordered_set<T>, T>::map_type;
+    ordered_set(int64_t partitions=1) : hash_base<ordered_set<T>, T>(partitions) {}
 
     static ordered_set* create(std::map<value_type, int64_t> dict, int64_t count, int64_t nan_count, int64_t null_count) {
         ordered_set* set = new ordered_set;
         for(auto el : dict) {
             value_type value = el.first;
-            set->map.emplace(value, el.second);
+            set->maps[0].emplace(value, el.second);
         }
         set->count = count;
         set->nan_count = nan_count;
@@ -145,8 +271,17 @@ public:
         return set;
     }
 
+    std::vector<int64_t> partition_offsets() const {
+        std::vector<int64_t> offsets(this->maps.size());
+        int64_t offset = 0;
+        for(size_t i = 0; i < this->maps.size(); i++) {
+            offsets[i] = offset;
+            offset += this->maps[i].size();
+        }
+        return offsets;
+    }
     py::object map_ordinal(py::array_t<value_type>& values) {
-        size_t size = this->map.size() + (this->null_count > 0 ? 1 : 0) + (this->nan_count > 0 ? 1 : 0);
+        size_t size = this->size() + (this->null_count > 0 ? 1 : 0) + (this->nan_count > 0 ? 1 : 0);
         // TODO: apply this pattern of various return types to the other set types
         if(size < (1u<<7u)) {
             return this->template _map_ordinal<int8_t>(values);
@@ -169,18 +304,22 @@ public:
         py::gil_scoped_release gil;
         // null and nan map to 0 and 1, and move the index up
         OutputType offset = (this->null_count > 0 ? 1 : 0) + (this->nan_count > 0 ? 1 : 0);
+        std::vector<int64_t> offsets = partition_offsets();
         for(int64_t i = 0; i < size; i++) {
             const value_type& value = input(i);
             if(custom_isnan(value)) {
                 output(i) = 0;
                 assert(this->nan_count > 0);
             } else {
-                auto search = this->map.find(value);
-                auto end = this->map.end();
+                uint64_t hash = this->hash(value);
+                size_t partition = this->partition(hash);
+                const map_type& map = this->maps[partition];
+                auto search = map.find(value, hash);
+                auto end = map.end();
                 if(search == end) {
                     output(i) = -1;
                 } else {
-                    output(i) = search->second + offset;
+                    output(i) = search->second + offsets[partition] + offset;
                 }
             }
         }
@@ -190,46 +329,63 @@ public:
     }
     void add_missing(int64_t index) {
     }
-    void add(value_type& value, int64_t index) {
-        this->map.emplace(value, this->count);
+    void add(map_type& map, uint64_t hash, value_type& value, int64_t index) {
+        map.emplace_hashed(hash, value, (int64_t)map.size());
         this->count++;
     }
     template<class Bucket>
-    void add(Bucket& position, value_type& value, int64_t index) {
+    void add(Bucket& position, uint64_t hash, value_type& value, int64_t index) {
         // we can do nothing here
     }
-    void merge(const ordered_set & other) {
-        py::gil_scoped_release gil;
-        for (auto & elem : other.map) {
-            const value_type& value = elem.first;
-            auto search = this->map.find(value);
-            auto end = this->map.end();
-            if(search == end) {
-                this->map.emplace(value, this->count);
-                this->count++;
-            } else {
-                // if already in, it's fine
-            }
+    int64_t merge_partition(const std::vector<const ordered_set*>& others, size_t partition) {
+        map_type& map = this->maps[partition];
+        int64_t added = 0;
+        for(auto other : others) {
+            this->for_each_in_partition(other->maps, partition, [&](const value_type& value, int64_t ordinal, uint64_t hash) {
+                auto search = map.find(value, hash);
+                auto end = map.end();
+                if(search == end) {
+                    map.emplace_hashed(hash, value, (int64_t)map.size());
+                    added++;
+                } else {
+                    // if already in, it's fine
+                }
+            });
         }
-        this->nan_count += other.nan_count;
-        this->null_count += other.null_count;
+        return added;
     }
     std::vector<value_type> keys() {
-        std::vector<value_type> v(this->map.size());
-        for(auto el : this->map) {
-            value_type value = el.first;
-            v[el.second] = value;
-
+        std::vector<value_type> v(this->size());
+        std::vector<int64_t> offsets = partition_offsets();
+        for(size_t partition = 0; partition < this->maps.size(); partition++) {
+            for(auto el : this->maps[partition]) {
+                value_type value = el.first;
+                v[offsets[partition] + el.second] = value;
+            }
         }
         return v;
     }
+    std::map<value_type, int64_t> extract() {
+        std::map<value_type, int64_t> m;
+        std::vector<int64_t> offsets = partition_offsets();
+        for(size_t partition = 0; partition < this->maps.size(); partition++) {
+            for(auto el : this->maps[partition]) {
+                value_type value = el.first;
+                m[value] = offsets[partition] + el.second;
+            }
+        }
+        return m;
+    }
 };
 
 template<class T>
 class index_hash : public hash_base<index_hash<T>, T> {
 public:
     using typename hash_base<index_hash<T>, T>::value_type;
+    using typename hash_base<index_hash<T>, T>::map_type;
     typedef hashmap<value_type, std::vector<int64_t>> MultiMap;
+    // the multimaps are partitioned like the maps
+    index_hash(int64_t partitions=1) : hash_base<index_hash<T>, T>(partitions), multimaps(this->maps.size()), has_duplicates(false) {}
 
     py::array_t<int64_t> map_index(py::array_t<value_type>& values) {
         int64_t size = values.size();
@@ -243,8 +399,10 @@ public:
                 output(i) = nan_index;
                 assert(this->nan_count > 0);
             } else {
-                auto search = this->map.find(value);
-                auto end = this->map.end();
+                uint64_t hash = this->hash(value);
+                const map_type& map = this->maps[this->partition(hash)];
+                auto search = map.find(value, hash);
+                auto end = map.end();
                 if(search == end) {
                     output(i) = -1;
                 } else {
@@ -272,8 +430,10 @@ public:
                 output(i) = missing_index;
                 assert(this->nan_count > 0);
             } else {
-                auto search = this->map.find(value);
-                auto end = this->map.end();
+                uint64_t hash = this->hash(value);
+                const map_type& map = this->maps[this->partition(hash)];
+                auto search = map.find(value, hash);
+                auto end = map.end();
                 if(search == end) {
                     output(i) = -1;
                 } else {
@@ -293,7 +453,6 @@ public:
         auto input = values.template unchecked<1>();
         auto input_mask = mask.template unchecked<1>();
 
-        const auto end = this->multimap.end(); // we don't modify the multimap, so keep this const
         {
             py::gil_scoped_release gil;
             for(size_t i = 0; i < size; i++) {
@@ -302,8 +461,10 @@ public:
                 } else
                 if(input_mask(i) == 1) {
                 } else {
-                    auto search = this->multimap.find(value);
-                    if(search != end) {
+                    uint64_t hash = this->hash(value);
+                    const MultiMap& multimap = this->multimaps[this->partition(hash)]; // we don't modify the multimap, so keep this const
+                    auto search = multimap.find(value);
+                    if(search != multimap.end()) {
                         found.push_back(*search);
                         size_output += search->second.size();
                         indices.insert(indices.end(), search->second.size(), start_index+i);
@@ -339,15 +500,16 @@ public:
 
         auto input = values.template unchecked<1>();
 
-        const auto end = this->multimap.end(); // we don't modify the multimap, so keep this const
         {
             py::gil_scoped_release gil;
             for(size_t i = 0; i < size; i++) {
                 const value_type& value = input(i);
                 if(custom_isnan(value)) {
                 } else {
-                    auto search = this->multimap.find(value);
-                    if(search != end) {
+                    uint64_t hash = this->hash(value);
+                    const MultiMap& multimap = this->multimaps[this->partition(hash)]; // we don't modify the multimap, so keep this const
+                    auto search = multimap.find(value);
+                    if(search != multimap.end()) {
                         found.push_back(*search);
                         size_output += search->second.size();
                         indices.insert(indices.end(), search->second.size(), start_index+i);
@@ -375,74 +537,168 @@ public:
         return std::make_tuple(indices_array, result);
     }
 
+    // Joins the (left) values of rows start_index... with this (right) index, and returns the left and right
+    // row indices of all matching pairs, in the order of the left rows. With keep_unmatched (left and outer
+    // joins) a left row without a match is paired with right row -1. Unlike map_index_duplicates, the vectors
+    // of duplicates are not copied, we count the pairs first, and write them directly into the output.
+    std::tuple<py::array_t<int64_t>, py::array_t<int64_t>> join(py::array_t<value_type>& values, int64_t start_index, bool keep_unmatched) {
+        return join_impl(values, nullptr, start_index, keep_unmatched);
+    }
+    std::tuple<py::array_t<int64_t>, py::array_t<int64_t>> join_with_mask(py::array_t<value_type>& values, py::array_t<uint8_t>& mask, int64_t start_index, bool keep_unmatched) {
+        if(mask.size() != values.size()) {
+            throw std::runtime_error("mask and values should have the same length");
+        }
+        return join_impl(values, mask.data(), start_index, keep_unmatched);
+    }
+    std::tuple<py::array_t<int64_t>, py::array_t<int64_t>> join_impl(py::array_t<value_type>& values, const uint8_t* mask, int64_t start_index, bool keep_unmatched) {
+        int64_t size = values.size();
+        auto input = values.template unchecked<1>();
+        // the first matching right row (or -1) and the other ones of each left row
+        std::vector<int64_t> first(size);
+        std::vector<const std::vector<int64_t>*> others(has_duplicates ? size : 0, nullptr);
+        int64_t pair_count = 0;
+        {
+            py::gil_scoped_release gil;
+            uint64_t hashes[HASH_BLOCK_SIZE];
+            for(int64_t block = 0; block < size; block += HASH_BLOCK_SIZE) {
+                int64_t block_end = std::min(size, block + HASH_BLOCK_SIZE);
+                this->hash_block(input, hashes, block, block_end);
+                for(int64_t i = block; i < block_end; i++) {
+                    const value_type& value = input(i);
+                    int64_t right = -1;
+                    if(mask && mask[i]) {
+                        right = this->null_count > 0 ? missing_index : -1;
+                    } else if(custom_isnan(value)) {
+                        right = this->nan_count > 0 ? nan_index : -1;
+                    } else {
+                        uint64_t hash = hashes[i - block];
+                        size_t partition = this->partition(hash);
+                        const map_type& map = this->maps[partition];
+                        auto search = map.find(value, hash);
+                        if(search != map.end()) {
+                            right = search->second;
+                            if(has_duplicates) {
+                                const MultiMap& multimap = multimaps[partition];
+                                auto search_duplicate = multimap.find(value, multimap.hash(value));
+                                if(search_duplicate != multimap.end()) {
+                                    others[i] = &search_duplicate->second;
+                                    pair_count += others[i]->size();
+                                }
+                            }
+                        }
+                    }
+                    first[i] = right;
+                    if(right != -1 || keep_unmatched) {
+                        pair_count++;
+                    }
+                }
+            }
+        }
+        py::array_t<int64_t> left_indices(pair_count);
+        py::array_t<int64_t> right_indices(pair_count);
+        int64_t* left_output = left_indices.mutable_data();
+        int64_t* right_output = right_indices.mutable_data();
+        py::gil_scoped_release gil;
+        int64_t j = 0;
+        for(int64_t i = 0; i < size; i++) {
+            if(first[i] != -1 || keep_unmatched) {
+                left_output[j] = start_index + i;
+                right_output[j++] = first[i];
+            }
+            if(has_duplicates && others[i]) {
+                for(int64_t right : *others[i]) {
+                    left_output[j] = start_index + i;
+                    right_output[j++] = right;
+                }
+            }
+        }
+        return std::make_tuple(left_indices, right_indices);
+    }
+
     void add_nan(int64_t index) {
         this->nan_index = index;
     }
     void add_missing(int64_t index) {
         this->missing_index = index;
     }
-    void add(value_type& value, int64_t index) {
-        this->map.emplace(value, index);
+    void add(map_type& map, uint64_t hash, value_type& value, int64_t index) {
+        map.emplace_hashed(hash, value, index);
         this->count++;
     }
     template<class Bucket>
-    void add(Bucket& position, value_type& value, int64_t index) {
+    void add(Bucket& position, uint64_t hash, value_type& value, int64_t index) {
         // we found a duplicate
-        multimap[position->first].push_back(index);
+        multimaps[this->partition(hash)][position->first].push_back(index);
         has_duplicates = true;
         this->count++;
     }
-    void merge(const index_hash & other) {
-        py::gil_scoped_release gil;
-        for (auto & elem : other.map) {
-            const value_type& value = elem.first;
-            auto search = this->map.find(value);
-            auto end = this->map.end();
-            if(search == end) {
-                this->map.emplace(value, elem.second);
-            } else {
-                // if already in, add it to the multimap
-                multimap[elem.first].push_back(elem.second);
-            }
-            this->count++;
-        }
-        this->nan_count += other.nan_count;
-        this->null_count += other.null_count;
-        for(auto el : other.multimap) {
-            std::vector<int64_t>& source = el.second;
-
-            value_type& value = el.first;
-            // const value_type& value = elem.first;
-            auto search = this->map.find(value);
-            auto end = this->map.end();
-            if(search == end) {
-                // we have a duplicate that is not in the current map, so we insert the first element
-                this->map.emplace(value, source[0]);
-                if(source.size() > 1) {
-                    std::vector<int64_t>& target = this->multimap[value];
-                    target.insert(target.end(), source.begin()+1, source.end());
+    int64_t merge_partition(const std::vector<const index_hash*>& others, size_t partition) {
+        map_type& map = this->maps[partition];
+        MultiMap& multimap = this->multimaps[partition];
+        int64_t count = 0;
+        for(auto other : others) {
+            this->for_each_in_partition(other->maps, partition, [&](const value_type& value, int64_t index, uint64_t hash) {
+                auto search = map.find(value, hash);
+                auto end = map.end();
+                if(search == end) {
+                    map.emplace_hashed(hash, value, index);
+                } else {
+                    // if already in, add it to the multimap
+                    multimap[value].push_back(index);
                 }
-            } else {
-                // easy case, just merge the vectors
-                std::vector<int64_t>& target = this->multimap[value];
-                target.insert(target.end(), source.begin(), source.end());
+                count++;
+            });
+            this->for_each_in_partition(other->multimaps, partition, [&](const value_type& value, const std::vector<int64_t>& source, uint64_t hash) {
+                auto search = map.find(value, hash);
+                auto end = map.end();
+                if(search == end) {
+                    // we have a duplicate that is not in the current map, so we insert the first element
+                    map.emplace_hashed(hash, value, source[0]);
+                    if(source.size() > 1) {
+                        std::vector<int64_t>& target = multimap[value];
+                        target.insert(target.end(), source.begin()+1, source.end());
+                    }
+                } else {
+                    // easy case, just merge the vectors
+                    std::vector<int64_t>& target = multimap[value];
+                    target.insert(target.end(), source.begin(), source.end());
+                }
+                count += source.size();
+            });
+        }
+        return count;
+    }
+    void merge_counts(const std::vector<const index_hash*>& others) {
+        for(auto other : others) {
+            // keep a row of the missing values and nans, in case we did not have them
+            if(this->nan_count == 0 && other->nan_count > 0) {
+                nan_index = other->nan_index;
             }
-            this->count += source.size();
+            if(this->null_count == 0 && other->null_count > 0) {
+                missing_index = other->missing_index;
+            }
+        }
+        hash_base<index_hash<T>, T>::merge_counts(others);
+        for(auto other : others) {
+            has_duplicates = has_duplicates || other->has_duplicates;
+        }
+        for(auto& multimap : multimaps) {
+            has_duplicates = has_duplicates || multimap.size() > 0;
         }
-        has_duplicates = has_duplicates || other.has_duplicates;
     }
     std::vector<value_type> keys() {
-        std::vector<value_type> v(this->map.size());
-        for(auto el : this->map) {
-            value_type value = el.first;
-            v[el.second] = value;
-
+        std::vector<value_type> v(this->size());
+        for(auto& map : this->maps) {
+            for(auto el : map) {
+                value_type value = el.first;
+                v[el.second] = value;
+            }
         }
         return v;
     }
     int64_t missing_index;
     int64_t nan_index;
-    MultiMap multimap; // this stores only the duplicates
+    std::vector<MultiMap> multimaps; // this stores only the duplicates
     bool has_duplicates;
 };
 } // namespace vaex
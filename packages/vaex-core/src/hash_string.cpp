@@ -113,6 +113,7 @@ void init_hash_string(py::module &m) {
             .def("keys", &Type::keys)
             .def("map_index", &Type::map_index)
             .def("map_index_duplicates", &Type::map_index_duplicates)
+            .def("join", &Type::join, "left and right row indices of the matching rows", py::arg("values"), py::arg("start_index"), py::arg("keep_unmatched"))
             .def("__len__", [](const Type &c) { return c.count + (c.null_count > 0) + (c.nan_count > 0); })
             .def_property_readonly("nan_count", [](const Type &c) { return c.nan_count; })
             .def_property_readonly("null_count", [](const Type &c) { return c.null_count; })
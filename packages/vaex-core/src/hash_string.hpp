@@ -16,12 +16,56 @@ namespace vaex {
     //     virtual std::vector<value_type> keys();
     // };
 
-template<class Derived, class T, class A=T, class V=T>
+const size_t STRING_ARENA_BLOCK_SIZE_MIN = 256;
+const size_t STRING_ARENA_BLOCK_SIZE_MAX = 64 * 1024;
+
+// Owns the bytes of the keys of a string hash map. A key is copied in only when it is new, so lookups
+// can use a string_view into the string data, and the bytes of many keys share a single allocation.
+// Blocks start small (many counters only hold a few keys) and grow. Keys never move, moving the
+// arena keeps them valid, copying it would not.
+class string_arena {
+public:
+    string_arena() : used(0), capacity(0) {}
+    string_arena(string_arena&& other) = default;
+    string_arena& operator=(string_arena&& other) = default;
+    string_arena(const string_arena&) = delete;
+    string_arena& operator=(const string_arena&) = delete;
+
+    string_view copy(const string_view& value) {
+        size_t size = value.size();
+        if(size == 0) {
+            return string_view("", 0);
+        }
+        if(size > STRING_ARENA_BLOCK_SIZE_MAX / 4) {
+            // large strings get their own allocation, so the current block stays in use
+            large_blocks.emplace_back(new char[size]);
+            memcpy(large_blocks.back().get(), value.data(), size);
+            return string_view(large_blocks.back().get(), size);
+        }
+        if(size > capacity - used) {
+            capacity = std::max(std::min(capacity * 2, STRING_ARENA_BLOCK_SIZE_MAX), std::max(size, STRING_ARENA_BLOCK_SIZE_MIN));
+            blocks.emplace_back(new char[capacity]);
+            used = 0;
+        }
+        char* target = blocks.back().get() + used;
+        memcpy(target, value.data(), size);
+        used += size;
+        return string_view(target, size);
+    }
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::unique_ptr<char[]>> large_blocks;
+    size_t used; // of the last block
+    size_t capacity; // of the last block
+};
+
+// The maps are keyed by string_view, the bytes of the keys live in the arena.
+template<class Derived, class T=string>
 class hash_base {
 public:
     using value_type = T;
-    using storage_type = A;
-    using storage_type_view = V;
+    using key_type = string_view;
+    using map_type = hashmap<key_type, int64_t, hash_string_view>;
     hash_base() : count(0), nan_count(0), null_count(0) {}  ;
     void update(StringSequence* strings, int64_t start_index=0) {
         py::gil_scoped_release gil;
@@ -31,99 +75,83 @@ public:
                     null_count++;
                     static_cast<Derived&>(*this).add_missing(start_index + i);
                 } else {
-                    auto value = strings->get(i);
-                    this->update1(value, start_index + i);
+                    string_view value = strings->view(i);
+                    this->update1(value, hash_of(strings, i, value), start_index + i);
                 }
         }
     }
-    void update1(std::string& value, int64_t index=0) {
-        auto search = this->map.find(value);
+    // the hash of string i, from the cached hashes when the sequence has them
+    uint64_t hash_of(const StringSequence* strings, int64_t i, const string_view& value) const {
+        return strings->hashes ? this->map.hash_from(strings->hashes[i]) : this->map.hash(value);
+    }
+    void update1(const string_view& value, int64_t index=0) {
+        update1(value, this->map.hash(value), index);
+    }
+    void update1(const string_view& value, uint64_t hash, int64_t index) {
+        auto search = this->map.find(value, hash);
         auto end = this->map.end();
         if(search == end) {
-            static_cast<Derived&>(*this).add(value, index);
+            static_cast<Derived&>(*this).add(value, hash, index);
         } else {
             static_cast<Derived&>(*this).add(search, value, index);
-        }  
+        }
     }
     void update1_null(int64_t index=0) {
         null_count++;
         static_cast<Derived&>(*this).add_missing(index);
     }
-    /*void update_with_mask(StringSequence* strings, py::array_t<bool>& masks, int64_t start_index=0) {
-        py::gil_scoped_release gil;
-        int64_t size = strings->length;
-        auto m = masks.template unchecked<1>();
-        assert(m.size() == size);
-        for(int64_t i = 0; i < size; i++) {
-                if(strings->is_null(i) || m[i]) {
-                    null_count++;
-                    static_cast<Derived&>(*this).add_missing(start_index + i);
-                } else {
-                    auto value = strings->get(i);
-                    auto search = this->map.find(value);
-                    auto end = this->map.end();
-                    if(search == end) {
-                        static_cast<Derived&>(*this).add(value, start_index + i);
-                    } else {
-                        static_cast<Derived&>(*this).add(search, value, start_index + i);
-                    }
-                }
-        }
-    }*/
+    // inserts a new key, with a copy of its bytes in the arena
+    template<class V>
+    typename map_type::iterator insert(const string_view& value, uint64_t hash, V&& map_value) {
+        return this->map.emplace_hashed(hash, arena.copy(value), std::forward<V>(map_value)).first;
+    }
     std::vector<value_type> keys() {
         std::vector<value_type> v;
         for(auto el : this->map) {
-            storage_type storage_value = el.first;
-            value_type value = *((value_type*)(&storage_value));
-            v.push_back(value);
-
+            v.push_back(string(el.first.data(), el.first.size()));
         }
         return v;
     }
     std::map<value_type, int64_t> extract() {
         std::map<value_type, int64_t> m;
         for(auto el : this->map) {
-            storage_type storage_value = el.first;
-            value_type value = *((value_type*)(&storage_value));
-            m[value] = el.second;
-
+            m[string(el.first.data(), el.first.size())] = el.second;
         }
         return m;
     }
 
-    // hashmap<storage_type, int64_t, hash_string, equal_string> map;
-    hashmap<storage_type, int64_t> map;
+    map_type map;
+    string_arena arena;
     int64_t count;
     int64_t nan_count;
     int64_t null_count;
 };
 
-template<class T=string, class A=T, class V=string>
-class counter : public hash_base<counter<T, A>, T, A, V> {
+template<class T=string>
+class counter : public hash_base<counter<T>, T> {
 public:
-    using typename hash_base<counter<T, A>, T, A, V>::value_type;
-    using typename hash_base<counter<T, A>, T, A, V>::storage_type;
-    using typename hash_base<counter<T, A>, T, A, V>::storage_type_view;
+    using typename hash_base<counter<T>, T>::value_type;
 
-    void add(storage_type_view& storage_view_value, int64_t index) {
-        this->map.emplace(storage_view_value, 1);
+    void add(const string_view& value, uint64_t hash, int64_t index) {
+        this->insert(value, hash, 1);
     }
 
     void add_missing(int64_t index) {
     }
 
     template<class Bucket>
-    void add(Bucket& bucket, storage_type_view& storage_view_value, int64_t index) {
+    void add(Bucket& bucket, const string_view& value, int64_t index) {
         set_second(bucket, bucket->second + 1);
     }
     void merge(const counter & other) {
-        py::gil_scoped_release gil;
+        gil_release_if_held gil;
         for (auto & elem : other.map) {
-            const value_type& value = elem.first;
-            auto search = this->map.find(value);
+            const string_view& value = elem.first;
+            uint64_t hash = this->map.hash(value);
+            auto search = this->map.find(value, hash);
             auto end = this->map.end();
             if(search == end) {
-                this->map.emplace(elem);
+                this->insert(value, hash, elem.second);
             } else {
                 set_second(search, search->second + elem.second);
             }
@@ -133,20 +161,16 @@ public:
     }
 };
 
-template<class T=string, class V=string>
-class ordered_set : public hash_base<ordered_set<T>, T, T, V> {
+template<class T=string>
+class ordered_set : public hash_base<ordered_set<T>, T> {
 public:
-    using typename hash_base<ordered_set<T>, T, T, V>::value_type;
-    using typename hash_base<ordered_set<T>, T, T, V>::storage_type;
-    using typename hash_base<ordered_set<T>, T, T, V>::storage_type_view;
+    using typename hash_base<ordered_set<T>, T>::value_type;
 
     static ordered_set* create(std::map<value_type, int64_t> dict, int64_t count, int64_t nan_count, int64_t null_count) {
         ordered_set* set = new ordered_set;
         for(auto el : dict) {
-            storage_type storage_value = el.first;
-            set->map.emplace(storage_value, el.second);
-            // value_type value = *((value_type*)(&storage_value));
-            // m[value] = el.second;
+            string_view value(el.first.data(), el.first.size());
+            set->insert(value, set->map.hash(value), el.second);
         }
         set->count = count;
         set->nan_count = nan_count;
@@ -182,8 +206,8 @@ public:
                     output(i) = 0;
                     assert(this->null_count > 0);
                 } else {
-                    const storage_type_view& value = strings->get(i);
-                    auto search = this->map.find(value);
+                    string_view value = strings->view(i);
+                    auto search = this->map.find(value, this->hash_of(strings, i, value));
                     auto end = this->map.end();
                     if(search == end) {
                         output(i) = -1;
@@ -194,8 +218,8 @@ public:
             }
         } else {
             for(int64_t i = 0; i < size; i++) {
-                const storage_type_view& value = strings->get(i);
-                auto search = this->map.find(value);
+                string_view value = strings->view(i);
+                auto search = this->map.find(value, this->hash_of(strings, i, value));
                 auto end = this->map.end();
                 if(search == end) {
                     output(i) = -1;
@@ -210,23 +234,24 @@ public:
     void add_missing(int64_t index) {
     }
 
-    void add(storage_type_view& storage_value, int64_t index) {
-        this->map.emplace(storage_value, this->count++);
+    void add(const string_view& value, uint64_t hash, int64_t index) {
+        this->insert(value, hash, this->count++);
     }
 
     template<class Bucket>
-    void add(Bucket& position, storage_type_view& storage_view_value, int64_t index) {
+    void add(Bucket& position, const string_view& value, int64_t index) {
         // duplicates can be detected by getting the __len__
     }
 
     void merge(const ordered_set & other) {
         py::gil_scoped_release gil;
         for (auto & elem : other.map) {
-            const value_type& value = elem.first;
-            auto search = this->map.find(value);
+            const string_view& value = elem.first;
+            uint64_t hash = this->map.hash(value);
+            auto search = this->map.find(value, hash);
             auto end = this->map.end();
             if(search == end) {
-                this->map.emplace(value, this->count);
+                this->insert(value, hash, this->count);
                 this->count++;
             } else {
                 // duplicates can be detected by getting the __len__
@@ -238,23 +263,20 @@ public:
     std::vector<string> keys() {
         std::vector<string> v(this->map.size());
         for(auto el : this->map) {
-            storage_type storage_value = el.first;
-            value_type value = *((value_type*)(&storage_value));
-            string export_value(value);
-            v[el.second] = export_value;
-
+            v[el.second] = string(el.first.data(), el.first.size());
         }
         return v;
     }
 };
 
-template<class T=string, class V=string>
-class index_hash : public hash_base<index_hash<T>, T, T, V> {
+template<class T=string>
+class index_hash : public hash_base<index_hash<T>, T> {
 public:
-    using typename hash_base<index_hash<T>, T, T, V>::value_type;
-    using typename hash_base<index_hash<T>, T, T, V>::storage_type;
-    using typename hash_base<index_hash<T>, T, T, V>::storage_type_view;
-    typedef hashmap<storage_type, std::vector<int64_t>> MultiMap;
+    using typename hash_base<index_hash<T>, T>::value_type;
+    using typename hash_base<index_hash<T>, T>::key_type;
+    // the keys are views of the keys of the map, so share its arena
+    typedef hashmap<key_type, std::vector<int64_t>, hash_string_view> MultiMap;
+    index_hash() : has_duplicates(false) {}
 
     py::array_t<int64_t> map_index(StringSequence* strings) {
         int64_t size = strings->length;
@@ -269,8 +291,8 @@ public:
                     output(i) = missing_index;
                     assert(this->null_count > 0);
                 } else {
-                    const storage_type_view& value = strings->get(i);
-                    auto search = this->map.find(value);
+                    string_view value = strings->view(i);
+                    auto search = this->map.find(value, this->hash_of(strings, i, value));
                     auto end = this->map.end();
                     if(search == end) {
                         output(i) = -1;
@@ -281,8 +303,8 @@ public:
             }
         } else {
             for(int64_t i = 0; i < size; i++) {
-                const storage_type_view& value = strings->get(i);
-                auto search = this->map.find(value);
+                string_view value = strings->view(i);
+                auto search = this->map.find(value, this->hash_of(strings, i, value));
                 auto end = this->map.end();
                 if(search == end) {
                     output(i) = -1;
@@ -307,8 +329,8 @@ public:
                 for(size_t i = 0; i < strings->length; i++) {
                     if(strings->is_null(i)) {
                     } else {
-                        const storage_type_view& value = strings->get(i);
-                        auto search = this->multimap.find(value);
+                        string_view value = strings->view(i);
+                        auto search = this->multimap.find(value, this->hash_of(strings, i, value));
                         if(search != end) {
                             found.push_back(*search);
                             size += search->second.size();
@@ -318,8 +340,8 @@ public:
                 }
             } else {
                 for(size_t i = 0; i < strings->length; i++) {
-                    const storage_type_view& value = strings->get(i);
-                    auto search = this->multimap.find(value);
+                    string_view value = strings->view(i);
+                    auto search = this->multimap.find(value, this->hash_of(strings, i, value));
                     if(search != end) {
                         found.push_back(*search);
                         size += search->second.size();
@@ -348,17 +370,72 @@ public:
         return std::make_tuple(indices_array, result);
     }
 
+    // Joins the (left) strings of rows start_index... with this (right) index, see index_hash::join in hash_primitives.hpp
+    std::tuple<py::array_t<int64_t>, py::array_t<int64_t>> join(StringSequence* strings, int64_t start_index, bool keep_unmatched) {
+        int64_t size = strings->length;
+        // the first matching right row (or -1) and the other ones of each left row
+        std::vector<int64_t> first(size);
+        std::vector<const std::vector<int64_t>*> others(has_duplicates ? size : 0, nullptr);
+        int64_t pair_count = 0;
+        {
+            py::gil_scoped_release gil;
+            for(int64_t i = 0; i < size; i++) {
+                int64_t right = -1;
+                if(strings->is_null(i)) {
+                    right = this->null_count > 0 ? missing_index : -1;
+                } else {
+                    string_view value = strings->view(i);
+                    uint64_t hash = this->hash_of(strings, i, value);
+                    auto search = this->map.find(value, hash);
+                    if(search != this->map.end()) {
+                        right = search->second;
+                        if(has_duplicates) {
+                            auto search_duplicate = multimap.find(value, hash);
+                            if(search_duplicate != multimap.end()) {
+                                others[i] = &search_duplicate->second;
+                                pair_count += others[i]->size();
+                            }
+                        }
+                    }
+                }
+                first[i] = right;
+                if(right != -1 || keep_unmatched) {
+                    pair_count++;
+                }
+            }
+        }
+        py::array_t<int64_t> left_indices(pair_count);
+        py::array_t<int64_t> right_indices(pair_count);
+        int64_t* left_output = left_indices.mutable_data();
+        int64_t* right_output = right_indices.mutable_data();
+        py::gil_scoped_release gil;
+        int64_t j = 0;
+        for(int64_t i = 0; i < size; i++) {
+            if(first[i] != -1 || keep_unmatched) {
+                left_output[j] = start_index + i;
+                right_output[j++] = first[i];
+            }
+            if(has_duplicates && others[i]) {
+                for(int64_t right : *others[i]) {
+                    left_output[j] = start_index + i;
+                    right_output[j++] = right;
+                }
+            }
+        }
+        return std::make_tuple(left_indices, right_indices);
+    }
+
     void add_missing(int64_t index) {
         this->missing_index = index;
     }
 
-    void add(storage_type_view& storage_value, int64_t index) {
-        this->map.emplace(storage_value, index);
+    void add(const string_view& value, uint64_t hash, int64_t index) {
+        this->insert(value, hash, index);
         this->count++;
     }
 
     template<class Bucket>
-    void add(Bucket& position, storage_type_view& storage_view_value, int64_t index) {
+    void add(Bucket& position, const string_view& value, int64_t index) {
         // we found a duplicate
         multimap[position->first].push_back(index);
         has_duplicates = true;
@@ -368,36 +445,40 @@ public:
     void merge(const index_hash & other) {
         py::gil_scoped_release gil;
         for (auto & elem : other.map) {
-            const value_type& value = elem.first;
-            auto search = this->map.find(value);
+            const string_view& value = elem.first;
+            uint64_t hash = this->map.hash(value);
+            auto search = this->map.find(value, hash);
             auto end = this->map.end();
             if(search == end) {
-                this->map.emplace(value, elem.second);
+                this->insert(value, hash, elem.second);
             } else {
                 // if already in, add it to the multimap
-                multimap[elem.first].push_back(elem.second);
+                multimap[search->first].push_back(elem.second);
             }
             this->count++;
         }
+        if(this->null_count == 0 && other.null_count > 0) {
+            missing_index = other.missing_index;
+        }
         this->nan_count += other.nan_count;
         this->null_count += other.null_count;
         for(auto el : other.multimap) {
             std::vector<int64_t>& source = el.second;
 
-            storage_type& storage_value = el.first;
-            // const value_type& value = elem.first;
-            auto search = this->map.find(storage_value);
+            const string_view& value = el.first;
+            uint64_t hash = this->map.hash(value);
+            auto search = this->map.find(value, hash);
             auto end = this->map.end();
             if(search == end) {
                 // we have a duplicate that is not in the current map, so we insert the first element
-                this->map.emplace(storage_value, source[0]);
+                search = this->insert(value, hash, source[0]);
                 if(source.size() > 1) {
-                    std::vector<int64_t>& target = this->multimap[storage_value];
+                    std::vector<int64_t>& target = this->multimap[search->first];
                     target.insert(target.end(), source.begin()+1, source.end());
                 }
             } else {
                 // easy case, just merge the vectors
-                std::vector<int64_t>& target = this->multimap[storage_value];
+                std::vector<int64_t>& target = this->multimap[search->first];
                 target.insert(target.end(), source.begin(), source.end());
             }
             this->count += source.size();
@@ -407,11 +488,7 @@ public:
     std::vector<string> keys() {
         std::vector<string> v(this->map.size());
         for(auto el : this->map) {
-            storage_type storage_value = el.first;
-            value_type value = *((value_type*)(&storage_value));
-            string export_value(value);
-            v[el.second] = export_value;
-
+            v[el.second] = string(el.first.data(), el.first.size());
         }
         return v;
     }
@@ -0,0 +1,182 @@
+#ifndef VAEX_HYPERLOGLOG_H
+#define VAEX_HYPERLOGLOG_H
+
+#include "agg.hpp"
+#include "bits.hpp"
+#include "flat_hash_map.hpp"
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace vaex {
+
+// the hash of a value for the sketch, with the same mixer as the hash maps
+template<class T>
+inline typename std::enable_if<std::is_floating_point<T>::value, uint64_t>::type hash_value64(T value) {
+    if(value == 0) // -0 and 0 are the same value
+        value = 0;
+    double d = value;
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return flat_hash_mix(bits);
+}
+
+template<class T>
+inline typename std::enable_if<!std::is_floating_point<T>::value, uint64_t>::type hash_value64(T value) {
+    return flat_hash_mix((uint64_t)value);
+}
+
+// HyperLogLog (Flajolet et al.) on a block of 2**precision registers: the first precision bits of the hash
+// select the register, which keeps the maximum position of the first 1 bit in the remaining bits
+inline void hll_add(uint8_t* registers, int precision, uint64_t hash) {
+    uint64_t index = hash >> (64 - precision);
+    uint64_t rest = hash << precision;
+    uint8_t rank = rest == 0 ? (64 - precision + 1) : (clz64(rest) + 1);
+    if(rank > registers[index])
+        registers[index] = rank;
+}
+
+inline void hll_merge(uint8_t* registers, const uint8_t* other, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        registers[i] = std::max(registers[i], other[i]);
+    }
+}
+
+inline double hll_estimate(const uint8_t* registers, int precision) {
+    size_t m = size_t(1) << precision;
+    double sum = 0;
+    size_t zeros = 0;
+    for(size_t i = 0; i < m; i++) {
+        sum += ldexp(1., -registers[i]);
+        zeros += registers[i] == 0;
+    }
+    double alpha = m == 16 ? 0.673 : (m == 32 ? 0.697 : (m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m)));
+    double estimate = alpha * m * m / sum;
+    // small range correction (linear counting), no large range correction needed for a 64 bit hash
+    if(estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log((double)m / zeros);
+    }
+    return estimate;
+}
+
+// Approximate number of unique values per cell, which takes 2**precision bytes per cell, instead of a hash map.
+// Missing values and nan are tracked separately and count as 1 unique value each (unless dropped).
+template<class GridType=uint64_t, class IndexType=default_index_type>
+class AggApproxNUniqueBase : public Aggregator {
+public:
+    using index_type = IndexType;
+    using grid_type = GridType;
+    enum {
+        FLAG_NULL = 1,
+        FLAG_NAN = 2
+    };
+    AggApproxNUniqueBase(Grid<IndexType>* grid, bool dropmissing, bool dropnan, int precision) : grid(grid), grid_data(nullptr), data_mask_ptr(nullptr), selection_mask_ptr(nullptr), dropmissing(dropmissing), dropnan(dropnan), precision(precision) {
+        if(precision < 4 || precision > 18) {
+            throw std::runtime_error("precision should be between 4 and 18");
+        }
+        register_count = size_t(1) << precision;
+        cells_length = grid->length1d;
+        registers = (uint8_t*)calloc(std::max<size_t>(cells_length * register_count, 1), 1);
+        flags = (uint8_t*)calloc(std::max<size_t>(cells_length, 1), 1);
+        // the estimates, filled in by reduce, always allocated since the buffer protocol exposes it
+        grid_data = (grid_type*)calloc(std::max<size_t>(cells_length, 1), sizeof(grid_type));
+        if(registers == nullptr || flags == nullptr || grid_data == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+    virtual ~AggApproxNUniqueBase() {
+        free(grid_data);
+        free(registers);
+        free(flags);
+    }
+    virtual void grow(size_t length) {
+        if(length > cells_length) {
+            size_t new_length = std::max(length, cells_length * 2);
+            grow_cells(registers, cells_length * register_count, new_length * register_count, (uint8_t)0);
+            grow_cells(flags, cells_length, new_length, (uint8_t)0);
+            grow_cells(grid_data, cells_length, new_length, (grid_type)0);
+            cells_length = new_length;
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        uint8_t* new_registers = (uint8_t*)calloc(std::max<size_t>(length * register_count, 1), 1);
+        if(new_registers == nullptr) {
+            throw std::bad_alloc();
+        }
+        for(size_t i = 0; i < mapping.size(); i++) {
+            memcpy(new_registers + mapping[i] * register_count, registers + i * register_count, register_count);
+        }
+        free(registers);
+        registers = new_registers;
+        remap_cells(flags, mapping, length, (uint8_t)0);
+        remap_cells(grid_data, mapping, length, (grid_type)0);
+        cells_length = length;
+    }
+    template<class Type>
+    void reduce_registers(std::vector<Type*> others) {
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                uint8_t* cell = registers + i * register_count;
+                for(auto other: others) {
+                    hll_merge(cell, other->registers + i * register_count, register_count);
+                    flags[i] |= other->flags[i];
+                }
+                grid_data[i] = (grid_type)std::llround(hll_estimate(cell, precision));
+                if(!dropmissing && (flags[i] & FLAG_NULL))
+                    grid_data[i] += 1;
+                if(!dropnan && (flags[i] & FLAG_NAN))
+                    grid_data[i] += 1;
+            }
+        });
+    }
+    void set_data_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_mask_ptr = (uint8_t*)info.ptr;
+        this->data_mask_size = info.shape[0];
+    }
+    void set_selection_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->selection_mask_ptr = (uint8_t*)info.ptr;
+        this->selection_mask_size = info.shape[0];
+    }
+    Grid<IndexType>* grid;
+    grid_type* grid_data;
+    uint8_t* registers;
+    uint8_t* flags;
+    size_t register_count;
+    size_t cells_length;
+    uint8_t* data_mask_ptr;
+    uint64_t data_mask_size;
+    uint8_t* selection_mask_ptr;
+    uint64_t selection_mask_size;
+    bool dropmissing;
+    bool dropnan;
+    int precision;
+};
+
+template<class Agg, class Base, class Module>
+void add_agg_approx_nunique(Module m, Base& base, const char* class_name) {
+    py::class_<Agg>(m, class_name, py::buffer_protocol(), base)
+        .def(py::init<Grid<>*, bool, bool, int>(), py::keep_alive<1, 2>())
+        .def_buffer(&grid_buffer_info<Agg>)
+        .def_property_readonly("grid", [](const Agg &agg) {
+                return agg.grid;
+            }
+        )
+        .def("set_data", &Agg::set_data)
+        .def("set_data_mask", &Agg::set_data_mask)
+        .def("set_selection_mask", &Agg::set_selection_mask)
+        .def("reduce", &reduce_aligned<Agg>)
+        .def("reduce", &reduce_aligned_into<Agg>)
+        .def("regrid", &regrid<Agg>, py::keep_alive<1, 2>())
+    ;
+}
+
+} // namespace vaex
+#endif
@@ -0,0 +1,343 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+#include <Python.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include "superstring.hpp"
+#include "thread_pool.hpp"
+
+namespace py = pybind11;
+
+namespace vaex {
+
+// below this many rows per worker, sorting in parallel does not pay off
+const int64_t SORT_ROWS_PER_WORKER_MIN = 1 << 16;
+
+// a row and the key it is sorted by
+struct sort_item {
+    uint64_t key;
+    int64_t index;
+};
+
+// Maps a value to an unsigned key with the same order, so integers and floats can be radix sorted.
+// The keys use the lower sizeof(T) bytes only, so small types need fewer passes.
+template<class T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, uint64_t>::type radix_key(T value) {
+    // relative to the minimum (modulo 2**64)
+    return uint64_t(int64_t(value)) - uint64_t(int64_t(std::numeric_limits<T>::min()));
+}
+template<class T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, uint64_t>::type radix_key(T value) {
+    return uint64_t(value);
+}
+template<class Bits, class T>
+inline uint64_t radix_key_floating(T value) {
+    // -0 and 0 are equal
+    value = value == 0 ? 0 : value;
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const Bits sign = Bits(1) << (sizeof(Bits) * 8 - 1);
+    // negative numbers have their order reversed, and come before the positive numbers
+    return (bits & sign) ? Bits(~bits) : Bits(bits ^ sign);
+}
+inline uint64_t radix_key(float value) {
+    return radix_key_floating<uint32_t>(value);
+}
+inline uint64_t radix_key(double value) {
+    return radix_key_floating<uint64_t>(value);
+}
+
+// the first 8 bytes of a string as a big endian number (zero padded), so comparing the keys of two strings
+// compares their first 8 bytes, like comparing the strings does
+inline uint64_t prefix_key(const string_view& value) {
+    uint64_t key = 0;
+    size_t length = std::min<size_t>(value.size(), 8);
+    for(size_t i = 0; i < length; i++) {
+        key |= uint64_t((unsigned char)value[i]) << (56 - 8 * i);
+    }
+    return key;
+}
+
+inline size_t sort_worker_count(ThreadPool& pool, int64_t length) {
+    return std::max<size_t>(1, std::min<size_t>(pool.thread_count(), length / SORT_ROWS_PER_WORKER_MIN));
+}
+
+// Stable LSD radix sort of the items by the lowest `bytes` bytes of the keys, a byte at a time. Each worker
+// counts the digits of its part of the items, and scatters them to its own offsets in the buffer.
+// Passes in which all keys have the same digit are skipped (e.g. the upper bytes of small integers).
+inline void radix_sort(std::vector<sort_item>& items, std::vector<sort_item>& buffer, int bytes, ThreadPool& pool) {
+    int64_t length = items.size();
+    size_t workers = sort_worker_count(pool, length);
+    std::vector<std::vector<int64_t>> offsets(workers, std::vector<int64_t>(256));
+    for(int byte = 0; byte < bytes; byte++) {
+        int shift = byte * 8;
+        pool.run(workers, [&](size_t worker) {
+            std::vector<int64_t>& counts = offsets[worker];
+            std::fill(counts.begin(), counts.end(), 0);
+            int64_t begin = length * worker / workers, end = length * (worker + 1) / workers;
+            for(int64_t i = begin; i < end; i++) {
+                counts[(items[i].key >> shift) & 0xff]++;
+            }
+        });
+        // turn the counts into offsets, ordered by digit, and by worker within a digit (which keeps it stable)
+        int64_t offset = 0;
+        bool trivial = false;
+        for(size_t digit = 0; digit < 256; digit++) {
+            int64_t digit_begin = offset;
+            for(size_t worker = 0; worker < workers; worker++) {
+                int64_t count = offsets[worker][digit];
+                offsets[worker][digit] = offset;
+                offset += count;
+            }
+            if(offset - digit_begin == length) {
+                trivial = true;
+            }
+        }
+        if(trivial) {
+            continue;
+        }
+        pool.run(workers, [&](size_t worker) {
+            std::vector<int64_t>& next = offsets[worker];
+            int64_t begin = length * worker / workers, end = length * (worker + 1) / workers;
+            for(int64_t i = begin; i < end; i++) {
+                buffer[next[(items[i].key >> shift) & 0xff]++] = items[i];
+            }
+        });
+        items.swap(buffer);
+    }
+}
+
+// the number of items taken from a in the first `diagonal` items of a stable merge of a and b
+template<class Less>
+int64_t merge_path(const sort_item* a, int64_t a_length, const sort_item* b, int64_t b_length, int64_t diagonal, Less less) {
+    int64_t low = std::max<int64_t>(0, diagonal - b_length);
+    int64_t high = std::min(diagonal, a_length);
+    while(low < high) {
+        int64_t middle = (low + high) / 2;
+        // on ties, items of a go first
+        if(!less(b[diagonal - middle - 1], a[middle])) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Stable parallel merge sort: each worker sorts a part of the items, after which the sorted runs are merged
+// in rounds. Each merge is split over several workers at points found by a binary search (merge path),
+// so all workers keep busy in the last rounds as well.
+template<class Less>
+void merge_sort(std::vector<sort_item>& items, std::vector<sort_item>& buffer, Less less, ThreadPool& pool) {
+    int64_t length = items.size();
+    size_t workers = sort_worker_count(pool, length);
+    std::vector<int64_t> bounds(workers + 1);
+    for(size_t i = 0; i <= workers; i++) {
+        bounds[i] = length * i / workers;
+    }
+    pool.run(workers, [&](size_t worker) {
+        std::stable_sort(items.begin() + bounds[worker], items.begin() + bounds[worker + 1], less);
+    });
+    for(size_t width = 1; width < workers; width *= 2) {
+        size_t merges = (workers + 2 * width - 1) / (2 * width);
+        size_t pieces = std::max<size_t>(1, workers / merges);
+        pool.run(workers, [&](size_t worker) {
+            for(size_t task = worker; task < merges * pieces; task += workers) {
+                size_t merge = task / pieces, piece = task % pieces;
+                int64_t begin = bounds[std::min(2 * width * merge, workers)];
+                int64_t middle = bounds[std::min(2 * width * merge + width, workers)];
+                int64_t end = bounds[std::min(2 * width * (merge + 1), workers)];
+                const sort_item* a = items.data() + begin;
+                const sort_item* b = items.data() + middle;
+                int64_t a_length = middle - begin, b_length = end - middle;
+                int64_t diagonal_begin = (end - begin) * piece / pieces;
+                int64_t diagonal_end = (end - begin) * (piece + 1) / pieces;
+                int64_t a_begin = merge_path(a, a_length, b, b_length, diagonal_begin, less);
+                int64_t a_end = merge_path(a, a_length, b, b_length, diagonal_end, less);
+                std::merge(a + a_begin, a + a_end, b + (diagonal_begin - a_begin), b + (diagonal_end - a_end),
+                           buffer.begin() + begin + diagonal_begin, less);
+            }
+        });
+        items.swap(buffer);
+    }
+}
+
+// Gives the order (argsort) of rows sorted by several keys, the first key is the most significant. The sort
+// is stable, also in descending order, and puts nan and then missing values last (or first).
+// Since all passes are stable, the keys are sorted one at a time starting from the least significant
+// (like np.lexsort): numbers with a parallel radix sort, strings with a parallel merge sort comparing
+// the first 8 bytes as an integer, and only looking at the strings when those are equal.
+class sorter {
+public:
+    // the class of a row, by which nan and missing values are moved to the end (or start) after a key is sorted
+    enum {
+        CLASS_VALUE = 0,
+        CLASS_NAN = 1,
+        CLASS_MISSING = 2
+    };
+    struct Key {
+        std::function<void(std::vector<sort_item>&, int64_t, int64_t)> fill;
+        std::function<uint8_t(int64_t)> row_class;
+        int bytes;
+        bool ascending;
+        const StringSequence* strings;
+    };
+    sorter(int64_t length) : length(length) {}
+
+    template<class T>
+    void add(py::array_t<T, py::array::c_style>& values, py::object mask, bool ascending) {
+        if(values.size() != length) {
+            throw std::runtime_error("the keys should have the same length");
+        }
+        const T* data = values.data();
+        const uint8_t* mask_data = nullptr;
+        if(!mask.is_none()) {
+            py::array_t<uint8_t, py::array::c_style> mask_array = mask.cast<py::array_t<uint8_t, py::array::c_style>>();
+            if(mask_array.size() != length) {
+                throw std::runtime_error("the mask should have the same length as the values");
+            }
+            mask_data = mask_array.data();
+            keep_alive.push_back(mask_array);
+        }
+        keep_alive.push_back(values);
+        Key key;
+        // descending keys count down from the largest key, so they keep using sizeof(T) bytes
+        const uint64_t key_max = sizeof(T) == 8 ? ~uint64_t(0) : (uint64_t(1) << (sizeof(T) * 8)) - 1;
+        key.fill = [data, mask_data, ascending, key_max](std::vector<sort_item>& items, int64_t begin, int64_t end) {
+            for(int64_t i = begin; i < end; i++) {
+                int64_t index = items[i].index;
+                T value = data[index];
+                if((mask_data && mask_data[index]) || value != value) {
+                    // all nan or missing values are equal, so they keep the order of the less significant keys
+                    items[i].key = 0;
+                } else {
+                    uint64_t key = radix_key(value);
+                    items[i].key = ascending ? key : key_max - key;
+                }
+            }
+        };
+        bool floating = std::is_floating_point<T>::value;
+        if(floating || mask_data) {
+            key.row_class = [data, mask_data](int64_t i) -> uint8_t {
+                if(mask_data && mask_data[i]) {
+                    return CLASS_MISSING;
+                }
+                return data[i] != data[i] ? CLASS_NAN : CLASS_VALUE;
+            };
+        }
+        key.bytes = sizeof(T);
+        key.ascending = ascending;
+        key.strings = nullptr;
+        keys.push_back(key);
+    }
+    void add_string(StringSequence* strings, bool ascending) {
+        if((int64_t)strings->length != length) {
+            throw std::runtime_error("the keys should have the same length");
+        }
+        Key key;
+        key.fill = [strings](std::vector<sort_item>& items, int64_t begin, int64_t end) {
+            for(int64_t i = begin; i < end; i++) {
+                items[i].key = prefix_key(view(strings, items[i].index));
+            }
+        };
+        if(strings->has_null()) {
+            key.row_class = [strings](int64_t i) -> uint8_t {
+                return strings->is_null(i) ? CLASS_MISSING : CLASS_VALUE;
+            };
+        }
+        key.bytes = 0;
+        key.ascending = ascending;
+        key.strings = strings;
+        keys.push_back(key);
+    }
+
+    py::array_t<int64_t> argsort(bool na_last) {
+        py::array_t<int64_t> result(length);
+        {
+            py::gil_scoped_release gil;
+            ThreadPool& pool = default_thread_pool();
+            std::vector<sort_item> items(length), buffer(length);
+            for(int64_t i = 0; i < length; i++) {
+                items[i].index = i;
+            }
+            for(auto key = keys.rbegin(); key != keys.rend(); ++key) {
+                fill(items, key->fill, pool);
+                if(key->strings) {
+                    const StringSequence* strings = key->strings;
+                    if(key->ascending) {
+                        merge_sort(items, buffer, [strings](const sort_item& a, const sort_item& b) {
+                            return a.key != b.key ? a.key < b.key : view(strings, a.index) < view(strings, b.index);
+                        }, pool);
+                    } else {
+                        merge_sort(items, buffer, [strings](const sort_item& a, const sort_item& b) {
+                            return a.key != b.key ? a.key > b.key : view(strings, b.index) < view(strings, a.index);
+                        }, pool);
+                    }
+                } else {
+                    radix_sort(items, buffer, key->bytes, pool);
+                }
+                if(key->row_class) {
+                    std::function<uint8_t(int64_t)> row_class = key->row_class;
+                    fill(items, [row_class, na_last](std::vector<sort_item>& items, int64_t begin, int64_t end) {
+                        for(int64_t i = begin; i < end; i++) {
+                            uint8_t value = row_class(items[i].index);
+                            items[i].key = na_last ? value : CLASS_MISSING - value;
+                        }
+                    }, pool);
+                    radix_sort(items, buffer, 1, pool);
+                }
+            }
+            int64_t* output = result.mutable_data();
+            for(int64_t i = 0; i < length; i++) {
+                output[i] = items[i].index;
+            }
+        }
+        return result;
+    }
+private:
+    // all missing strings are equal (empty), like nan and missing numbers
+    static string_view view(const StringSequence* strings, int64_t i) {
+        return strings->is_null(i) ? string_view() : strings->view(i);
+    }
+    void fill(std::vector<sort_item>& items, const std::function<void(std::vector<sort_item>&, int64_t, int64_t)>& f, ThreadPool& pool) {
+        size_t workers = sort_worker_count(pool, length);
+        pool.run(workers, [&](size_t worker) {
+            f(items, length * worker / workers, length * (worker + 1) / workers);
+        });
+    }
+    int64_t length;
+    std::vector<Key> keys;
+    std::vector<py::object> keep_alive;
+};
+
+template<class T>
+void add_sorter_key(py::class_<sorter>& cls, std::string postfix) {
+    cls.def(("add_" + postfix).c_str(), &sorter::add<T>, py::arg("values"), py::arg("mask") = py::none(), py::arg("ascending") = true);
+}
+
+void init_sort(py::module &m) {
+    // the StringSequence keys are defined in vaex.superstrings
+    py::module::import("vaex.superstrings");
+    py::class_<sorter> cls(m, "sorter");
+    cls.def(py::init<int64_t>(), py::arg("length"))
+        .def("add_string", &sorter::add_string, py::arg("strings"), py::arg("ascending") = true, py::keep_alive<1, 2>())
+        .def("argsort", &sorter::argsort, "the order of the rows, sorted by the keys", py::arg("na_last") = true)
+    ;
+    add_sorter_key<int8_t>(cls, "int8");
+    add_sorter_key<int16_t>(cls, "int16");
+    add_sorter_key<int32_t>(cls, "int32");
+    add_sorter_key<int64_t>(cls, "int64");
+    add_sorter_key<uint8_t>(cls, "uint8");
+    add_sorter_key<uint16_t>(cls, "uint16");
+    add_sorter_key<uint32_t>(cls, "uint32");
+    add_sorter_key<uint64_t>(cls, "uint64");
+    add_sorter_key<float>(cls, "float32");
+    add_sorter_key<double>(cls, "float64");
+}
+
+} // namespace vaex
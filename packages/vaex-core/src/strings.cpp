@@ -10,7 +10,10 @@
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
 #include <numpy/arrayobject.h>
 #include <Python.h>
+#include <atomic>
 #include "superstring.hpp"
+#include "hash.hpp"
+#include "thread_pool.hpp"
 
 // #define VAEX_REGEX_USE_XPRESSIVE
 #define VAEX_REGEX_USE_PCRE
@@ -372,38 +375,59 @@ class StringSequenceBase : public StringSequence {
         auto m = matches.mutable_unchecked<1>();
         {
             py::gil_scoped_release release;
-            if(has_null() || others->has_null()) {
-                for(size_t i = 0; i < length; i++) {
-                    bool found = false;
-                    if(is_null(i)) {
-                        auto str = view(i);
-                        for(size_t j = 0; j < others->length; j++) {
-                            if(others->is_null(j)) {
-                                auto other = others->view(j);
-                                found = str == other;
-                                if(found)
-                                    break;
-                            }
-                        }
-                    }
-                    m(i) = found;
+            // a set of the other strings, using the cached hashes when available
+            vaex::hashmap<string_view, bool, vaex::hash_string_view> set;
+            bool others_has_null = false;
+            set.reserve(others->length);
+            for(size_t j = 0; j < others->length; j++) {
+                if(others->is_null(j)) {
+                    others_has_null = true;
+                } else {
+                    auto other = others->view(j);
+                    uint64_t hash = others->hashes ? set.hash_from(others->hashes[j]) : set.hash(other);
+                    set.emplace_hashed(hash, other, true);
                 }
-            } else {
-                for(size_t i = 0; i < length; i++) {
+            }
+            for(size_t i = 0; i < length; i++) {
+                if(is_null(i)) {
+                    m(i) = others_has_null;
+                } else {
                     auto str = view(i);
-                    bool found = false;
-                    for(size_t j = 0; j < others->length; j++) {
-                        auto other = others->view(j);
-                        found = str == other;
-                        if(found)
-                            break;
-                    }
-                    m(i) = found;
+                    uint64_t hash = hashes ? set.hash_from(hashes[i]) : set.hash(str);
+                    m(i) = set.find(str, hash) != set.end();
                 }
             }
         }
         return std::move(matches);
     }
+    // hash_bytes of each string (0 for missing values), computed in parallel, these can be
+    // cached with StringList.set_hashes, or stored next to the strings (see export_hdf5)
+    py::object hash_values() {
+        py::array_t<uint64_t> result(length);
+        uint64_t* output = result.mutable_data();
+        {
+            py::gil_scoped_release release;
+            const size_t task_size = 1024*64;
+            const size_t task_count = (length + task_size - 1) / task_size;
+            std::atomic<size_t> next_task(0);
+            vaex::ThreadPool& pool = vaex::default_thread_pool();
+            pool.run(std::min(task_count, pool.thread_count()), [&](size_t worker) {
+                size_t task;
+                while((task = next_task++) < task_count) {
+                    size_t end = std::min(length, (task + 1) * task_size);
+                    for(size_t i = task * task_size; i < end; i++) {
+                        if(is_null(i)) {
+                            output[i] = 0;
+                        } else {
+                            auto str = view(i);
+                            output[i] = vaex::hash_bytes(str.data(), str.size());
+                        }
+                    }
+                }
+            });
+        }
+        return std::move(result);
+    }
     py::object tolist() {
         py::list l;
         for(size_t i = 0; i < length; i++) {
@@ -653,12 +677,16 @@ public:
     // a slice for when the indices are not filled yet
     StringList* slice_byte_offset(size_t i1, size_t i2, size_t byte_offset) {
         size_t byte_length = this->byte_length - byte_offset;
-        return new StringList(bytes+byte_offset, byte_length, indices+i1, i2-i1, offset+byte_offset, null_bitmap, i1);
+        StringList* sliced = new StringList(bytes+byte_offset, byte_length, indices+i1, i2-i1, offset+byte_offset, null_bitmap, i1);
+        sliced->hashes = hashes ? hashes + i1 : nullptr;
+        return sliced;
     }
     StringList* slice(size_t i1, size_t i2) {
         size_t byte_offset = indices[i1] - offset;
         size_t byte_length = indices[i2] - offset - byte_offset;
-        return new StringList(bytes+byte_offset, byte_length, indices+i1, i2-i1, offset+byte_offset, null_bitmap, i1);
+        StringList* sliced = new StringList(bytes+byte_offset, byte_length, indices+i1, i2-i1, offset+byte_offset, null_bitmap, i1);
+        sliced->hashes = hashes ? hashes + i1 : nullptr;
+        return sliced;
     }
     size_t fill_from(const StringSequence& from) {
         if(length < from.length) {
@@ -1972,6 +2000,14 @@ void add_string_list(Module m, Base& base, const char* class_name) {
         .def("slice", &StringList::slice, py::keep_alive<0, 1>())
         .def("slice", &StringList::slice_byte_offset, py::keep_alive<0, 1>())
         .def("fill_from", &StringList::fill_from)
+        .def("set_hashes", [](StringList &sl, py::array_t<uint64_t, py::array::c_style> hashes) {
+                py::buffer_info info = hashes.request();
+                if(info.ndim != 1 || (size_t)info.shape[0] != sl.length) {
+                    throw std::runtime_error("Expected a 1d hash buffer with a hash for each string");
+                }
+                sl.hashes = (const uint64_t*)info.ptr;
+            }, py::keep_alive<1, 2>() // keep a reference to the ndarray
+        )
         // .def("get", (const std::string (StringList::*)(size_t))&StringList::get)
         // bug? we have to add this again
         // .def("get", (py::object (StringSequenceBase::*)(size_t, size_t))&StringSequenceBase::get, py::return_value_policy::take_ownership)
@@ -1995,6 +2031,15 @@ void add_string_list(Module m, Base& base, const char* class_name) {
                 }
             }
         )
+        .def_property_readonly("hashes", [](const StringList &sl) -> py::object {
+                if(sl.hashes) {
+                    auto capsule = py::capsule(&sl, [](void *v) {  });
+                    return py::array_t<uint64_t>(sl.length, sl.hashes, capsule);
+                } else  {
+                    return py::cast<py::none>(Py_None);
+                }
+            }
+        )
         .def_property_readonly("offset", [](const StringList &sl) {
                 return sl.offset;
             }
@@ -2131,6 +2176,7 @@ PYBIND11_MODULE(superstrings, m) {
         .def("endswith", &StringSequenceBase::endswith)
         .def("find", &StringSequenceBase::find)
         .def("isin", &StringSequenceBase::isin)
+        .def("hash_values", &StringSequenceBase::hash_values)
         .def("lower", &StringSequenceBase::lower)
         .def("match", &StringSequenceBase::match, "Tests if strings matches regex", py::arg("pattern"))
         .def("equals", &StringSequenceBase::equals, "Tests if strings are equal")
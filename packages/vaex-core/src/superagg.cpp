@@ -1,10 +1,14 @@
 #include "agg.hpp"
+#include "bits.hpp"
 #include <stdint.h>
 #include <limits>
+#include <type_traits>
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
 #include <numpy/arrayobject.h>
 #include <Python.h>
 #include "superstring.hpp"
+#include "binner_simd.hpp"
+#include "tdigest.hpp"
 
 using namespace vaex;
 
@@ -19,6 +23,12 @@ public:
     virtual ~BinnerScalar() { }
     virtual void to_bins(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
         const double scale_v = 1./ (vmax-vmin);
+        if(!FlipEndian) {
+            const uint8_t* mask = data_mask_ptr ? data_mask_ptr + offset : nullptr;
+            if(simd::to_bins_scalar<T>(ptr + offset, mask, output, length, stride, vmin, scale_v, bins)) {
+                return;
+            }
+        }
         if(data_mask_ptr) {
             for(uint64_t i = offset; i < offset + length; i++) {
                 T value = ptr[i];
@@ -91,6 +101,136 @@ public:
     uint64_t data_mask_size;
 };
 
+// above this number of edges, BinnerEdges searches in the Eytzinger (breadth first) layout, which
+// keeps the first levels of the search in the same cache lines
+const size_t EYTZINGER_EDGES_MIN = 256;
+
+// Bins by a sorted array of edges, where bin i holds the values in [edges[i], edges[i+1]), so that
+// non uniform bins (e.g. logarithmic or quantiles) bin as fast as BinnerScalar. Like BinnerScalar, nan and
+// missing values go to bin 0, values below the first edge to 1, and values from the last edge on to the last bin.
+// The search for the number of edges <= value (which is the index - 1) has no data dependent branches.
+template<class T=double, class BinIndexType=default_index_type, bool FlipEndian=false>
+class BinnerEdges : public Binner {
+public:
+    using index_type = BinIndexType;
+    BinnerEdges(std::string expression, std::vector<double> edges) : Binner(expression), edges(edges), data_mask_ptr(nullptr) {
+        if(edges.size() < 2) {
+            throw std::runtime_error("Expected at least 2 edges");
+        }
+        for(size_t i = 0; i < edges.size(); i++) {
+            if(edges[i] != edges[i] || (i > 0 && edges[i] < edges[i-1])) {
+                throw std::runtime_error("Expected sorted edges, without nan");
+            }
+        }
+        if(edges.size() >= EYTZINGER_EDGES_MIN) {
+            // eytzinger[k] has children 2k and 2k+1, and rank[k] is its index in edges
+            eytzinger.resize(edges.size() + 1);
+            rank.resize(edges.size() + 1);
+            size_t i = 0;
+            build_eytzinger(i, 1);
+            // a search that ends beyond the leaves means all edges are <= value
+            rank[0] = edges.size();
+        }
+    }
+    BinnerEdges* copy() {
+        return new BinnerEdges(*this);
+    }
+    virtual ~BinnerEdges() { }
+    virtual void to_bins(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
+        if(eytzinger.size()) {
+            if(data_mask_ptr) {
+                to_bins_<true, true>(offset, output, length, stride);
+            } else {
+                to_bins_<true, false>(offset, output, length, stride);
+            }
+        } else {
+            if(data_mask_ptr) {
+                to_bins_<false, true>(offset, output, length, stride);
+            } else {
+                to_bins_<false, false>(offset, output, length, stride);
+            }
+        }
+    }
+    template<bool Eytzinger, bool Masked>
+    void to_bins_(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
+        for(uint64_t i = offset; i < offset + length; i++) {
+            T value = ptr[i];
+            if(FlipEndian) {
+                value = _to_native<>(value);
+            }
+            double value_double = value;
+            index_type index = 0;
+            // this followes numpy, 1 is masked
+            bool masked = Masked && data_mask_ptr[i] == 1;
+            if(value_double == value_double && !masked) {
+                index = (Eytzinger ? count_le_eytzinger(value_double) : count_le(value_double)) + 1;
+            }
+            output[i-offset] += index * stride;
+        }
+    }
+    // the number of edges <= value
+    inline size_t count_le(double value) const {
+        const double* base = &edges[0];
+        size_t n = edges.size();
+        while(n > 1) {
+            size_t half = n / 2;
+            base = (base[half] <= value) ? base + half : base;
+            n -= half;
+        }
+        return (base - &edges[0]) + (*base <= value);
+    }
+    inline size_t count_le_eytzinger(double value) const {
+        const size_t n = edges.size();
+        size_t k = 1;
+        while(k <= n) {
+            prefetch(&eytzinger[0] + std::min(k * 16, n));
+            k = 2 * k + (eytzinger[k] <= value);
+        }
+        // undo the right turns after the last left turn, which took us to the first edge > value
+        k >>= ffs64(~(uint64_t)k);
+        return rank[k];
+    }
+    virtual uint64_t size() {
+        return _size;
+    }
+    virtual uint64_t shape() {
+        return edges.size() + 2;
+    }
+    void set_data(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->ptr = (T*)info.ptr;
+        this->_size = info.shape[0];
+    }
+    void set_data_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_mask_ptr = (uint8_t*)info.ptr;
+        this->data_mask_size = info.shape[0];
+    }
+    std::vector<double> edges;
+    std::vector<double> eytzinger;
+    std::vector<uint64_t> rank;
+    T* ptr;
+    uint64_t _size;
+    uint8_t* data_mask_ptr;
+    uint64_t data_mask_size;
+private:
+    // in order traversal of the implicit tree fills it with the sorted edges
+    void build_eytzinger(size_t& i, size_t k) {
+        if(k <= edges.size()) {
+            build_eytzinger(i, 2 * k);
+            eytzinger[k] = edges[i];
+            rank[k] = i++;
+            build_eytzinger(i, 2 * k + 1);
+        }
+    }
+};
+
 template<class T=uint64_t, class BinIndexType=default_index_type, bool FlipEndian=false>
 class BinnerOrdinal : public Binner {
 public:
@@ -103,10 +243,11 @@ public:
     virtual void to_bins(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
         if(data_mask_ptr) {
             for(uint64_t i = offset; i < offset + length; i++) {
-                T value = ptr[i] - min_value;
+                T value = ptr[i];
                 if(FlipEndian) {
                     value = _to_native<>(value);
                 }
+                value = value - min_value;
                 index_type index = 0;
                 // this followes numpy, 1 is masked
                 bool masked = data_mask_ptr[i] == 1;
@@ -122,10 +263,11 @@ public:
             }
         } else {
             for(uint64_t i = offset; i < offset + length; i++) {
-                T value = ptr[i] - min_value;
+                T value = ptr[i];
                 if(FlipEndian) {
                     value = _to_native<>(value);
                 }
+                value = value - min_value;
                 index_type index = 0;
                 if(value != value) { // nan goes to index 0                
                 } else if (value < 0) { // smaller values are put at offset 1
@@ -175,6 +317,548 @@ public:
     uint64_t data_mask_size;
 };
 
+// floor(a / b) for b > 0, like Python's // (C++ rounds towards zero)
+inline int64_t floor_divide(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return q - ((a % b) < 0);
+}
+
+// the number of months since 1970-01, from the number of days since 1970-01-01 (proleptic Gregorian calendar)
+// see http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+inline int64_t months_from_days(int64_t days) {
+    int64_t z = days + 719468;
+    int64_t era = floor_divide(z, 146097);
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153; // months since March
+    // years starting in March, we want January
+    int64_t month = mp < 10 ? mp + 2 : mp - 10;
+    int64_t year = yoe + era * 400 + (mp >= 10);
+    return (year - 1970) * 12 + month;
+}
+
+// Bins datetime64 values (int64 in units of 1/TicksPerDay day) in calendar periods, replacing the
+// expression (x.astype('M8[<resolution>]') - begin).astype('int') // every, without the temporaries.
+// The resolution is a numpy datetime unit, 'Y' and 'M' bin by calendar month, the others have a fixed length.
+// NaT and missing values go to bin 0, begin is the number of periods since the epoch of the first bin.
+template<int64_t TicksPerDay, class BinIndexType=default_index_type, bool FlipEndian=false>
+class BinnerTime : public Binner {
+public:
+    using index_type = BinIndexType;
+    BinnerTime(std::string expression, std::string resolution, int64_t every, int64_t begin, uint64_t ordinal_count) : Binner(expression), resolution(resolution), every(every), begin(begin), ordinal_count(ordinal_count), ptr(nullptr), data_mask_ptr(nullptr) {
+        if(every < 1) {
+            throw std::runtime_error("every should be positive");
+        }
+        calendar = resolution == "Y" || resolution == "M";
+        if(calendar) {
+            period = resolution == "Y" ? 12 : 1;
+        } else {
+            int64_t periods_per_day;
+            if(resolution == "W") {
+                // like numpy, weeks start on the day of the week of 1970-01-01 (Thursday)
+                periods_per_day = 0;
+                period = 7 * TicksPerDay;
+            } else if(resolution == "D") {
+                periods_per_day = 1;
+            } else if(resolution == "h") {
+                periods_per_day = 24;
+            } else if(resolution == "m") {
+                periods_per_day = 24 * 60;
+            } else if(resolution == "s") {
+                periods_per_day = 24 * 60 * 60;
+            } else if(resolution == "ms") {
+                periods_per_day = 24 * 60 * 60 * 1000LL;
+            } else if(resolution == "us") {
+                periods_per_day = 24 * 60 * 60 * 1000000LL;
+            } else if(resolution == "ns") {
+                periods_per_day = 24 * 60 * 60 * 1000000000LL;
+            } else {
+                throw std::runtime_error("unsupported resolution: " + resolution);
+            }
+            if(periods_per_day) {
+                if(periods_per_day > TicksPerDay || TicksPerDay % periods_per_day != 0) {
+                    throw std::runtime_error("resolution " + resolution + " is finer than the unit of the data");
+                }
+                period = TicksPerDay / periods_per_day;
+            }
+        }
+    }
+    BinnerTime* copy() {
+        return new BinnerTime(*this);
+    }
+    virtual ~BinnerTime() { }
+    virtual void to_bins(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
+        if(calendar) {
+            to_bins_<true>(offset, output, length, stride);
+        } else {
+            to_bins_<false>(offset, output, length, stride);
+        }
+    }
+    template<bool Calendar>
+    void to_bins_(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
+        const int64_t nat = std::numeric_limits<int64_t>::min();
+        for(uint64_t i = offset; i < offset + length; i++) {
+            int64_t value = ptr[i];
+            if(FlipEndian) {
+                value = _to_native<>(value);
+            }
+            index_type index = 0;
+            // this followes numpy, 1 is masked
+            bool masked = data_mask_ptr && data_mask_ptr[i] == 1;
+            if(value != nat && !masked) {
+                int64_t periods = Calendar ? floor_divide(months_from_days(floor_divide(value, TicksPerDay)), period) : floor_divide(value, period);
+                int64_t bin = floor_divide(periods - begin, every);
+                // smaller values are put at offset 1, bigger values at offset -1 (last), real data starts at 2
+                index = bin < 0 ? 1 : ((uint64_t)bin >= ordinal_count ? ordinal_count + 2 : bin + 2);
+            }
+            output[i-offset] += index * stride;
+        }
+    }
+    virtual uint64_t size() {
+        return _size;
+    }
+    virtual uint64_t shape() {
+        return ordinal_count + 3;
+    }
+    void set_data(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        if(info.itemsize != sizeof(int64_t)) {
+            throw std::runtime_error("Expected 64 bit datetime values");
+        }
+        this->ptr = (int64_t*)info.ptr;
+        this->_size = info.shape[0];
+    }
+    void set_data_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_mask_ptr = (uint8_t*)info.ptr;
+        this->data_mask_size = info.shape[0];
+    }
+    std::string resolution;
+    int64_t every;
+    int64_t begin;
+    uint64_t ordinal_count;
+    bool calendar;
+    int64_t period; // in ticks, or months for calendar resolutions
+    int64_t* ptr;
+    uint64_t _size;
+    uint8_t* data_mask_ptr;
+    uint64_t data_mask_size;
+};
+
+// Bins by value, where a value gets the next free bin the first time we see it, so there is no need for
+// a pass over the data to find the unique values first (like groupby.Grouper does). Each thread bins with its
+// own copy, whose bins are reconciled in Grid::align using merge_bins, which means this needs a sparse grid.
+// Missing values and nan get a bin of their own, and values beyond max_groups go to the overflow bin.
+template<class Key, class BinIndexType=default_index_type>
+class BinnerHashBase : public Binner {
+public:
+    using index_type = BinIndexType;
+    BinnerHashBase(std::string expression, uint64_t max_groups) : Binner(expression), max_groups(max_groups), null_bin(0), nan_bin(0) { }
+    virtual uint64_t shape() {
+        return max_groups + 3;
+    }
+    virtual std::vector<uint64_t> merge_bins(Binner& other_binner) {
+        BinnerHashBase* other = dynamic_cast<BinnerHashBase*>(&other_binner);
+        if(other == nullptr) {
+            throw std::runtime_error("cannot merge the bins of a different type of binner");
+        }
+        if(other == this) {
+            return std::vector<uint64_t>();
+        }
+        std::vector<uint64_t> mapping(other->bin_keys.size() + 2);
+        mapping[0] = 0;
+        mapping[1] = 1;
+        for(size_t i = 0; i < other->bin_keys.size(); i++) {
+            index_type bin = i + 2;
+            if(bin == other->null_bin) {
+                mapping[bin] = this->bin_null();
+            } else if(bin == other->nan_bin) {
+                mapping[bin] = this->bin_nan();
+            } else {
+                mapping[bin] = this->bin_value(other->bin_keys[i]);
+            }
+        }
+        return mapping;
+    }
+    index_type bin_value(const Key& value) {
+        auto search = map.find(value);
+        if(search != map.end()) {
+            return search->second;
+        }
+        index_type bin = this->new_bin(value);
+        if(bin != overflow_bin()) {
+            map.emplace(value, bin);
+        }
+        return bin;
+    }
+    index_type bin_null() {
+        if(null_bin == 0) {
+            null_bin = this->new_bin(Key());
+        }
+        return null_bin;
+    }
+    index_type bin_nan() {
+        if(nan_bin == 0) {
+            nan_bin = this->new_bin(Key());
+        }
+        return nan_bin;
+    }
+    index_type overflow_bin() const {
+        return max_groups + 2;
+    }
+    uint64_t max_groups;
+    // bin i+2 holds bin_keys[i], for the null and nan bin this is a placeholder
+    std::vector<Key> bin_keys;
+    hashmap<Key, index_type> map;
+    index_type null_bin; // 0 when not seen
+    index_type nan_bin;
+private:
+    index_type new_bin(const Key& key) {
+        if(bin_keys.size() >= max_groups) {
+            return overflow_bin();
+        }
+        bin_keys.push_back(key);
+        return bin_keys.size() + 1;
+    }
+};
+
+template<class T=uint64_t, class BinIndexType=default_index_type, bool FlipEndian=false>
+class BinnerHash : public BinnerHashBase<T, BinIndexType> {
+public:
+    using Base = BinnerHashBase<T, BinIndexType>;
+    using typename Base::index_type;
+    BinnerHash(std::string expression, uint64_t max_groups) : Base(expression, max_groups), ptr(nullptr), _size(0), data_mask_ptr(nullptr) { }
+    BinnerHash* copy() {
+        return new BinnerHash(*this);
+    }
+    virtual ~BinnerHash() { }
+    virtual void to_bins(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
+        for(uint64_t i = offset; i < offset + length; i++) {
+            index_type index;
+            // this followes numpy, 1 is masked
+            if(data_mask_ptr && data_mask_ptr[i] == 1) {
+                index = this->bin_null();
+            } else {
+                T value = ptr[i];
+                if(FlipEndian) {
+                    value = _to_native<>(value);
+                }
+                if(value != value) {
+                    index = this->bin_nan();
+                } else {
+                    index = this->bin_value(value);
+                }
+            }
+            output[i-offset] += index * stride;
+        }
+    }
+    virtual uint64_t size() {
+        return _size;
+    }
+    py::array_t<T> keys() {
+        py::array_t<T> result(this->bin_keys.size());
+        auto output = result.template mutable_unchecked<1>();
+        for(size_t i = 0; i < this->bin_keys.size(); i++) {
+            output(i) = this->bin_keys[i];
+        }
+        return result;
+    }
+    void set_data(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->ptr = (T*)info.ptr;
+        this->_size = info.shape[0];
+    }
+    void set_data_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_mask_ptr = (uint8_t*)info.ptr;
+        this->data_mask_size = info.shape[0];
+    }
+    T* ptr;
+    uint64_t _size;
+    uint8_t* data_mask_ptr;
+    uint64_t data_mask_size;
+};
+
+template<class BinIndexType=default_index_type>
+class BinnerHashString : public BinnerHashBase<std::string, BinIndexType> {
+public:
+    using Base = BinnerHashBase<std::string, BinIndexType>;
+    using typename Base::index_type;
+    BinnerHashString(std::string expression, uint64_t max_groups) : Base(expression, max_groups), string_sequence(nullptr), data_mask_ptr(nullptr) { }
+    BinnerHashString* copy() {
+        return new BinnerHashString(*this);
+    }
+    virtual ~BinnerHashString() { }
+    virtual void to_bins(uint64_t offset, index_type* output, uint64_t length, uint64_t stride) {
+        for(uint64_t i = offset; i < offset + length; i++) {
+            index_type index;
+            if((data_mask_ptr && data_mask_ptr[i] == 1) || string_sequence->is_null(i)) {
+                index = this->bin_null();
+            } else {
+                index = this->bin_value(string_sequence->get(i));
+            }
+            output[i-offset] += index * stride;
+        }
+    }
+    virtual uint64_t size() {
+        return string_sequence->length;
+    }
+    std::vector<std::string> keys() {
+        return this->bin_keys;
+    }
+    void set_data(StringSequence* string_sequence) {
+        this->string_sequence = string_sequence;
+    }
+    void set_data_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_mask_ptr = (uint8_t*)info.ptr;
+        this->data_mask_size = info.shape[0];
+    }
+    StringSequence* string_sequence;
+    uint8_t* data_mask_ptr;
+    uint64_t data_mask_size;
+};
+
+// Fused bin+aggregate kernels: for 1 or 2 scalar/ordinal binners and a single count/sum/min/max
+// aggregator, we compute the bin index and update the grid in one loop, instead of writing the
+// indices to a buffer with virtual calls per block. The binner and aggregator state is copied
+// into the kernel structs, so the compiler can keep it in registers.
+// Only the common (native endian) types are instantiated, to keep the compile time and binary size
+// in check; other combinations use the generic path.
+
+template<class T>
+struct BinKernelScalar {
+    BinKernelScalar(BinnerScalar<T>* binner) : ptr(binner->ptr), mask(binner->data_mask_ptr), vmin(binner->vmin), scale_v(1./ (binner->vmax - binner->vmin)), bins(binner->bins) { }
+    // branchless version of BinnerScalar::to_bins, so the compiler can use conditional moves
+    inline default_index_type operator()(uint64_t i) const {
+        double value_double = ptr[i];
+        double scaled = (value_double - vmin) * scale_v;
+        double bin = scaled * bins;
+        bin = bin > 0 ? bin : 0; // also maps nan to 0, so the cast below is always defined
+        bin = bin < bins ? bin : bins;
+        default_index_type index = (int64_t)bin + 2; // real data starts at 2
+        index = scaled >= 1 ? bins-1+3 : index; // bigger values are put at offset -1 (last)
+        index = scaled < 0 ? 1 : index; // smaller values are put at offset 1
+        bool masked = mask && mask[i] == 1;
+        return (scaled != scaled || masked) ? 0 : index; // nan or masked goes to index 0
+    }
+    const T* ptr;
+    const uint8_t* mask;
+    double vmin;
+    double scale_v;
+    uint64_t bins;
+};
+
+template<class T>
+struct BinKernelOrdinal {
+    BinKernelOrdinal(BinnerOrdinal<T>* binner) : ptr(binner->ptr), mask(binner->data_mask_ptr), ordinal_count(binner->ordinal_count), min_value(binner->min_value) { }
+    inline default_index_type operator()(uint64_t i) const {
+        T value = ptr[i] - min_value;
+        if(value != value || (mask && mask[i] == 1)) { // nan or masked goes to index 0
+            return 0;
+        } else if (value < 0) { // smaller values are put at offset 1
+            return 1;
+        } else if (value >= ordinal_count) { // bigger values are put at offset -1 (last)
+            return ordinal_count-1+3;
+        } else {
+            return value + 2; // real data starts at 2
+        }
+    }
+    const T* ptr;
+    const uint8_t* mask;
+    uint64_t ordinal_count;
+    uint64_t min_value;
+};
+
+// calls f with the kernel for this binner, returns false if we have no kernel for it
+// when BinnerScalar::to_bins is vectorized, the generic path is faster than the fused scalar kernel
+template<class F>
+bool with_bin_kernel(Binner* binner, F& f) {
+    bool fuse_scalar = simd::level() == simd::LEVEL_NONE;
+    if(auto b = fuse_scalar ? dynamic_cast<BinnerScalar<double>*>(binner) : nullptr) {
+        f(BinKernelScalar<double>(b));
+    } else if(auto b = fuse_scalar ? dynamic_cast<BinnerScalar<float>*>(binner) : nullptr) {
+        f(BinKernelScalar<float>(b));
+    } else if(auto b = dynamic_cast<BinnerOrdinal<int64_t>*>(binner)) {
+        f(BinKernelOrdinal<int64_t>(b));
+    } else if(auto b = dynamic_cast<BinnerOrdinal<int32_t>*>(binner)) {
+        f(BinKernelOrdinal<int32_t>(b));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+struct BinKernelCheck {
+    template<class BinKernel>
+    void operator()(BinKernel) { }
+};
+
+template<class AggKernel>
+struct BinFused1d {
+    template<class BinKernel>
+    void operator()(BinKernel bin) {
+        for(uint64_t i = begin; i < end; i++) {
+            agg(bin(i), i);
+        }
+    }
+    AggKernel agg;
+    uint64_t begin;
+    uint64_t end;
+};
+
+template<class AggKernel, class BinKernel1>
+struct BinFused2d {
+    template<class BinKernel2>
+    void operator()(BinKernel2 bin2) {
+        for(uint64_t i = begin; i < end; i++) {
+            agg(bin1(i) + bin2(i) * stride, i);
+        }
+    }
+    AggKernel agg;
+    BinKernel1 bin1;
+    uint64_t stride;
+    uint64_t begin;
+    uint64_t end;
+};
+
+template<class AggKernel>
+struct BinFused2dFirst {
+    template<class BinKernel1>
+    void operator()(BinKernel1 bin1) {
+        BinFused2d<AggKernel, BinKernel1> f{agg, bin1, stride, begin, end};
+        with_bin_kernel(binner2, f);
+    }
+    AggKernel agg;
+    Binner* binner2;
+    uint64_t stride;
+    uint64_t begin;
+    uint64_t end;
+};
+
+template<class AggKernel>
+bool bin_fused(AggKernel agg, std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+    BinKernelCheck check;
+    if(binners.size() == 1) {
+        BinFused1d<AggKernel> f{agg, begin, end};
+        return with_bin_kernel(binners[0], f);
+    } else if(binners.size() == 2 && with_bin_kernel(binners[1], check)) {
+        // strides[0] is always 1
+        BinFused2dFirst<AggKernel> f{agg, binners[1], strides[1], begin, end};
+        return with_bin_kernel(binners[0], f);
+    }
+    return false;
+}
+
+// avoids instantiating the kernels for types we do not specialize for
+template<class AggKernel>
+bool bin_fused(std::false_type, AggKernel agg, std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+    return false;
+}
+
+template<class AggKernel>
+bool bin_fused(std::true_type, AggKernel agg, std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+    return bin_fused(agg, binners, strides, begin, end);
+}
+
+template<class T, bool FlipEndian>
+struct has_fused_kernel : std::integral_constant<bool, !FlipEndian && (std::is_same<T, double>::value || std::is_same<T, float>::value || std::is_same<T, int64_t>::value || std::is_same<T, int32_t>::value)> {
+};
+
+template<class DataType, class GridType>
+struct AggKernelCount {
+    inline void operator()(default_index_type index, uint64_t i) {
+        // if not masked, and not nan
+        if(data_mask_ptr && data_mask_ptr[i] != 1)
+            return;
+        if(data_ptr) {
+            DataType value = data_ptr[i];
+            if(value != value) // nan
+                return;
+        }
+        grid_data[index] += 1;
+    }
+    GridType* grid_data;
+    const DataType* data_ptr;
+    const uint8_t* data_mask_ptr;
+};
+
+template<class DataType, class GridType, class Op>
+struct AggKernelValue {
+    inline void operator()(default_index_type index, uint64_t i) {
+        if(data_mask_ptr && data_mask_ptr[i] != 1)
+            return;
+        DataType value = data_ptr[i];
+        if(value != value) // nan
+            return;
+        Op::apply(grid_data[index], value);
+    }
+    GridType* grid_data;
+    const DataType* data_ptr;
+    const uint8_t* data_mask_ptr;
+};
+
+struct OpSum {
+    template<class GridType, class DataType>
+    static inline void apply(GridType& target, DataType value) {
+        target += value;
+    }
+};
+
+struct OpMax {
+    template<class GridType, class DataType>
+    static inline void apply(GridType& target, DataType value) {
+        target = std::max(value, target);
+    }
+};
+
+struct OpMin {
+    template<class GridType, class DataType>
+    static inline void apply(GridType& target, DataType value) {
+        target = std::min(value, target);
+    }
+};
+
+// the value of an empty cell, which any value replaces (or is added to) when applying Op
+template<class Op, class T>
+struct op_identity {
+    static T value() {
+        return 0;
+    }
+};
+
+template<class T>
+struct op_identity<OpMax, T> {
+    static T value() {
+        typedef std::numeric_limits<T> limit_type;
+        return limit_type::has_infinity ? -limit_type::infinity() : limit_type::min();
+    }
+};
+
+template<class T>
+struct op_identity<OpMin, T> {
+    static T value() {
+        typedef std::numeric_limits<T> limit_type;
+        return limit_type::has_infinity ? limit_type::infinity() : limit_type::max();
+    }
+};
+
 template<class GridType=uint64_t, class IndexType=default_index_type>
 class AggBaseObject : public AggregatorBase<IndexType> {
 public:
@@ -217,37 +901,36 @@ public:
     using Base = AggBaseObject<GridType, IndexType>;
     using Type = AggObjectCount<GridType, IndexType>;
     using Base::Base;
-    virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] += other->grid_data[i];
-            }
+    // we look at the objects once per chunk (with the GIL), so aggregating does not need the GIL
+    void set_data(py::buffer ar, size_t index) {
+        Base::set_data(ar, index);
+        valid.resize(this->objects_size);
+        for(size_t i = 0; i < this->objects_size; i++) {
+            PyObject* obj = this->objects[i];
+            bool none = (obj == Py_None);
+            bool _isnan = PyFloat_Check(obj) && isnan(PyFloat_AsDouble(obj));
+            valid[i] = !(none || _isnan);
         }
     }
+    virtual void reduce(std::vector<Type*> others) {
+        reduce_grid_data<OpSum>(this, others);
+    }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->objects == nullptr) {
             throw std::runtime_error("object data not set");
         }
         if(this->data_mask_ptr == nullptr) {
             for(size_t j = 0; j < length; j++) {
-                PyObject* obj = this->objects[j+offset];
-                bool none = (obj == Py_None);
-                bool _isnan = PyFloat_Check(obj) && isnan(PyFloat_AsDouble(obj));
-                this->grid_data[indices1d[j]] += (none || _isnan ? 0 : 1);
+                this->grid_data[indices1d[j]] += valid[j+offset];
             }
         } else {
             for(size_t j = 0; j < length; j++) {
-                PyObject* obj = this->objects[j+offset];
-                bool none = (obj == Py_None);
-                bool _isnan = PyFloat_Check(obj) && isnan(PyFloat_AsDouble(obj));
                 bool masked = this->data_mask_ptr[j+offset] == 0;
-                this->grid_data[indices1d[j]] += (none || masked || _isnan ? 0 : 1);
+                this->grid_data[indices1d[j]] += (masked ? 0 : valid[j+offset]);
             }
         }
     }
-    virtual bool can_release_gil() {
-        return false;
-    };
+    std::vector<uint8_t> valid;
 };
 
 
@@ -259,11 +942,7 @@ public:
     using Type = AggStringCount<GridType, IndexType>;
     using Base::Base;
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] += other->grid_data[i];
-            }
-        }
+        reduce_grid_data<OpSum>(this, others);
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->string_sequence == nullptr) {
@@ -329,11 +1008,11 @@ public:
     using Type = AggCount<StorageType, IndexType, FlipEndian>;
     using Base::Base;
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] += other->grid_data[i];
-            }
-        }
+        reduce_grid_data<OpSum>(this, others);
+    }
+    virtual bool bin_fused(std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+        AggKernelCount<StorageType, int64_t> kernel{this->grid_data, this->data_ptr, this->data_mask_ptr};
+        return ::bin_fused(has_fused_kernel<StorageType, FlipEndian>(), kernel, binners, strides, begin, end);
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
 
@@ -372,13 +1051,17 @@ public:
         // TODO: avoid double fill, since we also call it in the base ctor
         StorageType fill_value = limit_type::has_infinity ? -limit_type::infinity() : limit_type::min();
         std::fill(this->grid_data, this->grid_data+this->grid->length1d, fill_value);
+        this->fill_value = fill_value;
     }
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] = std::max(this->grid_data[i], other->grid_data[i]);
-            }
+        reduce_grid_data<OpMax>(this, others);
+    }
+    virtual bool bin_fused(std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+        if(this->data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
         }
+        AggKernelValue<StorageType, StorageType, OpMax> kernel{this->grid_data, this->data_ptr, this->data_mask_ptr};
+        return ::bin_fused(has_fused_kernel<StorageType, FlipEndian>(), kernel, binners, strides, begin, end);
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->data_ptr == nullptr) {
@@ -419,13 +1102,17 @@ public:
         StorageType fill_value = limit_type::has_infinity ? limit_type::infinity() : limit_type::max();
         // TODO: avoid double fill, since we also call it in the base ctor
         std::fill(this->grid_data, this->grid_data+this->grid->length1d, fill_value);
+        this->fill_value = fill_value;
     }
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] = std::min(this->grid_data[i], other->grid_data[i]);
-            }
+        reduce_grid_data<OpMin>(this, others);
+    }
+    virtual bool bin_fused(std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+        if(this->data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
         }
+        AggKernelValue<StorageType, StorageType, OpMin> kernel{this->grid_data, this->data_ptr, this->data_mask_ptr};
+        return ::bin_fused(has_fused_kernel<StorageType, FlipEndian>(), kernel, binners, strides, begin, end);
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->data_ptr == nullptr) {
@@ -516,18 +1203,101 @@ struct upcast<uint64_t> {
 };
 
 
-template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false>
-class AggSum : public AggBase<StorageType, typename upcast<StorageType>::type, IndexType> {
+// Neumaier's variant of Kahan summation, the low order bits lost in sum are accumulated in compensation
+template<class T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type add_compensated(T& sum, T& compensation, T value) {
+    T t = sum + value;
+    if(std::abs(sum) >= std::abs(value)) {
+        compensation += (sum - t) + value;
+    } else {
+        compensation += (value - t) + sum;
+    }
+    sum = t;
+}
+
+// integer sums are exact
+template<class T>
+inline typename std::enable_if<!std::is_floating_point<T>::value>::type add_compensated(T& sum, T& compensation, T value) {
+    sum += value;
+}
+
+// Sums per cell, when Accurate, we use compensated summation for floating point data, and add the
+// compensation to grid_data at reduce. Integer sums are exact, so they are not compensated.
+template<class StorageType=double, class IndexType=default_index_type, bool Accurate=false>
+class AggSumBase : public AggBase<StorageType, typename upcast<StorageType>::type, IndexType> {
 public:
     using Base = AggBase<StorageType, typename upcast<StorageType>::type, IndexType>;
-    using Type = AggSum<StorageType, IndexType, FlipEndian>;
+    using grid_type = typename Base::grid_type;
+    static const bool compensated = Accurate && std::is_floating_point<grid_type>::value;
+    AggSumBase(Grid<IndexType>* grid) : Base(grid), grid_compensation(nullptr) {
+        if(compensated) {
+            grid_compensation = (grid_type*)malloc(sizeof(grid_type) * std::max<size_t>(grid->length1d, 1));
+            std::fill(grid_compensation, grid_compensation+grid->length1d, 0);
+        }
+    }
+    virtual ~AggSumBase() {
+        free(grid_compensation);
+    }
+    virtual void grow(size_t length) {
+        size_t old_length = this->grid_length;
+        Base::grow(length);
+        if(compensated && this->grid_length > old_length) {
+            grow_cells(grid_compensation, old_length, this->grid_length, grid_type(0));
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        Base::remap(mapping, length);
+        if(compensated) {
+            remap_cells(grid_compensation, mapping, length, grid_type(0));
+        }
+    }
+    inline void add(default_index_type index, grid_type value) {
+        if(compensated) {
+            add_compensated(this->grid_data[index], this->grid_compensation[index], value);
+        } else {
+            this->grid_data[index] += value;
+        }
+    }
+    template<class Agg>
+    void reduce_sum(std::vector<Agg*>& others) {
+        if(!compensated) {
+            reduce_grid_data<OpSum>(this, others);
+            return;
+        }
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(auto other: others) {
+                for(size_t i = begin; i < end; i++) {
+                    add_compensated(this->grid_data[i], this->grid_compensation[i], other->grid_data[i]);
+                    this->grid_compensation[i] += other->grid_compensation[i];
+                }
+            }
+            for(size_t i = begin; i < end; i++) {
+                // with infinities, the compensation is nan
+                if(std::isfinite(this->grid_data[i])) {
+                    this->grid_data[i] += this->grid_compensation[i];
+                }
+                this->grid_compensation[i] = 0;
+            }
+        });
+    }
+    grid_type* grid_compensation;
+};
+
+template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false, bool Accurate=false>
+class AggSum : public AggSumBase<StorageType, IndexType, Accurate> {
+public:
+    using Base = AggSumBase<StorageType, IndexType, Accurate>;
+    using Type = AggSum<StorageType, IndexType, FlipEndian, Accurate>;
     using Base::Base;
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] = this->grid_data[i] + other->grid_data[i];
-            }
+        this->reduce_sum(others);
+    }
+    virtual bool bin_fused(std::vector<Binner*>& binners, uint64_t* strides, uint64_t begin, uint64_t end) {
+        if(this->data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
         }
+        AggKernelValue<StorageType, typename Base::grid_type, OpSum> kernel{this->grid_data, this->data_ptr, this->data_mask_ptr};
+        return ::bin_fused(std::integral_constant<bool, has_fused_kernel<StorageType, FlipEndian>::value && !Accurate>(), kernel, binners, strides, begin, end);
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->data_ptr == nullptr) {
@@ -543,7 +1313,7 @@ public:
                         value = _to_native(value);
                     if(value != value) // nan
                         continue;
-                    this->grid_data[indices1d[j]] += value;
+                    this->add(indices1d[j], value);
                 }
             }
         } else {
@@ -552,55 +1322,395 @@ public:
                 if(FlipEndian)
                     value = _to_native(value);
                 if(value == value) // nan check
-                    this->grid_data[indices1d[j]] += value;
+                    this->add(indices1d[j], value);
             }
         }
     }
 };
 
-template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false>
-class AggSumMoment : public AggBase<StorageType, typename upcast<StorageType>::type, IndexType> {
+// Aggregates for up to 64 selections in one pass: instead of an aggregator per selection that each scan
+// their own mask, each row has a bitmask (bit s is set when the row is in selection s), and we only
+// update the grids of the selections the row is in. The grids of the selections are stored one after
+// the other, so the buffer has the selection as first (slowest varying) dimension.
+// With Count, we count the rows (with non missing data if set) instead of applying Op to the data.
+template<class StorageType, class GridType, class Op, bool Count, class IndexType=default_index_type, bool FlipEndian=false>
+class AggMultiSelection : public Aggregator {
 public:
-    using Base = AggBase<StorageType, typename upcast<StorageType>::type, IndexType>;
-    using Type = AggSumMoment<StorageType, IndexType, FlipEndian>;
-    using Base::Base;
+    using index_type = IndexType;
+    using grid_type = GridType;
+    using data_type = StorageType;
+    using Type = AggMultiSelection<StorageType, GridType, Op, Count, IndexType, FlipEndian>;
+    AggMultiSelection(Grid<IndexType>* grid, int selection_count) : grid(grid), grid_length(grid->length1d), selection_count(selection_count),
+        data_ptr(nullptr), data_mask_ptr(nullptr), selection_bits_ptr(nullptr) {
+        if(selection_count < 1 || selection_count > 64) {
+            throw std::runtime_error("selection_count should be between 1 and 64");
+        }
+        fill_value = op_identity<Op, grid_type>::value();
+        grid_data = (grid_type*)malloc(sizeof(grid_type) * std::max<size_t>(selection_count * grid_length, 1));
+        if(grid_data == nullptr) {
+            throw std::bad_alloc();
+        }
+        std::fill(grid_data, grid_data + selection_count * grid_length, fill_value);
+    }
+    virtual ~AggMultiSelection() {
+        free(grid_data);
+    }
+    virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
+        if(selection_bits_ptr == nullptr) {
+            throw std::runtime_error("selection bits not set");
+        }
+        if(!Count && data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
+        }
+        const uint64_t valid_bits = selection_count == 64 ? ~uint64_t(0) : (uint64_t(1) << selection_count) - 1;
+        for(size_t j = 0; j < length; j++) {
+            uint64_t bits = selection_bits_ptr[j+offset] & valid_bits;
+            if(bits == 0)
+                continue;
+            // this follows the aggregators, 1 is valid
+            if(data_mask_ptr && data_mask_ptr[j+offset] == 0)
+                continue;
+            grid_type value = 1;
+            if(data_ptr) {
+                StorageType data_value = data_ptr[j+offset];
+                if(FlipEndian)
+                    data_value = _to_native(data_value);
+                if(data_value != data_value) // nan
+                    continue;
+                if(!Count)
+                    value = data_value;
+            }
+            grid_type* cell = grid_data + indices1d[j];
+            while(bits) {
+                size_t selection_index = ctz64(bits);
+                Op::apply(cell[selection_index * grid_length], value);
+                bits &= bits - 1;
+            }
+        }
+    }
+    void reduce(std::vector<Type*> others) {
+        for_each_cell_range(grid->length1d, [&](size_t begin, size_t end) {
+            for(int s = 0; s < selection_count; s++) {
+                for(auto other : others) {
+                    reduce_block<Op>(grid_data + s * grid_length + begin, other->grid_data + s * other->grid_length + begin, end - begin);
+                }
+            }
+        });
+    }
+    virtual void grow(size_t length) {
+        if(length > grid_length) {
+            size_t new_length = std::max(length, grid_length * 2);
+            std::vector<uint64_t> mapping(grid_length);
+            for(size_t i = 0; i < grid_length; i++) {
+                mapping[i] = i;
+            }
+            this->remap(mapping, new_length);
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        grid_type* new_data = (grid_type*)malloc(sizeof(grid_type) * std::max<size_t>(selection_count * length, 1));
+        if(new_data == nullptr) {
+            throw std::bad_alloc();
+        }
+        std::fill(new_data, new_data + selection_count * length, fill_value);
+        for(int s = 0; s < selection_count; s++) {
+            for(size_t i = 0; i < mapping.size(); i++) {
+                new_data[s * length + mapping[i]] = grid_data[s * grid_length + i];
+            }
+        }
+        free(grid_data);
+        grid_data = new_data;
+        grid_length = length;
+    }
+    void set_data(py::buffer ar, size_t index) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_ptr = (data_type*)info.ptr;
+        this->data_size = info.shape[0];
+    }
+    void set_data_mask(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1) {
+            throw std::runtime_error("Expected a 1d array");
+        }
+        this->data_mask_ptr = (uint8_t*)info.ptr;
+        this->data_mask_size = info.shape[0];
+    }
+    void set_selection_bits(py::buffer ar) {
+        py::buffer_info info = ar.request();
+        if(info.ndim != 1 || info.itemsize != sizeof(uint64_t)) {
+            throw std::runtime_error("Expected a 1d array of 64 bit integers");
+        }
+        this->selection_bits_ptr = (uint64_t*)info.ptr;
+        this->selection_bits_size = info.shape[0];
+    }
+    Grid<IndexType>* grid;
+    grid_type* grid_data;
+    size_t grid_length; // number of cells allocated per selection, can be larger than grid->length1d for sparse grids
+    int selection_count;
+    grid_type fill_value;
+    data_type* data_ptr;
+    uint64_t data_size;
+    uint8_t* data_mask_ptr;
+    uint64_t data_mask_size;
+    uint64_t* selection_bits_ptr;
+    uint64_t selection_bits_size;
+};
+
+// value**moment, avoiding pow for small integer powers
+template<int Power, class T>
+struct integer_power {
+    static inline T calculate(T value, size_t moment) {
+        return pow(value, moment);
+    }
+};
+
+template<class T>
+struct integer_power<1, T> {
+    static inline T calculate(T value, size_t moment) {
+        return value;
+    }
+};
+
+template<class T>
+struct integer_power<2, T> {
+    static inline T calculate(T value, size_t moment) {
+        return value * value;
+    }
+};
+
+template<class T>
+struct integer_power<3, T> {
+    static inline T calculate(T value, size_t moment) {
+        return value * value * value;
+    }
+};
+
+template<class T>
+struct integer_power<4, T> {
+    static inline T calculate(T value, size_t moment) {
+        T square = value * value;
+        return square * square;
+    }
+};
+
+template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false, bool Accurate=false>
+class AggSumMoment : public AggSumBase<StorageType, IndexType, Accurate> {
+public:
+    using Base = AggSumBase<StorageType, IndexType, Accurate>;
+    using Type = AggSumMoment<StorageType, IndexType, FlipEndian, Accurate>;
+    using grid_type = typename Base::grid_type;
     AggSumMoment(Grid<IndexType>* grid, uint32_t moment) : Base(grid), moment(moment) {
     }
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                this->grid_data[i] = this->grid_data[i] + other->grid_data[i];
+        this->reduce_sum(others);
+    }
+    virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
+        if(this->data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
+        }
+        switch(moment) {
+            case 1: this->template aggregate_power<1>(indices1d, length, offset); break;
+            case 2: this->template aggregate_power<2>(indices1d, length, offset); break;
+            case 3: this->template aggregate_power<3>(indices1d, length, offset); break;
+            case 4: this->template aggregate_power<4>(indices1d, length, offset); break;
+            default: this->template aggregate_power<0>(indices1d, length, offset);
+        }
+    }
+    template<int Power>
+    void aggregate_power(default_index_type* indices1d, size_t length, uint64_t offset) {
+        if(this->data_mask_ptr) {
+            for(size_t j = 0; j < length; j++) {
+                // if not masked
+                if(this->data_mask_ptr[j+offset] == 1) {
+                    StorageType value = this->data_ptr[j+offset];
+                    if(FlipEndian)
+                        value = _to_native(value);
+                    if(value != value) // nan
+                        continue;
+                    this->add(indices1d[j], integer_power<Power, grid_type>::calculate(value, moment));
+                }
+            }
+        } else {
+            for(size_t j = 0; j < length; j++) {
+                StorageType value = this->data_ptr[offset + j];
+                if(FlipEndian)
+                    value = _to_native(value);
+                if(value == value) // nan check
+                    this->add(indices1d[j], integer_power<Power, grid_type>::calculate(value, moment));
+            }
+        }
+    }
+    size_t moment;
+};
+
+// running count, mean and sum of squared differences from the mean
+struct WelfordState {
+    int64_t count;
+    double mean;
+    double m2;
+};
+
+enum {
+    MOMENTS_MEAN,
+    MOMENTS_VAR,
+    MOMENTS_STD
+};
+
+// Calculates the mean, variance or standard deviation in a single pass by keeping a WelfordState per cell,
+// which unlike sum(x**2)/N - mean**2 does not suffer from cancellation for data with a large offset
+// (e.g. timestamps). States are combined using Chan's parallel algorithm, after which reduce also fills grid_data.
+template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false, int Result=MOMENTS_VAR>
+class AggMoments : public AggBase<StorageType, double, IndexType> {
+public:
+    using Base = AggBase<StorageType, double, IndexType>;
+    using Type = AggMoments<StorageType, IndexType, FlipEndian, Result>;
+    AggMoments(Grid<IndexType>* grid, int ddof=0) : Base(grid), ddof(ddof) {
+        states = (WelfordState*)malloc(sizeof(WelfordState) * std::max<size_t>(grid->length1d, 1));
+        std::fill(states, states+grid->length1d, WelfordState{0, 0, 0});
+        std::fill(this->grid_data, this->grid_data+grid->length1d, NAN);
+        this->fill_value = NAN;
+    }
+    virtual ~AggMoments() {
+        free(states);
+    }
+    virtual void grow(size_t length) {
+        size_t old_length = this->grid_length;
+        Base::grow(length);
+        if(this->grid_length > old_length) {
+            grow_cells(states, old_length, this->grid_length, WelfordState{0, 0, 0});
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        Base::remap(mapping, length);
+        remap_cells(states, mapping, length, WelfordState{0, 0, 0});
+    }
+    virtual void reduce(std::vector<Type*> others) {
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(auto other: others) {
+                for(size_t i = begin; i < end; i++) {
+                    WelfordState& a = this->states[i];
+                    const WelfordState& b = other->states[i];
+                    if(b.count == 0)
+                        continue;
+                    int64_t count = a.count + b.count;
+                    double delta = b.mean - a.mean;
+                    a.mean += delta * b.count / count;
+                    a.m2 += b.m2 + delta * delta * a.count * b.count / count;
+                    a.count = count;
+                }
             }
+            for(size_t i = begin; i < end; i++) {
+                this->grid_data[i] = this->result(this->states[i]);
+            }
+        });
+    }
+    double result(const WelfordState& state) {
+        if(Result == MOMENTS_MEAN) {
+            return state.count > 0 ? state.mean : NAN;
         }
+        if(state.count - ddof <= 0)
+            return NAN;
+        double variance = state.m2 / (state.count - ddof);
+        return Result == MOMENTS_STD ? sqrt(variance) : variance;
+    }
+    inline void update(WelfordState& state, double value) {
+        state.count++;
+        double delta = value - state.mean;
+        state.mean += delta / state.count;
+        state.m2 += delta * (value - state.mean);
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->data_ptr == nullptr) {
             throw std::runtime_error("data not set");
         }
-
         if(this->data_mask_ptr) {
             for(size_t j = 0; j < length; j++) {
                 // if not masked
                 if(this->data_mask_ptr[j+offset] == 1) {
-                    typename Base::grid_type value = this->data_ptr[j+offset];
+                    StorageType value = this->data_ptr[j+offset];
                     if(FlipEndian)
                         value = _to_native(value);
                     if(value != value) // nan
                         continue;
-                    this->grid_data[indices1d[j]] += pow(value, moment);
+                    this->update(this->states[indices1d[j]], value);
                 }
             }
         } else {
             for(size_t j = 0; j < length; j++) {
-                typename Base::grid_type value = this->data_ptr[offset + j];
+                StorageType value = this->data_ptr[offset + j];
                 if(FlipEndian)
                     value = _to_native(value);
                 if(value == value) // nan check
-                    this->grid_data[indices1d[j]] += pow(value, moment);
+                    this->update(this->states[indices1d[j]], value);
             }
         }
     }
-    size_t moment;
+    WelfordState* states;
+    int ddof;
+};
+
+// Approximates a quantile by keeping a t-digest per cell, the digests of the threads are merged in reduce,
+// after which grid_data is filled in. Unlike a cumulative histogram, this needs no limits and a single pass.
+template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false>
+class AggQuantileSketch : public AggBase<StorageType, double, IndexType> {
+public:
+    using Base = AggBase<StorageType, double, IndexType>;
+    using Type = AggQuantileSketch<StorageType, IndexType, FlipEndian>;
+    AggQuantileSketch(Grid<IndexType>* grid, double quantile, double compression) : Base(grid), quantile(quantile), compression(compression) {
+        if(quantile < 0 || quantile > 1) {
+            throw std::runtime_error("quantile should be between 0 and 1");
+        }
+        if(compression < 1) {
+            throw std::runtime_error("compression should be at least 1");
+        }
+        digests.resize(grid->length1d, tdigest(compression));
+        std::fill(this->grid_data, this->grid_data+grid->length1d, NAN);
+        this->fill_value = NAN;
+    }
+    virtual void grow(size_t length) {
+        Base::grow(length);
+        if(this->grid_length > digests.size()) {
+            digests.resize(this->grid_length, tdigest(compression));
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        Base::remap(mapping, length);
+        std::vector<tdigest> new_digests(length, tdigest(compression));
+        for(size_t i = 0; i < mapping.size(); i++) {
+            std::swap(new_digests[mapping[i]], digests[i]);
+        }
+        std::swap(digests, new_digests);
+    }
+    virtual void reduce(std::vector<Type*> others) {
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                for(auto other: others) {
+                    this->digests[i].merge(other->digests[i]);
+                }
+                this->grid_data[i] = this->digests[i].quantile(quantile);
+            }
+        });
+    }
+    virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
+        if(this->data_ptr == nullptr) {
+            throw std::runtime_error("data not set");
+        }
+        for(size_t j = 0; j < length; j++) {
+            if(this->data_mask_ptr && this->data_mask_ptr[j+offset] == 0)
+                continue;
+            StorageType value = this->data_ptr[j+offset];
+            if(FlipEndian)
+                value = _to_native(value);
+            if(value == value) // nan check
+                this->digests[indices1d[j]].add(value);
+        }
+    }
+    std::vector<tdigest> digests;
+    double quantile;
+    double compression;
 };
 
 template<class StorageType=double, class IndexType=default_index_type, bool FlipEndian=false>
@@ -617,6 +1727,17 @@ public:
     virtual ~AggFirst() {
         free(grid_data_order);
     }
+    virtual void grow(size_t length) {
+        size_t old_length = this->grid_length;
+        Base::grow(length);
+        if(this->grid_length > old_length) {
+            grow_cells(grid_data_order, old_length, this->grid_length, std::numeric_limits<StorageType>::max());
+        }
+    }
+    virtual void remap(const std::vector<uint64_t>& mapping, size_t length) {
+        Base::remap(mapping, length);
+        remap_cells(grid_data_order, mapping, length, std::numeric_limits<StorageType>::max());
+    }
     void set_data(py::buffer ar, size_t index) {
         py::buffer_info info = ar.request();
         if(info.ndim != 1) {
@@ -639,14 +1760,16 @@ public:
         this->data_mask_size2 = info.shape[0];
     }
     virtual void reduce(std::vector<Type*> others) {
-        for(auto other: others) {
-            for(size_t i = 0; i < this->grid->length1d; i++) {
-                if(other->grid_data_order[i] < this->grid_data_order[i]) {
-                    this->grid_data[i] = other->grid_data[i];
-                    this->grid_data_order[i] = other->grid_data_order[i];
+        for_each_cell_range(this->grid->length1d, [&](size_t begin, size_t end) {
+            for(auto other: others) {
+                for(size_t i = begin; i < end; i++) {
+                    if(other->grid_data_order[i] < this->grid_data_order[i]) {
+                        this->grid_data[i] = other->grid_data[i];
+                        this->grid_data_order[i] = other->grid_data_order[i];
+                    }
                 }
             }
-        }
+        });
     }
     virtual void aggregate(default_index_type* indices1d, size_t length, uint64_t offset) {
         if(this->data_ptr == nullptr) {
@@ -685,56 +1808,68 @@ template<class Agg, class Base, class Module>
 void add_agg(Module m, Base& base, const char* class_name) {
     py::class_<Agg>(m, class_name, py::buffer_protocol(), base)
         .def(py::init<Grid<>*>(), py::keep_alive<1, 2>())
-        .def_buffer([](Agg &agg) -> py::buffer_info {
-            std::vector<ssize_t> strides(agg.grid->dimensions);
-            std::vector<ssize_t> shapes(agg.grid->dimensions);
-            std::copy(&agg.grid->shapes[0], &agg.grid->shapes[agg.grid->dimensions], &shapes[0]);
-            std::transform(&agg.grid->strides[0], &agg.grid->strides[agg.grid->dimensions], &strides[0], [](uint64_t x) { return x*sizeof(typename Agg::grid_type); } );
-            return py::buffer_info(
-                agg.grid_data,                               /* Pointer to buffer */
-                sizeof(typename Agg::grid_type),                 /* Size of one scalar */
-                py::format_descriptor<typename Agg::grid_type>::format(), /* Python struct-style format descriptor */
-                agg.grid->dimensions,                       /* Number of dimensions */
-                shapes,                 /* Buffer dimensions */
-                strides
-            );
-        })
+        .def_buffer(&grid_buffer_info<Agg>)
         .def_property_readonly("grid", [](const Agg &agg) {
                 return agg.grid;
             }
         )
         .def("set_data", &Agg::set_data)
         .def("set_data_mask", &Agg::set_data_mask)
-        .def("reduce", &Agg::reduce)
+        .def("reduce", &reduce_aligned<Agg>)
+        .def("reduce", &reduce_aligned_into<Agg>)
+        .def("regrid", &regrid<Agg>, py::keep_alive<1, 2>())
     ;
 }
 
 
-template<class Agg, class Base, class Module, class A>
-void add_agg_arg(Module m, Base& base, const char* class_name) {
+template<class Agg, class Base, class Module>
+void add_agg_multi_selection(Module m, Base& base, const char* class_name) {
     py::class_<Agg>(m, class_name, py::buffer_protocol(), base)
-        .def(py::init<Grid<>*, A>(), py::keep_alive<1, 2>())
+        .def(py::init<Grid<>*, int>(), py::keep_alive<1, 2>())
         .def_buffer([](Agg &agg) -> py::buffer_info {
-            std::vector<ssize_t> strides(agg.grid->dimensions);
-            std::vector<ssize_t> shapes(agg.grid->dimensions);
-            std::copy(&agg.grid->shapes[0], &agg.grid->shapes[agg.grid->dimensions], &shapes[0]);
-            std::transform(&agg.grid->strides[0], &agg.grid->strides[agg.grid->dimensions], &strides[0], [](uint64_t x) { return x*sizeof(typename Agg::grid_type); } );
-            return py::buffer_info(
-                agg.grid_data,                               /* Pointer to buffer */
-                sizeof(typename Agg::grid_type),                 /* Size of one scalar */
-                py::format_descriptor<typename Agg::grid_type>::format(), /* Python struct-style format descriptor */
-                agg.grid->dimensions,                       /* Number of dimensions */
-                shapes,                 /* Buffer dimensions */
-                strides
-            );
+            // like grid_buffer_info, with the selection as extra first dimension
+            std::vector<ssize_t> shapes = {agg.selection_count};
+            std::vector<ssize_t> strides = {(ssize_t)(agg.grid_length * sizeof(typename Agg::grid_type))};
+            if(agg.grid->sparse) {
+                agg.grow(agg.grid->length1d);
+                strides[0] = agg.grid_length * sizeof(typename Agg::grid_type);
+                shapes.push_back(agg.grid->length1d);
+                strides.push_back(sizeof(typename Agg::grid_type));
+            } else {
+                for(size_t i = 0; i < agg.grid->dimensions; i++) {
+                    shapes.push_back(agg.grid->shapes[i]);
+                    strides.push_back(agg.grid->strides[i] * sizeof(typename Agg::grid_type));
+                }
+            }
+            return py::buffer_info(agg.grid_data, sizeof(typename Agg::grid_type), py::format_descriptor<typename Agg::grid_type>::format(),
+                                   shapes.size(), shapes, strides);
         })
         .def_property_readonly("grid", [](const Agg &agg) {
                 return agg.grid;
             }
         )
+        .def_readonly("selection_count", &Agg::selection_count)
+        .def("set_data", &Agg::set_data)
+        .def("set_data_mask", &Agg::set_data_mask)
+        .def("set_selection_bits", &Agg::set_selection_bits)
+        .def("reduce", &reduce_aligned<Agg>)
+    ;
+}
+
+template<class Agg, class Base, class Module, class... A>
+void add_agg_arg(Module m, Base& base, const char* class_name) {
+    py::class_<Agg>(m, class_name, py::buffer_protocol(), base)
+        .def(py::init<Grid<>*, A...>(), py::keep_alive<1, 2>())
+        .def_buffer(&grid_buffer_info<Agg>)
+        .def_property_readonly("grid", [](const Agg &agg) {
+                return agg.grid;
+            }
+        )
         .def("set_data", &Agg::set_data)
         .def("set_data_mask", &Agg::set_data_mask)
-        .def("reduce", &Agg::reduce)
+        .def("reduce", &reduce_aligned<Agg>)
+        .def("reduce", &reduce_aligned_into<Agg>)
+        .def("regrid", &regrid<Agg>, py::keep_alive<1, 2>())
     ;
 }
 
@@ -746,6 +1881,16 @@ void add_agg_primitives_(Module m, Base& base, std::string postfix) {
     add_agg<AggSum<T, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggSum_" + postfix).c_str());
     add_agg<AggFirst<T, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggFirst_" + postfix).c_str());
     add_agg_arg<AggSumMoment<T, default_index_type, FlipEndian>, Base, Module, uint32_t>(m, base, ("AggSumMoment_" + postfix).c_str());
+    add_agg<AggSum<T, default_index_type, FlipEndian, true>, Base, Module>(m, base, ("AggSumAccurate_" + postfix).c_str());
+    add_agg_arg<AggSumMoment<T, default_index_type, FlipEndian, true>, Base, Module, uint32_t>(m, base, ("AggSumMomentAccurate_" + postfix).c_str());
+    add_agg<AggMoments<T, default_index_type, FlipEndian, MOMENTS_MEAN>, Base, Module>(m, base, ("AggMean_" + postfix).c_str());
+    add_agg_arg<AggMoments<T, default_index_type, FlipEndian, MOMENTS_VAR>, Base, Module, int>(m, base, ("AggVar_" + postfix).c_str());
+    add_agg_arg<AggMoments<T, default_index_type, FlipEndian, MOMENTS_STD>, Base, Module, int>(m, base, ("AggStd_" + postfix).c_str());
+    add_agg_arg<AggQuantileSketch<T, default_index_type, FlipEndian>, Base, Module, double, double>(m, base, ("AggQuantileSketch_" + postfix).c_str());
+    add_agg_multi_selection<AggMultiSelection<T, int64_t, OpSum, true, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggCountMulti_" + postfix).c_str());
+    add_agg_multi_selection<AggMultiSelection<T, typename upcast<T>::type, OpSum, false, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggSumMulti_" + postfix).c_str());
+    add_agg_multi_selection<AggMultiSelection<T, T, OpMin, false, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggMinMulti_" + postfix).c_str());
+    add_agg_multi_selection<AggMultiSelection<T, T, OpMax, false, default_index_type, FlipEndian>, Base, Module>(m, base, ("AggMaxMulti_" + postfix).c_str());
 }
 
 template<class T, class Base, class Module>
@@ -776,6 +1921,75 @@ void add_binner_ordinal(Module m, Base& base, std::string postfix) {
     add_binner_ordinal_<T, Base, Module, true>(m, base, postfix+"_non_native");
 }
 
+template<class T, class Base, class Module, bool FlipEndian>
+void add_binner_edges_(Module m, Base& base, std::string postfix) {
+    typedef BinnerEdges<T, default_index_type, FlipEndian> Type;
+    std::string class_name = "BinnerEdges_" + postfix;
+    py::class_<Type>(m, class_name.c_str(), base)
+        .def(py::init<std::string, std::vector<double>>())
+        .def("set_data", &Type::set_data)
+        .def("set_data_mask", &Type::set_data_mask)
+        .def("copy", &Type::copy)
+        .def_readonly("edges", &Type::edges)
+        .def_property_readonly("expression", [](const Type &binner) {
+                return binner.expression;
+            }
+        )
+    ;
+}
+
+template<class T, class Base, class Module>
+void add_binner_edges(Module m, Base& base, std::string postfix) {
+    add_binner_edges_<T, Base, Module, false>(m, base, postfix);
+    add_binner_edges_<T, Base, Module, true>(m, base, postfix+"_non_native");
+}
+
+template<int64_t TicksPerDay, class Base, class Module, bool FlipEndian>
+void add_binner_time_(Module m, Base& base, std::string postfix) {
+    typedef BinnerTime<TicksPerDay, default_index_type, FlipEndian> Type;
+    std::string class_name = "BinnerTime_" + postfix;
+    py::class_<Type>(m, class_name.c_str(), base)
+        .def(py::init<std::string, std::string, int64_t, int64_t, uint64_t>())
+        .def("set_data", &Type::set_data)
+        .def("set_data_mask", &Type::set_data_mask)
+        .def("copy", &Type::copy)
+        .def_property_readonly("expression", [](const Type &binner) {
+                return binner.expression;
+            }
+        )
+    ;
+}
+
+template<int64_t TicksPerDay, class Base, class Module>
+void add_binner_time(Module m, Base& base, std::string postfix) {
+    add_binner_time_<TicksPerDay, Base, Module, false>(m, base, postfix);
+    add_binner_time_<TicksPerDay, Base, Module, true>(m, base, postfix+"_non_native");
+}
+
+template<class Type, class Base, class Module>
+void add_binner_hash_(Module m, Base& base, std::string class_name) {
+    py::class_<Type>(m, class_name.c_str(), base)
+        .def(py::init<std::string, uint64_t>())
+        .def("set_data", &Type::set_data)
+        .def("set_data_mask", &Type::set_data_mask)
+        .def("copy", &Type::copy)
+        // the value of bin i+2, see null_bin and nan_bin for which of those are placeholders
+        .def("keys", &Type::keys)
+        .def_readonly("null_bin", &Type::null_bin)
+        .def_readonly("nan_bin", &Type::nan_bin)
+        .def_property_readonly("expression", [](const Type &binner) {
+                return binner.expression;
+            }
+        )
+    ;
+}
+
+template<class T, class Base, class Module>
+void add_binner_hash(Module m, Base& base, std::string postfix) {
+    add_binner_hash_<BinnerHash<T, default_index_type, false>>(m, base, "BinnerHash_" + postfix);
+    add_binner_hash_<BinnerHash<T, default_index_type, true>>(m, base, "BinnerHash_" + postfix + "_non_native");
+}
+
 template<class T, class Base, class Module, bool FlipEndian>
 void add_binner_scalar_(Module m, Base& base, std::string postfix) {
     typedef BinnerScalar<T, default_index_type, FlipEndian> Type;
@@ -815,13 +2029,38 @@ PYBIND11_MODULE(superagg, m) {
     {
         typedef Grid<> Type;
         py::class_<Type>(m, "Grid")
-            .def(py::init<std::vector<Binner*> >(), py::keep_alive<1, 2>())
+            .def(py::init<std::vector<Binner*>, bool>(), py::keep_alive<1, 2>(), py::arg("binners"), py::arg("sparse") = false)
             .def("bin", (void (Type::*)(std::vector<Aggregator*>, size_t))&Type::bin)
             .def("bin", (void (Type::*)(std::vector<Aggregator*> ))&Type::bin)
             .def_property_readonly("binners", [](const Type &grid) {
                     return grid.binners;
                 }
             )
+            .def_readonly("sparse", &Type::sparse)
+            .def_property_readonly("length", [](const Type &grid) {
+                    return grid.length1d;
+                }
+            )
+            // shape of the buffer of the aggregators, a single dimension for sparse grids
+            .def_property_readonly("shape", [](const Type &grid) {
+                    if(grid.sparse)
+                        return std::vector<uint64_t>{grid.length1d};
+                    return std::vector<uint64_t>(grid.shapes, grid.shapes + grid.dimensions);
+                }
+            )
+            .def("add_cells", &Type::add_cells)
+            // for sparse grids, the bin index of each binner (rows) for each cell (columns)
+            .def("sparse_bins", [](const Type &grid) {
+                    py::array_t<int64_t> result({(ssize_t)grid.dimensions, (ssize_t)grid.cell_indices.size()});
+                    auto bins = result.mutable_unchecked<2>();
+                    for(size_t j = 0; j < grid.cell_indices.size(); j++) {
+                        for(size_t i = 0; i < grid.dimensions; i++) {
+                            bins(i, j) = (grid.cell_indices[j] / grid.strides[i]) % grid.shapes[i];
+                        }
+                    }
+                    return result;
+                }
+            )
         ;
     }
 
@@ -853,6 +2092,40 @@ PYBIND11_MODULE(superagg, m) {
     add_binner_ordinal<uint8_t>(m, binner, "uint8");
     add_binner_ordinal<bool>(m, binner, "bool");
 
+    add_binner_edges<double>(m, binner, "float64");
+    add_binner_edges<float>(m, binner, "float32");
+    add_binner_edges<int64_t>(m, binner, "int64");
+    add_binner_edges<int32_t>(m, binner, "int32");
+    add_binner_edges<int16_t>(m, binner, "int16");
+    add_binner_edges<int8_t>(m, binner, "int8");
+    add_binner_edges<uint64_t>(m, binner, "uint64");
+    add_binner_edges<uint32_t>(m, binner, "uint32");
+    add_binner_edges<uint16_t>(m, binner, "uint16");
+    add_binner_edges<uint8_t>(m, binner, "uint8");
+    add_binner_edges<bool>(m, binner, "bool");
+
+    // postfix is the unit of the datetime64 data
+    add_binner_time<86400000000000LL>(m, binner, "ns");
+    add_binner_time<86400000000LL>(m, binner, "us");
+    add_binner_time<86400000LL>(m, binner, "ms");
+    add_binner_time<86400LL>(m, binner, "s");
+    add_binner_time<1440LL>(m, binner, "m");
+    add_binner_time<24LL>(m, binner, "h");
+    add_binner_time<1LL>(m, binner, "D");
+
+    add_binner_hash<double>(m, binner, "float64");
+    add_binner_hash<float>(m, binner, "float32");
+    add_binner_hash<int64_t>(m, binner, "int64");
+    add_binner_hash<int32_t>(m, binner, "int32");
+    add_binner_hash<int16_t>(m, binner, "int16");
+    add_binner_hash<int8_t>(m, binner, "int8");
+    add_binner_hash<uint64_t>(m, binner, "uint64");
+    add_binner_hash<uint32_t>(m, binner, "uint32");
+    add_binner_hash<uint16_t>(m, binner, "uint16");
+    add_binner_hash<uint8_t>(m, binner, "uint8");
+    add_binner_hash<bool>(m, binner, "bool");
+    add_binner_hash_<BinnerHashString<>>(m, binner, "BinnerHash_string");
+
     add_binner_scalar<double>(m, binner, "float64");
     add_binner_scalar<float>(m, binner, "float32");
     add_binner_scalar<int64_t>(m, binner, "int64");
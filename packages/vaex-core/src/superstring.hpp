@@ -19,7 +19,7 @@ inline bool _is_null(uint8_t* null_bitmap, size_t i) {
 
 class StringSequence {
     public:
-    StringSequence(size_t length, uint8_t* null_bitmap=nullptr, int64_t null_offset=0) : length(length), null_bitmap(null_bitmap), null_offset(null_offset) {
+    StringSequence(size_t length, uint8_t* null_bitmap=nullptr, int64_t null_offset=0) : length(length), null_bitmap(null_bitmap), null_offset(null_offset), hashes(nullptr) {
     }
     virtual ~StringSequence() {
     }
@@ -35,6 +35,8 @@ class StringSequence {
     size_t length;
     uint8_t* null_bitmap;
     int64_t null_offset;
+    // optional, precomputed hash_bytes of each string, which the hash maps use instead of hashing
+    const uint64_t* hashes;
 };
 
 #endif
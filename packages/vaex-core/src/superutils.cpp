@@ -1,9 +1,15 @@
+#include "bits.hpp"
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
 #include <numpy/arrayobject.h>
 #include <Python.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace py = pybind11;
 
@@ -13,77 +19,161 @@ namespace vaex {
     void init_hash_primitives(py::module &);
     void init_hash_string(py::module &);
     void init_hash_object(py::module &);
+    void init_hash_combined(py::module &);
+    void init_sort(py::module &);
 }
 
+// the position of the k-th (0 based) set bit in bits
+inline int select_in_word(uint64_t bits, int64_t k) {
+    for(int64_t i = 0; i < k; i++) {
+        bits &= bits - 1;
+    }
+    return vaex::ctz64(bits);
+}
+
+// number of words in a block of the rank index
+const int64_t RANK_BLOCK_WORDS = 16;
+
+// A mask with 1 bit per row, packed in 64 bit words (the lowest bit is the first row), so that a cached
+// selection takes 8x less memory than a byte per row. Views share the words, and start at a bit offset.
+// Which rows are filled in (see is_dirty) is kept as a list of ranges, since we fill the mask a chunk at a time.
 class Mask {
 public:
-    Mask(size_t length) : length(length), _owns_data(true) {
-        mask_data = new uint8_t[length];
-        reset();
+    struct Storage {
+        std::vector<uint64_t> words;
+        std::vector<std::pair<int64_t, int64_t>> filled; // sorted and non overlapping [begin, end) ranges
+        // rank/select index: the number of set bits before each block of RANK_BLOCK_WORDS words, which
+        // is built when needed, and invalidated when the mask changes
+        std::vector<int64_t> rank_index;
+        bool rank_index_valid = false;
+        // Words that only one view owns are written without the GIL (see Mask::set and Mask::reset), the
+        // rank index should not be built while that is in progress. Writers are counted, and the index
+        // is built (with the GIL) when there are no writers.
+        std::mutex mutex;
+        std::condition_variable writers_done;
+        int64_t writers = 0;
+        // marks the words as being written for its lifetime, should be created and destroyed without
+        // the GIL, since ensure_rank_index waits for it while holding the GIL
+        struct write_scope {
+            write_scope(Storage& storage) : storage(storage) {
+                std::lock_guard<std::mutex> lock(storage.mutex);
+                storage.writers++;
+            }
+            ~write_scope() {
+                std::lock_guard<std::mutex> lock(storage.mutex);
+                if(--storage.writers == 0) {
+                    storage.writers_done.notify_all();
+                }
+            }
+            Storage& storage;
+        };
+        // call with the GIL, after the words are changed
+        void invalidate_rank_index() {
+            std::lock_guard<std::mutex> lock(mutex);
+            rank_index_valid = false;
+        }
+        // call with the GIL, the index stays valid until the words are changed
+        void ensure_rank_index() {
+            std::unique_lock<std::mutex> lock(mutex);
+            writers_done.wait(lock, [this] { return writers == 0; });
+            if(rank_index_valid)
+                return;
+            int64_t block_count = (words.size() + RANK_BLOCK_WORDS - 1) / RANK_BLOCK_WORDS;
+            rank_index.resize(block_count + 1);
+            int64_t count = 0;
+            for(int64_t block = 0; block < block_count; block++) {
+                rank_index[block] = count;
+                int64_t end = std::min<int64_t>((block + 1) * RANK_BLOCK_WORDS, words.size());
+                for(int64_t w = block * RANK_BLOCK_WORDS; w < end; w++) {
+                    count += vaex::popcount64(words[w]);
+                }
+            }
+            rank_index[block_count] = count;
+            rank_index_valid = true;
+        }
+        // the number of set bits before position, O(1)
+        int64_t rank(int64_t position) const {
+            int64_t word_index = position >> 6;
+            int64_t count = rank_index[word_index / RANK_BLOCK_WORDS];
+            for(int64_t w = (word_index / RANK_BLOCK_WORDS) * RANK_BLOCK_WORDS; w < word_index; w++) {
+                count += vaex::popcount64(words[w]);
+            }
+            if(position & 63) {
+                count += vaex::popcount64(words[word_index] & ((uint64_t(1) << (position & 63)) - 1));
+            }
+            return count;
+        }
+        // the position of the k-th (0 based) set bit, or -1, O(log n)
+        int64_t select(int64_t k) const {
+            if(k < 0 || k >= rank_index.back())
+                return -1;
+            // the last block that starts with at most k set bits before it
+            int64_t block = std::upper_bound(rank_index.begin(), rank_index.end(), k) - rank_index.begin() - 1;
+            k -= rank_index[block];
+            for(int64_t w = block * RANK_BLOCK_WORDS; w < (int64_t)words.size(); w++) {
+                int64_t count = vaex::popcount64(words[w]);
+                if(k < count) {
+                    return w * 64 + select_in_word(words[w], k);
+                }
+                k -= count;
+            }
+            return -1;
+        }
+    };
+    Mask(size_t length) : storage(std::make_shared<Storage>()), offset(0), length(length) {
+        storage->words.resize(std::max<size_t>((length + 63) / 64, 1));
     }
-    Mask(uint8_t* mask_data, size_t length) : mask_data(mask_data), length(length), _owns_data(false) {
+    Mask(std::shared_ptr<Storage> storage, int64_t offset, int64_t length) : storage(storage), offset(offset), length(length) {
     }
     virtual ~Mask() {
-        if(_owns_data)
-            delete[] mask_data;
     }
     std::pair<int64_t, int64_t> indices(int64_t i1, int64_t i2) {
         if(i2 < i1) {
             throw std::runtime_error("end index should be larger or equal to start index");
         }
-        int64_t count = 0;
-        int64_t start = -1, end = -1;
-        for(int64_t i = 0; i < length; i++) {
-            if(mask_data[i] == 1) {
-                if(count == i1) {
-                    start = i;
-                }
-                if(count == i2) {
-                    end = i;
-                }
-                count++;
-            }
-        }
-        return {start, end};
+        // we keep the GIL, so the index cannot be invalidated or rebuilt while we use it
+        storage->ensure_rank_index();
+        return {select(i1), select(i2)};
     }
     int64_t raw_offset(int64_t logical_offset) {
-        // if(offset >= length) {
-        //     throw std::runtime_error("offset should be smaller than length");
-        // }
-        int64_t counted = 0;
-        int64_t start = -1, end = -1;
-        for(int64_t i = 0; i < length; i++) {
-            if(mask_data[i] == 1) {
-                counted++;
-                if(counted == logical_offset) {
-                    return i;
-                }
-            }
+        // logical_offset is 1 based, since we return the index of the logical_offset-th row that is set
+        if(logical_offset < 1) {
+            return -1;
         }
-        return -1;
+        storage->ensure_rank_index();
+        return select(logical_offset - 1);
     }
     void reset() {
-        py::gil_scoped_release release;
-        std::fill(mask_data, mask_data+length, 2);
+        int64_t begin = offset;
+        int64_t end = offset + length;
+        // the words at the edges can be shared with other views, so we only clear those with the GIL,
+        // the words in between are ours
+        int64_t first_word = (begin + 63) >> 6;
+        int64_t last_word = end >> 6;
+        int64_t head_end = std::min(end, first_word * 64);
+        clear_bits_in_word(begin, head_end);
+        if(first_word < last_word) {
+            py::gil_scoped_release release;
+            Storage::write_scope write(*storage);
+            std::fill(storage->words.begin() + first_word, storage->words.begin() + last_word, 0);
+        }
+        clear_bits_in_word(std::max(head_end, last_word * 64), end);
+        remove_filled(begin, end);
+        // only now, since an index built while we were clearing is out of date
+        storage->invalidate_rank_index();
     }
     int64_t count() {
-        py::gil_scoped_release release;
-        int64_t count = 0;
-        for(int64_t i = 0; i < length; i++) {
-            if(mask_data[i] == 1) {
-                count++;
-            }
-        }
-        return count;
+        storage->ensure_rank_index();
+        return storage->rank(offset + length) - storage->rank(offset);
     }
     int64_t is_dirty() {
-        py::gil_scoped_release release;
-        for(int64_t i = 0; i < length; i++) {
-            if(mask_data[i] == 2) {
-                return true;
+        // we are clean if a single filled range covers us
+        for(auto& range : storage->filled) {
+            if(range.first <= offset && range.second >= offset + length) {
+                return false;
             }
         }
-        return false;
+        return length > 0;
     }
     Mask* view(int64_t start, int64_t end) {
         if(end < start) {
@@ -95,7 +185,75 @@ public:
         if(end > length) {
             throw std::runtime_error("end should be <= length");
         }
-        return new Mask(mask_data+start, end-start);
+        return new Mask(storage, offset + start, end - start);
+    }
+    Mask* copy() {
+        Mask* mask = new Mask(length);
+        for(int64_t w = 0; w < word_count(); w++) {
+            mask->storage->words[w] = word(w);
+        }
+        for(auto& range : storage->filled) {
+            int64_t begin = std::max(range.first, offset) - offset;
+            int64_t end = std::min(range.second, offset + length) - offset;
+            if(begin < end) {
+                mask->storage->filled.push_back({begin, end});
+            }
+        }
+        return mask;
+    }
+    // sets rows [start, start + len(values)) to values (non zero means set), which fills them in
+    void set(int64_t start, py::buffer values) {
+        py::buffer_info info = values.request();
+        if(info.ndim != 1 || info.itemsize != 1) {
+            throw std::runtime_error("Expected a 1d array of booleans");
+        }
+        int64_t count = info.shape[0];
+        if(start < 0 || start + count > length) {
+            throw std::runtime_error("values do not fit in the mask");
+        }
+        const uint8_t* data = (const uint8_t*)info.ptr;
+        int64_t begin = offset + start;
+        int64_t end = begin + count;
+        // neighbouring chunks can share the words at the edges, so we only set those with the GIL,
+        // the words in between are ours, and are packed 64 values at a time
+        int64_t first_word = (begin + 63) >> 6;
+        int64_t last_word = end >> 6;
+        int64_t head_end = std::min(end, first_word * 64);
+        for(int64_t i = begin; i < head_end; i++) {
+            set_bit(i - offset, data[i - begin] != 0);
+        }
+        if(first_word < last_word) {
+            py::gil_scoped_release release;
+            Storage::write_scope write(*storage);
+            for(int64_t w = first_word; w < last_word; w++) {
+                const uint8_t* values_word = data + (w * 64 - begin);
+                uint64_t bits = 0;
+                for(int b = 0; b < 64; b++) {
+                    bits |= uint64_t(values_word[b] != 0) << b;
+                }
+                storage->words[w] = bits;
+            }
+        }
+        for(int64_t i = std::max(head_end, last_word * 64); i < end; i++) {
+            set_bit(i - offset, data[i - begin] != 0);
+        }
+        add_filled(begin, end);
+        storage->invalidate_rank_index();
+    }
+    // rows [i1, i2) as an array of booleans
+    py::array_t<bool> get(int64_t i1, int64_t i2) {
+        if(i2 < i1 || i1 < 0 || i2 > length) {
+            throw std::runtime_error("invalid range");
+        }
+        py::array_t<bool> result(i2 - i1);
+        auto output = result.mutable_unchecked<1>();
+        {
+            py::gil_scoped_release release;
+            for(int64_t i = i1; i < i2; i++) {
+                output(i - i1) = get_bit(i);
+            }
+        }
+        return result;
     }
     py::array_t<int64_t> first(int64_t amount) {
         auto ar = py::array_t<int64_t>(amount);
@@ -103,18 +261,17 @@ public:
         int64_t found = 0;
         {
             py::gil_scoped_release release;
-            for(size_t i = 0; i < length; i++) {
-                if(mask_data[i] == 1) {
-                    ar_unsafe(found++) = i;
-                }
-                if(found == amount) {
-                    break;
+            for(int64_t w = 0; w < word_count() && found < amount; w++) {
+                uint64_t bits = word(w);
+                while(bits && found < amount) {
+                    ar_unsafe(found++) = w * 64 + vaex::ctz64(bits);
+                    bits &= bits - 1;
                 }
             }
         }
         auto ar_trimmed = py::array_t<int64_t>(found);
         auto ar_trimmed_unsafe = ar_trimmed.mutable_unchecked<1>();
-        for(size_t i = 0; i < found; i++) {
+        for(int64_t i = 0; i < found; i++) {
             ar_trimmed_unsafe(i) = ar_unsafe(i);
         }
         return ar_trimmed;
@@ -125,25 +282,102 @@ public:
         int64_t found = 0;
         {
             py::gil_scoped_release release;
-            for(int64_t i = length-1; i >= 0; i--) {
-                if(mask_data[i] == 1) {
-                    ar_unsafe(found++) = i;
-                }
-                if(found == amount) {
-                    break;
+            for(int64_t w = word_count() - 1; w >= 0 && found < amount; w--) {
+                uint64_t bits = word(w);
+                while(bits && found < amount) {
+                    int bit = 63 - vaex::clz64(bits);
+                    ar_unsafe(found++) = w * 64 + bit;
+                    bits &= ~(uint64_t(1) << bit);
                 }
             }
         }
         auto ar_ordered = py::array_t<int64_t>(found);
         auto ar_ordered_unsafe = ar_ordered.mutable_unchecked<1>();
-        for(size_t i = 0; i < found; i++) {
+        for(int64_t i = 0; i < found; i++) {
             ar_ordered_unsafe(i) = ar_unsafe(found-1-i);
         }
         return ar_ordered;
     }
-    uint8_t* mask_data;
+    std::shared_ptr<Storage> storage;
+    int64_t offset; // in bits, for views
     int64_t length;
-    bool _owns_data;
+private:
+    int64_t word_count() const {
+        return (length + 63) / 64;
+    }
+    // the 64 rows starting at row w*64 (of this view), rows beyond the length are 0
+    uint64_t word(int64_t w) const {
+        int64_t position = offset + w * 64;
+        int64_t index = position >> 6;
+        int shift = position & 63;
+        uint64_t bits = storage->words[index] >> shift;
+        if(shift && index + 1 < (int64_t)storage->words.size()) {
+            bits |= storage->words[index + 1] << (64 - shift);
+        }
+        int64_t leftover = length - w * 64;
+        if(leftover < 64) {
+            bits &= (uint64_t(1) << leftover) - 1;
+        }
+        return bits;
+    }
+    bool get_bit(int64_t i) const {
+        int64_t position = offset + i;
+        return (storage->words[position >> 6] >> (position & 63)) & 1;
+    }
+    void set_bit(int64_t i, bool value) {
+        int64_t position = offset + i;
+        uint64_t& word = storage->words[position >> 6];
+        uint64_t bit = uint64_t(1) << (position & 63);
+        word = (word & ~bit) | (-(uint64_t)value & bit);
+    }
+    // clears the bits [begin, end) (positions in the storage), which should be in the same word
+    void clear_bits_in_word(int64_t begin, int64_t end) {
+        int64_t count = end - begin;
+        if(count <= 0) {
+            return;
+        }
+        uint64_t bits = count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+        storage->words[begin >> 6] &= ~(bits << (begin & 63));
+    }
+    // the row of the k-th (0 based) set row, or -1, needs the rank index (see Storage::ensure_rank_index)
+    int64_t select(int64_t k) const {
+        if(k < 0) {
+            return -1;
+        }
+        int64_t position = storage->select(k + storage->rank(offset));
+        if(position == -1 || position >= offset + length) {
+            return -1;
+        }
+        return position - offset;
+    }
+    void add_filled(int64_t begin, int64_t end) {
+        auto& filled = storage->filled;
+        std::vector<std::pair<int64_t, int64_t>> result;
+        for(auto& range : filled) {
+            if(range.second < begin || range.first > end) {
+                result.push_back(range);
+            } else { // overlaps or touches, so merge
+                begin = std::min(begin, range.first);
+                end = std::max(end, range.second);
+            }
+        }
+        result.push_back({begin, end});
+        std::sort(result.begin(), result.end());
+        filled = result;
+    }
+    void remove_filled(int64_t begin, int64_t end) {
+        auto& filled = storage->filled;
+        std::vector<std::pair<int64_t, int64_t>> result;
+        for(auto& range : filled) {
+            if(range.first < begin) {
+                result.push_back({range.first, std::min(range.second, begin)});
+            }
+            if(range.second > end) {
+                result.push_back({std::max(range.first, end), range.second});
+            }
+        }
+        filled = result;
+    }
 };
 
 PYBIND11_MODULE(superutils, m) {
@@ -151,19 +385,15 @@ PYBIND11_MODULE(superutils, m) {
 
     m.doc() = "fast utils";
 
-    py::class_<Mask>(m, "Mask", py::buffer_protocol())
+    py::class_<Mask>(m, "Mask")
         .def(py::init<size_t>())
-        .def_buffer([](Mask &mask) -> py::buffer_info {
-            std::vector<ssize_t> strides = {1};
-            std::vector<ssize_t> shapes = {mask.length};
-            return py::buffer_info(
-                (void*)mask.mask_data,                               /* Pointer to buffer */
-                sizeof(bool),                 /* Size of one scalar */
-                py::format_descriptor<bool>::format(), /* Python struct-style format descriptor */
-                1,                       /* Number of dimensions */
-                shapes,                 /* Buffer dimensions */
-                strides
-            );
+        // so np.asarray(mask) gives the rows as booleans
+        .def("__array__", [](Mask &mask, py::args args, py::kwargs kwargs) -> py::object {
+            py::object result = mask.get(0, mask.length);
+            if(args.size() > 0 && !args[0].is_none()) {
+                result = result.attr("astype")(args[0]);
+            }
+            return result;
         })
         .def_property_readonly("length", [](const Mask &mask) {
                 return mask.length;
@@ -176,7 +406,10 @@ PYBIND11_MODULE(superutils, m) {
         .def("last", &Mask::last)
         .def("reset", &Mask::reset)
         .def("is_dirty", &Mask::is_dirty)
-        .def("view", &Mask::view, py::keep_alive<0, 1>())
+        .def("view", &Mask::view)
+        .def("copy", &Mask::copy)
+        .def("set", &Mask::set)
+        .def("get", &Mask::get)
         // .def("reduce", &Mask::reduce)
     ;
 
@@ -184,4 +417,6 @@ PYBIND11_MODULE(superutils, m) {
     vaex::init_hash_primitives(m);
     vaex::init_hash_string(m);
     vaex::init_hash_object(m);
+    vaex::init_hash_combined(m);
+    vaex::init_sort(m);
 }
@@ -0,0 +1,134 @@
+#ifndef VAEX_TDIGEST_H
+#define VAEX_TDIGEST_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace vaex {
+
+struct centroid {
+    double mean;
+    double weight;
+    bool operator<(const centroid& other) const {
+        return mean < other.mean;
+    }
+};
+
+// A merging t-digest (Dunning & Ertl), which approximates the distribution of the values it has seen
+// with a bounded number of centroids, small near the tails (q ~ 0 or 1) and larger in the center.
+// This gives good relative accuracy for quantiles like p99, and two digests can be merged, so they can
+// be built per thread (and per grid cell) and combined in reduce.
+class tdigest {
+public:
+    tdigest(double compression=100) : compression(compression), total_weight(0), unmerged_weight(0),
+        min(std::numeric_limits<double>::infinity()), max(-std::numeric_limits<double>::infinity()) {
+    }
+    void add(double value, double weight=1) {
+        buffer.push_back(centroid{value, weight});
+        unmerged_weight += weight;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        if(buffer.size() >= buffer_size()) {
+            compress();
+        }
+    }
+    void merge(const tdigest& other) {
+        if(other.count() == 0)
+            return;
+        buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+        buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+        unmerged_weight += other.count();
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        if(buffer.size() >= buffer_size()) {
+            compress();
+        }
+    }
+    double count() const {
+        return total_weight + unmerged_weight;
+    }
+    void compress() {
+        if(buffer.empty())
+            return;
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        std::sort(buffer.begin(), buffer.end());
+        total_weight += unmerged_weight;
+        unmerged_weight = 0;
+        centroids.clear();
+        // greedily merge neighbours, as long as the merged centroid stays within one unit of the scale function k
+        centroid current = buffer[0];
+        double weight_before = 0;
+        double q_limit = q_max(0);
+        for(size_t i = 1; i < buffer.size(); i++) {
+            const centroid& next = buffer[i];
+            double q = (weight_before + current.weight + next.weight) / total_weight;
+            if(q <= q_limit) {
+                current.weight += next.weight;
+                current.mean += (next.mean - current.mean) * next.weight / current.weight;
+            } else {
+                weight_before += current.weight;
+                centroids.push_back(current);
+                q_limit = q_max(weight_before / total_weight);
+                current = next;
+            }
+        }
+        centroids.push_back(current);
+        buffer.clear();
+    }
+    // interpolates between the centroid centers, and between the extremes and the outer centroids
+    double quantile(double q) {
+        compress();
+        if(centroids.empty())
+            return NAN;
+        if(q <= 0)
+            return min;
+        if(q >= 1)
+            return max;
+        if(centroids.size() == 1)
+            return centroids[0].mean;
+        double index = q * total_weight;
+        const centroid& first = centroids.front();
+        if(index < first.weight / 2) {
+            return min + (first.mean - min) * index / (first.weight / 2);
+        }
+        double center = first.weight / 2;
+        for(size_t i = 0; i < centroids.size() - 1; i++) {
+            const centroid& left = centroids[i];
+            const centroid& right = centroids[i+1];
+            double distance = (left.weight + right.weight) / 2;
+            if(center + distance >= index) {
+                double t = (index - center) / distance;
+                return left.mean + t * (right.mean - left.mean);
+            }
+            center += distance;
+        }
+        const centroid& last = centroids.back();
+        double t = (index - center) / (last.weight / 2);
+        return last.mean + std::min(t, 1.) * (max - last.mean);
+    }
+    double compression;
+    double total_weight; // weight in centroids
+    double unmerged_weight; // weight in buffer
+    double min;
+    double max;
+    std::vector<centroid> centroids;
+    std::vector<centroid> buffer;
+private:
+    size_t buffer_size() const {
+        return std::max<size_t>(32, (size_t)(compression * 4));
+    }
+    // k1 scale function k(q) = compression/(2 pi) * asin(2q - 1), returns the q for which k(q) = k(q0) + 1
+    double q_max(double q0) const {
+        // M_PI is not standard (MSVC needs _USE_MATH_DEFINES)
+        constexpr double pi = 3.14159265358979323846;
+        double k = compression / (2 * pi) * asin(2 * q0 - 1) + 1;
+        if(k >= compression / 4)
+            return 1;
+        return (sin(k * 2 * pi / compression) + 1) / 2;
+    }
+};
+
+} // namespace vaex
+#endif
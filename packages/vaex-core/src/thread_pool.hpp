@@ -0,0 +1,197 @@
+#ifndef VAEX_THREAD_POOL_H
+#define VAEX_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vaex {
+
+// Persistent pool of native threads, the calling thread acts as worker 0, so run(n, f)
+// uses n-1 pool threads. Python objects should never be touched from f, since it runs
+// without the GIL.
+class ThreadPool {
+public:
+    ThreadPool(size_t thread_count) : job_workers(0), generation(0), pending(0), stop(false) {
+        if(thread_count < 1)
+            thread_count = 1;
+        for(size_t i = 1; i < thread_count; i++) {
+            threads.emplace_back(&ThreadPool::loop, this, i);
+        }
+    }
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv_start.notify_all();
+        for(auto& thread : threads) {
+            thread.join();
+        }
+    }
+    size_t thread_count() const {
+        return threads.size() + 1;
+    }
+    // calls f(worker_index) for worker_index in [0, worker_count), and waits till all are done
+    // the first exception thrown by any of the workers is rethrown
+    void run(size_t worker_count, std::function<void(size_t)> f) {
+        std::unique_lock<std::mutex> run_lock(run_mutex);
+        worker_count = std::max<size_t>(1, std::min(worker_count, thread_count()));
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job = f;
+            job_workers = worker_count;
+            pending = worker_count - 1;
+            error = nullptr;
+            generation++;
+        }
+        cv_start.notify_all();
+        try {
+            f(0);
+        } catch(...) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!error)
+                error = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        cv_done.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+        if(error) {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+private:
+    void loop(size_t index) {
+        uint64_t seen_generation = 0;
+        while(true) {
+            std::function<void(size_t)> f;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv_start.wait(lock, [&] { return stop || generation != seen_generation; });
+                if(stop)
+                    return;
+                seen_generation = generation;
+                if(index >= job_workers)
+                    continue;
+                f = job;
+            }
+            try {
+                f(index);
+            } catch(...) {
+                std::unique_lock<std::mutex> lock(mutex);
+                if(!error)
+                    error = std::current_exception();
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                pending--;
+            }
+            cv_done.notify_one();
+        }
+    }
+    std::vector<std::thread> threads;
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable cv_start;
+    std::condition_variable cv_done;
+    std::function<void(size_t)> job;
+    size_t job_workers;
+    uint64_t generation;
+    size_t pending;
+    bool stop;
+    std::exception_ptr error;
+};
+
+// follows vaex.multithreading, VAEX_NUM_THREADS overrides the number of cores
+inline size_t default_thread_count() {
+    const char* env = std::getenv("VAEX_NUM_THREADS");
+    if(env) {
+        long count = std::atol(env);
+        if(count > 0)
+            return count;
+    }
+    size_t count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+inline ThreadPool& default_thread_pool() {
+    static ThreadPool pool(default_thread_count());
+    return pool;
+}
+
+// Splits [0, length) in tasks of task_size, and gives each worker a contiguous run of tasks.
+// A worker takes tasks from the front of its own run, and when it runs out, it steals the back
+// half of the run of another worker.
+class WorkStealingRange {
+public:
+    WorkStealingRange(uint64_t length, uint64_t task_size, size_t worker_count) : length(length), task_size(task_size), queues(worker_count) {
+        uint64_t task_count = (length + task_size - 1) / task_size;
+        for(size_t i = 0; i < worker_count; i++) {
+            queues[i].begin = task_count * i / worker_count;
+            queues[i].end = task_count * (i + 1) / worker_count;
+        }
+    }
+    // gives the next row range [begin, end) for this worker, returns false when all work is done
+    bool next(size_t worker, uint64_t& begin, uint64_t& end) {
+        uint64_t task;
+        if(!pop(worker, task) && !steal(worker, task)) {
+            return false;
+        }
+        begin = task * task_size;
+        end = std::min(begin + task_size, length);
+        return true;
+    }
+private:
+    struct Queue {
+        std::mutex mutex;
+        uint64_t begin;
+        uint64_t end;
+        char padding[64]; // avoid false sharing between neighbouring queues
+    };
+    bool pop(size_t worker, uint64_t& task) {
+        Queue& queue = queues[worker];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if(queue.begin == queue.end)
+            return false;
+        task = queue.begin++;
+        return true;
+    }
+    bool steal(size_t worker, uint64_t& task) {
+        size_t worker_count = queues.size();
+        for(size_t i = 1; i < worker_count; i++) {
+            Queue& victim = queues[(worker + i) % worker_count];
+            uint64_t begin, end;
+            {
+                std::unique_lock<std::mutex> lock(victim.mutex);
+                if(victim.begin == victim.end)
+                    continue;
+                uint64_t middle = victim.begin + (victim.end - victim.begin) / 2;
+                begin = middle;
+                end = victim.end;
+                victim.end = middle;
+            }
+            Queue& queue = queues[worker];
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            task = begin;
+            queue.begin = begin + 1;
+            queue.end = end;
+            return true;
+        }
+        return false;
+    }
+    uint64_t length;
+    uint64_t task_size;
+    std::vector<Queue> queues;
+};
+
+}
+
+#endif
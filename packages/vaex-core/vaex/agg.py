@@ -27,6 +27,11 @@ class AggregatorDescriptor(object):
         return value
 
 
+# these aggregators can handle up to 64 selections at once
+_multi_selection_names = ['AggCount', 'AggSum', 'AggMin', 'AggMax']
+_multi_selection_max = 64
+
+
 class AggregatorDescriptorBasic(AggregatorDescriptor):
     def __init__(self, name, expression, short_name, multi_args=False, agg_args=[], selection=None):
         self.name = name
@@ -53,7 +58,7 @@ class AggregatorDescriptorBasic(AggregatorDescriptor):
             return self.finish(value)
         return finish(value)
 
-    def _create_operation(self, df, grid):
+    def _set_dtypes(self, df):
         if self.expression == '*':
             self.dtype_in = np.dtype('int64')
             self.dtype_out = np.dtype('int64')
@@ -64,21 +69,41 @@ class AggregatorDescriptorBasic(AggregatorDescriptor):
                 self.dtype_out = np.dtype('int64')
             if self.short_name in ['sum', 'summoment']:
                 self.dtype_out = vaex.utils.upcast(self.dtype_in)
+
+    def _create_operation(self, df, grid):
+        self._set_dtypes(df)
         agg_op_type = vaex.utils.find_type_from_dtype(vaex.superagg, self.name + "_", self.dtype_in)
         agg_op = agg_op_type(grid, *self.agg_args)
         return agg_op
 
-    def reduce(self, agg_operations, edges=False):
+    def _create_operation_multi(self, df, grid, selection_count):
+        '''Returns a single aggregator for multiple selections (see TaskAggregate), or None when not supported'''
+        if self.name not in _multi_selection_names:
+            return None
+        self._set_dtypes(df)
+        try:
+            agg_op_type = vaex.utils.find_type_from_dtype(vaex.superagg, self.name + "Multi_", self.dtype_in)
+        except ValueError:  # e.g. strings
+            return None
+        return agg_op_type(grid, selection_count)
+
+    def reduce(self, agg_operations, edges=False, out=None):
         agg0 = agg_operations[0]
-        agg0.reduce(agg_operations[1:])
-        grid = np.asarray(agg0)
-        if not edges:
+        if out is not None:
+            # reduce directly in the output buffer, which includes the edges
+            agg0.reduce(agg_operations[1:], out)
+            grid = out
+        else:
+            agg0.reduce(agg_operations[1:])
+            grid = np.asarray(agg0)
+        # sparse grids give a value per cell, and have no edges
+        if not edges and not agg0.grid.sparse:
             grid = vaex.utils.extract_central_part(grid)
         return grid
 
 class AggregatorDescriptorNUnique(AggregatorDescriptorBasic):
-    def __init__(self, name, expression, short_name, dropmissing, dropnan, selection=None):
-        super(AggregatorDescriptorNUnique, self).__init__(name, expression, short_name, selection=selection)
+    def __init__(self, name, expression, short_name, dropmissing, dropnan, agg_args=[], selection=None):
+        super(AggregatorDescriptorNUnique, self).__init__(name, expression, short_name, agg_args=agg_args, selection=selection)
         self.dropmissing = dropmissing
         self.dropnan = dropnan
 
@@ -86,104 +111,51 @@ class AggregatorDescriptorNUnique(AggregatorDescriptorBasic):
         self.dtype_in = df[str(self.expressions[0])].dtype
         self.dtype_out = np.dtype('int64')
         agg_op_type = vaex.utils.find_type_from_dtype(vaex.superagg, self.name + "_", self.dtype_in)
-        agg_op = agg_op_type(grid, self.dropmissing, self.dropnan)
+        agg_op = agg_op_type(grid, self.dropmissing, self.dropnan, *self.agg_args)
         return agg_op
 
-    def reduce(self, agg_operations, edges=False):
-        agg0 = agg_operations[0]
-        agg0.reduce(agg_operations[1:])
-        grid = np.asarray(agg0)
-        if not edges:
-            grid = vaex.utils.extract_central_part(grid)
-        return grid
-
-
-class AggregatorDescriptorMulti(AggregatorDescriptor):
-    """Uses multiple operations/aggregation to calculate the final aggretation"""
-    def __init__(self, name, expression, short_name, selection=None):
-        self.name = name
-        self.short_name = short_name
-        self.expression = expression
-        self.expressions = [self.expression]
-        self.selection = selection
 
-    def pretty_name(self, id=None):
-        id = id or "_".join(map(str, self.expression))
-        return '{0}_{1}'.format(id, self.short_name)
-
-
-class AggregatorDescriptorMean(AggregatorDescriptorMulti):
+class AggregatorDescriptorMean(AggregatorDescriptorBasic):
     def __init__(self, name, expression, short_name="mean", selection=None):
         super(AggregatorDescriptorMean, self).__init__(name, expression, short_name, selection=selection)
 
-    def add_operations(self, agg_task, **kwargs):
-        expression = expression_sum = expression = agg_task.df[str(self.expression)]
-        # ints, floats and bools are upcasted
-        if expression_sum.dtype.kind in "buif":
-            expression = expression_sum = expression_sum.astype('float64')
+    def _create_operation(self, df, grid):
+        self.dtype_in = df[str(self.expressions[0])].dtype
+        # calculated as float64, see finish
+        self.dtype_out = np.dtype('float64')
+        agg_op_type = vaex.utils.find_type_from_dtype(vaex.superagg, self.name + "_", self.dtype_in)
+        agg_op = agg_op_type(grid, *self.agg_args)
+        return agg_op
 
-        sum_agg = sum(expression_sum, selection=self.selection)
-        count_agg = count(expression, selection=self.selection)
+    def finish(self, value):
+        if self.dtype_in.kind in 'mM':
+            value = value.astype(self.dtype_in)
+        return value
 
-        task_sum = sum_agg.add_operations(agg_task, **kwargs)
-        task_count = count_agg.add_operations(agg_task, **kwargs)
-        self.dtype_in = sum_agg.dtype_in
-        self.dtype_out = sum_agg.dtype_out
 
-        @vaex.delayed
-        def finish(sum, count):
-            dtype = sum.dtype
-            if sum.dtype.kind == 'M':
-                sum = sum.view('uint64')
-                count = count.view('uint64')
-            with np.errstate(divide='ignore', invalid='ignore'):
-                mean = sum / count
-            if dtype.kind != mean.dtype.kind:
-                # TODO: not sure why view does not work
-                mean = mean.astype(dtype)
-            return mean
-
-        return finish(task_sum, task_count)
-
-
-class AggregatorDescriptorVar(AggregatorDescriptorMulti):
+class AggregatorDescriptorVar(AggregatorDescriptorBasic):
     def __init__(self, name, expression, short_name="var", ddof=0, selection=None):
-        super(AggregatorDescriptorVar, self).__init__(name, expression, short_name, selection=selection)
+        super(AggregatorDescriptorVar, self).__init__(name, expression, short_name, agg_args=[ddof], selection=selection)
         self.ddof = ddof
 
-    def add_operations(self, agg_task, **kwargs):
-        expression_sum = expression = agg_task.df[str(self.expression)]
-        expression = expression_sum = expression.astype('float64')
-        sum_moment = _sum_moment(str(expression_sum), 2, selection=self.selection)
-        sum_ = sum(str(expression_sum), selection=self.selection)
-        count_ = count(str(expression), selection=self.selection)
-
-        task_sum_moment = sum_moment.add_operations(agg_task, **kwargs)
-        task_sum = sum_.add_operations(agg_task, **kwargs)
-        task_count = count_.add_operations(agg_task, **kwargs)
-        self.dtype_in = sum_.dtype_in
-        self.dtype_out = sum_.dtype_out
-        @vaex.delayed
-        def finish(sum_moment, sum, count):
-            dtype = sum.dtype
-            if sum.dtype.kind == 'M':
-                sum = sum.view('uint64')
-                sum_moment = sum_moment.view('uint64')
-                count = count.view('uint64')
-            with np.errstate(divide='ignore', invalid='ignore'):
-                mean = sum / count
-                raw_moments2 = sum_moment/count
-                variance = (raw_moments2 - mean**2) #* count/(count-self.ddof)
-            if dtype.kind != mean.dtype.kind:
-                # TODO: not sure why view does not work
-                variance = variance.astype(dtype)
-            return self.finish(variance)
-        return finish(task_sum_moment, task_sum, task_count)
+    def _create_operation(self, df, grid):
+        self.dtype_in = df[str(self.expressions[0])].dtype
+        self.dtype_out = np.dtype('float64')
+        agg_op_type = vaex.utils.find_type_from_dtype(vaex.superagg, self.name + "_", self.dtype_in)
+        agg_op = agg_op_type(grid, *self.agg_args)
+        return agg_op
 
 
 class AggregatorDescriptorStd(AggregatorDescriptorVar):
-    def finish(self, value):
-        return value**0.5
+    pass
+
+
+class AggregatorDescriptorQuantile(AggregatorDescriptorMean):
+    def __init__(self, name, expression, short_name, quantile, compression, selection=None):
+        super(AggregatorDescriptorQuantile, self).__init__(name, expression, short_name, selection=selection)
+        self.quantile = quantile
+        self.compression = compression
+        self.agg_args = [quantile, compression]
 
 @register
 def count(expression='*', selection=None):
@@ -191,14 +163,19 @@ def count(expression='*', selection=None):
     return AggregatorDescriptorBasic('AggCount', expression, 'count', selection=selection)
 
 @register
-def sum(expression, selection=None):
-    '''Creates a sum aggregation'''
-    return AggregatorDescriptorBasic('AggSum', expression, 'sum', selection=selection)
+def sum(expression, selection=None, accurate=False):
+    '''Creates a sum aggregation
+
+    :param accurate: use compensated (Neumaier) summation for floating point data, which is slower
+        but does not lose precision when adding values of very different magnitude
+    '''
+    name = 'AggSumAccurate' if accurate else 'AggSum'
+    return AggregatorDescriptorBasic(name, expression, 'sum', selection=selection)
 
 @register
 def mean(expression, selection=None):
     '''Creates a mean aggregation'''
-    return AggregatorDescriptorMean('mean', expression, 'mean', selection=selection)
+    return AggregatorDescriptorMean('AggMean', expression, 'mean', selection=selection)
 
 @register
 def min(expression, selection=None):
@@ -206,9 +183,27 @@ def min(expression, selection=None):
     return AggregatorDescriptorBasic('AggMin', expression, 'min', selection=selection)
 
 @register
-def _sum_moment(expression, moment, selection=None):
+def median(expression, compression=200, selection=None):
+    '''Creates an approximate median aggregation, see :func:`quantile`'''
+    return AggregatorDescriptorQuantile('AggQuantileSketch', expression, 'median', 0.5, compression, selection=selection)
+
+@register
+def quantile(expression, quantile=0.5, compression=200, selection=None):
+    '''Creates an approximate quantile aggregation
+
+    Each bin/group keeps a t-digest sketch, which are merged between threads. This does not need limits, and is most
+    accurate for quantiles near 0 or 1 (e.g. the 99th percentile).
+
+    :param quantile: value between 0 and 1, e.g. 0.99 for the 99th percentile
+    :param compression: larger values give a more accurate result, at the cost of more memory and time
+    '''
+    return AggregatorDescriptorQuantile('AggQuantileSketch', expression, 'quantile', quantile, compression, selection=selection)
+
+@register
+def _sum_moment(expression, moment, selection=None, accurate=False):
     '''Creates a sum of moment aggregator'''
-    return AggregatorDescriptorBasic('AggSumMoment', expression, 'summoment', agg_args=[moment], selection=selection)
+    name = 'AggSumMomentAccurate' if accurate else 'AggSumMoment'
+    return AggregatorDescriptorBasic(name, expression, 'summoment', agg_args=[moment], selection=selection)
 
 @register
 def max(expression, selection=None):
@@ -223,24 +218,29 @@ def first(expression, order_expression, selection=None):
 @register
 def std(expression, ddof=0, selection=None):
     '''Creates a standard deviation aggregation'''
-    return AggregatorDescriptorStd('std', expression, 'std', ddof=ddof, selection=selection)
+    return AggregatorDescriptorStd('AggStd', expression, 'std', ddof=ddof, selection=selection)
 
 @register
 def var(expression, ddof=0, selection=None):
     '''Creates a variance aggregation'''
-    return AggregatorDescriptorVar('var', expression, 'var', ddof=ddof, selection=selection)
+    return AggregatorDescriptorVar('AggVar', expression, 'var', ddof=ddof, selection=selection)
 
-def nunique(expression, dropna=False, dropnan=False, dropmissing=False, selection=None):
+def nunique(expression, dropna=False, dropnan=False, dropmissing=False, selection=None, approximate=False, precision=10):
     """Aggregator that calculates the number of unique items per bin.
 
     :param expression: Expression for which to calculate the unique items
     :param dropmissing: do not count missing values
     :param dropnan: do not count nan values
     :param dropna: short for any of the above, (see :func:`Expression.isna`)
+    :param approximate: estimate the number of unique items using HyperLogLog, which uses a fixed 2**precision bytes
+        per bin, instead of a hash map per bin
+    :param precision: number of bits (4-18) used to select a HyperLogLog register, the relative error is about 1.04/sqrt(2**precision)
     """
     if dropna:
         dropnan = True
         dropmissing = True
+    if approximate:
+        return AggregatorDescriptorNUnique('AggApproxNUnique', expression, 'nunique', dropmissing, dropnan, agg_args=[precision], selection=selection)
     return AggregatorDescriptorNUnique('AggNUnique', expression, 'nunique', dropmissing, dropnan, selection=selection)
 
 # @register
@@ -91,9 +91,11 @@ class ColumnIndexed(Column):
         """
         direct_indices_map = direct_indices_map if direct_indices_map is not None else {}
         if isinstance(column, ColumnIndexed):
-            # TODO: think about what happpens when the indices are masked.. ?
             if id(column.indices) not in direct_indices_map:
                 direct_indices = column.indices[indices]
+                if np.ma.isMaskedArray(indices):
+                    # indexing does not propagate the mask of the indices
+                    direct_indices = np.ma.array(direct_indices, mask=np.ma.getmaskarray(indices) | np.ma.getmaskarray(direct_indices))
                 direct_indices_map[id(column.indices)] = direct_indices
             else:
                 direct_indices = direct_indices_map[id(column.indices)]
@@ -118,9 +120,16 @@ class ColumnIndexed(Column):
             # TODO: this is a workaround, since we do not require yet
             # that Column classes know how to deal with indices, we get
             # the minimal slice, and get those (not the most efficient)
-            i1, i2 = np.min(indices), np.max(indices)
+            mask = np.ma.getmaskarray(indices)
+            if mask.all():  # only missing values (e.g. rows of a full join that only exist on one side)
+                i1, i2 = 0, 0
+            else:
+                i1, i2 = np.min(indices), np.max(indices)
             ar_unfiltered = ar_unfiltered[i1:i2+1]
             indices = indices - i1
+            if np.ma.isMaskedArray(indices):
+                # let the missing values refer to an existing row
+                indices = np.ma.array(np.where(mask, 0, indices.data), mask=mask)
         ar = ar_unfiltered[indices]
         if np.ma.isMaskedArray(indices):
             mask = self.indices.mask[start:stop]
@@ -343,7 +352,7 @@ def _trim_bits(column, i1, i2):
 
 class ColumnStringArrow(ColumnString):
     """Column that unpacks the arrow string column on the fly"""
-    def __init__(self, indices, bytes, length=None, offset=0, string_sequence=None, null_bitmap=None, null_offset=0, references=None):
+    def __init__(self, indices, bytes, length=None, offset=0, string_sequence=None, null_bitmap=None, null_offset=0, references=None, hashes=None):
         self._string_sequence = string_sequence
         self.indices = indices
         self.offset = offset  # to avoid memory copies in trim
@@ -354,6 +363,8 @@ class ColumnStringArrow(ColumnString):
         self.nbytes = self.bytes.nbytes + self.indices.nbytes
         self.null_bitmap = null_bitmap
         self.null_offset = null_offset
+        # optional, precomputed hash of each string (see compute_hashes), which speeds up unique, value_counts, isin and joins
+        self.hashes = hashes
         # references is to keep other objects alive, similar to pybind11's keep_alive
         self.references = references or []
 
@@ -370,6 +381,8 @@ class ColumnStringArrow(ColumnString):
                 self._string_sequence = string_type(_asnumpy(self.bytes), _asnumpy(self.indices), self.length, self.offset, _asnumpy(self.null_bitmap), self.null_offset)
             else:
                 self._string_sequence = string_type(_asnumpy(self.bytes), _asnumpy(self.indices), self.length, self.offset)
+            if self.hashes is not None:
+                self._string_sequence.set_hashes(_asnumpy(self.hashes))
         return self._string_sequence
 
     def __len__(self):
@@ -422,14 +435,24 @@ class ColumnStringArrow(ColumnString):
         null_offset = self.null_offset
         if null_bitmap is not None:
             null_bitmap, null_offset = _trim_bits(self.null_bitmap, i1, i2)
+        hashes = self.hashes
+        if hashes is not None:
+            hashes = _trim(hashes, i1, i2)
         references = self.references + [self]
         return type(self)(indices, bytes, i2-i1, self.offset + byte_offset, null_bitmap=null_bitmap,
-                null_offset=null_offset, references=references)
+                null_offset=null_offset, references=references, hashes=hashes)
 
     @classmethod
     def from_string_sequence(cls, string_sequence):
         s = string_sequence
-        return cls(s.indices, s.bytes, s.length, s.offset, string_sequence=s, null_bitmap=s.null_bitmap)
+        return cls(s.indices, s.bytes, s.length, s.offset, string_sequence=s, null_bitmap=s.null_bitmap, hashes=getattr(s, 'hashes', None))
+
+    def compute_hashes(self):
+        """Computes (in parallel) and caches the hash of each string, which are used by the hash based operations"""
+        if self.hashes is None:
+            self.hashes = self.string_sequence.hash_values()
+            self.string_sequence.set_hashes(self.hashes)
+        return self.hashes
 
     def _zeros_like(self):
         return ColumnStringArrow(np.zeros_like(self.indices), np.zeros_like(self.bytes), self.length, null_bitmap=self.null_bitmap)
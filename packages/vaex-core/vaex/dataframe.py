@@ -351,10 +351,10 @@ class DataFrame(object):
             pass
         return self.map_reduce(map, reduce, [expression], delay=delay, progress=progress, name='nop', to_numpy=False)
 
-    def _set(self, expression, progress=False, selection=None, delay=False):
+    def _set(self, expression, progress=False, selection=None, delay=False, partitions=None):
         column = _ensure_string_from_expression(expression)
         columns = [column]
-        from .hash import ordered_set_type_from_dtype
+        from .hash import ordered_set_type_from_dtype, typed_from_objects, object_set_from, partition_count, merge
         from vaex.column import _to_string_sequence
 
         transient = self[str(expression)].transient or self.filtered or self.is_masked(expression)
@@ -366,10 +366,28 @@ class DataFrame(object):
 
         dtype = self.dtype(column)
         ordered_set_type = ordered_set_type_from_dtype(dtype, transient)
-        sets = [None] * self.executor.thread_pool.nthreads
+        nthreads = self.executor.thread_pool.nthreads
+        if partitions is None:
+            partitions = partition_count(ordered_set_type, self.length_unfiltered(), nthreads)
+        sets = [None] * nthreads
+        # for dtype=object, chunks with only str, int or float values are hashed by type, without the GIL
+        # (the set is used for all rows later on, so not when filtered)
+        typed = dtype == object and not self.filtered and selection is None
+        sets_typed = [{} for i in range(self.executor.thread_pool.nthreads)]
         def map(thread_index, i1, i2, ar):
+            if typed:
+                dtype_typed, ar_typed = typed_from_objects(ar)
+                if dtype_typed is not None:
+                    if dtype_typed not in sets_typed[thread_index]:
+                        sets_typed[thread_index][dtype_typed] = ordered_set_type_from_dtype(dtype_typed)()
+                    set_typed = sets_typed[thread_index][dtype_typed]
+                    if np.ma.isMaskedArray(ar_typed):
+                        set_typed.update(ar_typed.data, np.ma.getmaskarray(ar_typed))
+                    else:
+                        set_typed.update(ar_typed)
+                    return
             if sets[thread_index] is None:
-                sets[thread_index] = ordered_set_type()
+                sets[thread_index] = ordered_set_type(partitions) if partitions > 1 else ordered_set_type()
             if dtype == str_type:
                 previous_ar = ar
                 ar = _to_string_sequence(ar)
@@ -384,15 +402,18 @@ class DataFrame(object):
             pass
         self.map_reduce(map, reduce, columns, delay=delay, name='set', info=True, to_numpy=False, selection=selection)
         sets = [k for k in sets if k is not None]
-        set0 = sets[0]
-        for other in sets[1:]:
-            set0.merge(other)
-        return set0
+        for dtype_typed in set(key for sets_thread in sets_typed for key in sets_thread):
+            sets_dtype = [sets_thread[dtype_typed] for sets_thread in sets_typed if dtype_typed in sets_thread]
+            sets.append(merge(sets_dtype))
+        if len(sets) > 1 and len(set(type(k) for k in sets)) > 1:
+            # mixed types, fall back to hashing objects
+            return object_set_from(sets)
+        return merge(sets)
 
     def _index(self, expression, progress=False, delay=False):
         column = _ensure_string_from_expression(expression)
         columns = [column]
-        from .hash import index_type_from_dtype
+        from .hash import index_type_from_dtype, partition_count, merge
         from vaex.column import _to_string_sequence
 
         transient = self[str(expression)].transient or self.filtered or self.is_masked(expression)
@@ -404,10 +425,12 @@ class DataFrame(object):
 
         dtype = self.dtype(column)
         index_type = index_type_from_dtype(dtype, transient)
-        index_list = [None] * self.executor.thread_pool.nthreads
+        nthreads = self.executor.thread_pool.nthreads
+        partitions = partition_count(index_type, self.length_unfiltered(), nthreads)
+        index_list = [None] * nthreads
         def map(thread_index, i1, i2, ar):
             if index_list[thread_index] is None:
-                index_list[thread_index] = index_type()
+                index_list[thread_index] = index_type(partitions) if partitions > 1 else index_type()
             if dtype == str_type:
                 previous_ar = ar
                 ar = _to_string_sequence(ar)
@@ -422,10 +445,37 @@ class DataFrame(object):
             pass
         self.map_reduce(map, reduce, columns, delay=delay, name='index', info=True, to_numpy=False)
         index_list = [k for k in index_list if k is not None]
-        index0 = index_list[0]
-        for other in index_list[1:]:
-            index0.merge(other)
-        return index0
+        return merge(index_list)
+
+    def _set_combined(self, expressions, kinds, selection=None, delay=False):
+        """Ordered set of the combinations of values of expressions, hashed as a single key per row, see :func:`vaex.hash.combined_keys_from`"""
+        from .hash import ordered_set_string, combined_keys_from, merge
+        expressions = [_ensure_string_from_expression(expression) for expression in expressions]
+        sets = [None] * self.executor.thread_pool.nthreads
+        def map(thread_index, i1, i2, *arrays):
+            if sets[thread_index] is None:
+                sets[thread_index] = ordered_set_string()
+            sets[thread_index].update(combined_keys_from(arrays, kinds))
+        def reduce(a, b):
+            pass
+        self.map_reduce(map, reduce, expressions, delay=delay, name='set', info=True, to_numpy=False, selection=selection)
+        sets = [k for k in sets if k is not None]
+        return merge(sets) if sets else ordered_set_string()
+
+    def _index_combined(self, expressions, kinds, delay=False):
+        """Hash index of the combinations of values of expressions, see :meth:`DataFrame._set_combined`"""
+        from .hash import index_hash_string, combined_keys_from, merge
+        expressions = [_ensure_string_from_expression(expression) for expression in expressions]
+        index_list = [None] * self.executor.thread_pool.nthreads
+        def map(thread_index, i1, i2, *arrays):
+            if index_list[thread_index] is None:
+                index_list[thread_index] = index_hash_string()
+            index_list[thread_index].update(combined_keys_from(arrays, kinds), i1)
+        def reduce(a, b):
+            pass
+        self.map_reduce(map, reduce, expressions, delay=delay, name='index', info=True, to_numpy=False)
+        index_list = [k for k in index_list if k is not None]
+        return merge(index_list) if index_list else index_hash_string()
 
     def unique(self, expression, return_inverse=False, dropna=False, dropnan=False, dropmissing=False, progress=False, selection=None, delay=False):
         if dropna:
@@ -446,7 +496,7 @@ class DataFrame(object):
                     if not transient:
                         assert ar is previous_ar.string_sequence
                 # TODO: what about masked values?
-                inverse[i1:i2:] = ordered_set.map_ordinal(ar)
+                inverse[i1:i2:] = vaex.functions._ordinal_values(ar, ordered_set)
             def reduce(a, b):
                 pass
             self.map_reduce(map, reduce, [expression], delay=delay, name='unique_return_inverse', info=True, to_numpy=False, selection=selection)
@@ -3836,7 +3886,8 @@ class DataFrame(object):
         # which should be shared among multiple ColumnIndex'es, so we store
         # them in this dict
         direct_indices_map = {}
-        indices = np.asarray(indices)
+        if not np.ma.isMaskedArray(indices):  # masked indices give missing values (e.g. for joins)
+            indices = np.asarray(indices)
         if df.filtered and filtered:
             # we translate the indices that refer to filters row indices to
             # indices of the unfiltered row indices
@@ -4021,10 +4072,13 @@ class DataFrame(object):
             start = offset
 
     @docsubst
-    def sort(self, by, ascending=True, kind='quicksort'):
+    def sort(self, by, ascending=True, kind='quicksort', na_position=None):
         '''Return a sorted DataFrame, sorted by the expression 'by'
 
-        The kind keyword is ignored if doing multi-key sorting.
+        The rows are sorted by a parallel native sort (radix sort for numbers and datetimes, merge sort for strings),
+        which is stable, also when sorting in descending order.
+        For dtypes the native sort does not support (e.g. objects), the rows are sorted by numpy, which does not
+        support a different order per expression, or na_position, and raises a ValueError for those.
 
         {note_copy}
 
@@ -4048,22 +4102,62 @@ class DataFrame(object):
           2  a      1  0.64
           3  b      2  0.04
 
-        :param str or expression by: expression to sort by
-        :param bool ascending: ascending (default, True) or descending (False)
-        :param str kind: kind of algorithm to use (passed to numpy.argsort)
+        :param str or expression or list by: expression to sort by, or a list of expressions (the first is the most significant)
+        :param bool or list ascending: ascending (default, True) or descending (False), or a list with a value per expression
+        :param str kind: kind of algorithm to use (passed to numpy.argsort), only used for dtypes the native sort does not support
+        :param str na_position: 'last' or 'first', where to put nan and missing values (last by default)
         '''
         self = self.trim()
-        if not isinstance(by, list):
-            values = self.evaluate(by)
-            indices = np.argsort(values, kind=kind)
-        if isinstance(by, (list, tuple)):
-            by = _ensure_strings_from_expressions(by)[::-1]
-            values = self.evaluate(by)
-            indices = np.lexsort(values)
-        if not ascending:
-            indices = indices[::-1].copy()  # this may be used a lot, so copy for performance
+        by = _ensure_strings_from_expressions(_ensure_list(by))
+        ascending = _ensure_list(ascending)
+        if len(ascending) == 1:
+            ascending = ascending * len(by)
+        if len(ascending) != len(by):
+            raise ValueError('ascending should be a single value, or a value per expression')
+        if na_position not in [None, 'first', 'last']:
+            raise ValueError('na_position should be first or last, not %r' % na_position)
+        if all(self.dtype(expression) == str_type or self.dtype(expression).kind in 'biufmM' for expression in by):
+            indices = self._argsort(by, ascending, na_position != 'first')
+        else:
+            # e.g. objects
+            if any(ascending_key != ascending[0] for ascending_key in ascending[1:]):
+                raise ValueError('a different order per expression is only supported for numbers, datetimes and strings')
+            if na_position is not None:
+                raise ValueError('na_position is only supported for numbers, datetimes and strings')
+            if len(by) == 1:
+                indices = np.argsort(self.evaluate(by[0]), kind=kind)
+            else:
+                indices = np.lexsort(self.evaluate(by[::-1]))
+            if not ascending[0]:
+                indices = indices[::-1].copy()  # this may be used a lot, so copy for performance
         return self.take(indices)
 
+    def _argsort(self, expressions, ascending, na_last=True):
+        """The order of the (filtered) rows sorted by expressions, see :meth:`DataFrame.sort`"""
+        from vaex.column import _to_string_sequence
+        sorter = vaex.superutils.sorter(len(self))
+        for expression, ascending_key in zip(expressions, ascending):
+            values = self.evaluate(expression)
+            if self.dtype(expression) == str_type:
+                sorter.add_string(_to_string_sequence(values), ascending_key)
+                continue
+            mask = np.ma.getmaskarray(values) if np.ma.isMaskedArray(values) else None
+            data = np.ma.getdata(values)
+            data = data.astype(vaex.utils.to_native_dtype(data.dtype), copy=False)
+            if data.dtype.kind in 'mM':
+                # NaT goes with the missing values
+                nat = np.isnat(data)
+                if nat.any():
+                    mask = nat if mask is None else (mask | nat)
+                data = data.view(np.int64)
+            elif data.dtype.kind == 'b':
+                data = data.view(np.uint8)
+            elif data.dtype == np.float16:
+                data = data.astype(np.float32)
+            add = getattr(sorter, 'add_' + str(data.dtype))
+            add(np.ascontiguousarray(data), mask, ascending_key)
+        return sorter.argsort(na_last)
+
     @docsubst
     def fillna(self, value, column_names=None, prefix='__original_', inplace=False):
         '''Return a DataFrame, where missing values/NaN are filled with 'value'.
@@ -4828,12 +4922,11 @@ class DataFrameLocal(DataFrame):
                 # df = df[df.x>0]
                 # df = df[df.x < 10]
                 # in that case we make a copy in __getitem__
+                # (the copy keeps the mask consistent with the cache chunks)
                 if key == FILTER_SELECTION_NAME:
                     df._selection_masks[key] = self._selection_masks[key]
                 else:
-                    df._selection_masks[key] = vaex.superutils.Mask(df._length_original)
-                # and make sure the mask is consistent with the cache chunks
-                np.asarray(df._selection_masks[key])[:] = np.asarray(self._selection_masks[key])
+                    df._selection_masks[key] = self._selection_masks[key].copy()
         for key, value in self.selection_history_indices.items():
             if self.get_selection(key):
                 df.selection_history_indices[key] = value
@@ -5067,16 +5160,16 @@ class DataFrameLocal(DataFrame):
         count = self.count()  # force the cache to be filled
         assert i2 <= count
         cache = self._selection_mask_caches[FILTER_SELECTION_NAME]
-        mask_blocks = iter(sorted(
-            [(k1, k2, block) for (k1, k2), (selection, block) in cache.items()],
-            key=lambda item: item[0]))
+        full_mask = self._selection_masks[FILTER_SELECTION_NAME]
+        mask_blocks = iter(sorted(cache.keys()))
         done = False
 
         offset_unfiltered = 0  # points to the unfiltered arrays
         offset_filtered = 0    # points to the filtered array
         indices = []
         while not done:
-            unfiltered_i1, unfiltered_i2, block = next(mask_blocks)
+            unfiltered_i1, unfiltered_i2 = next(mask_blocks)
+            block = full_mask.get(unfiltered_i1, unfiltered_i2)
             count = block.sum()
             if (offset_filtered + count) < i1:  # i1 does not start in this block
                 assert unfiltered_i2 == offset_unfiltered + len(block)
@@ -5421,19 +5514,22 @@ class DataFrameLocal(DataFrame):
 
         :param other: Other DataFrame to join with (the right side)
         :param on: default key for the left table (self)
-        :param left_on: key for the left table (self), overrides on
-        :param right_on: default key for the right table (other), overrides on
+        :param left_on: key for the left table (self), overrides on. A list of keys matches rows on the combination
+                of their values, hashed as a single key (numbers and strings can be mixed).
+        :param right_on: default key for the right table (other), overrides on, a list of the same length when left_on is
         :param lprefix: prefix to add to the left column names in case of a name collision
         :param rprefix: similar for the right
         :param lsuffix: suffix to add to the left column names in case of a name collision
         :param rsuffix: similar for the right
         :param how: how to join, 'left' keeps all rows on the left, and adds columns (with possible missing values)
                 'right' is similar with self and other swapped. 'inner' will only return rows which overlap.
+                'full' (or 'outer') keeps the rows of both, the rows only on the right come last.
         :param bool allow_duplication: Allow duplication of rows when the joined column contains non-unique values.
         :param inplace: {inplace}
         :return:
         """
         inner = False
+        outer = False
         left = self
         right = other
         if how == 'left':
@@ -5445,14 +5541,23 @@ class DataFrameLocal(DataFrame):
             left_on, right_on = right_on, left_on
         elif how == 'inner':
             inner = True
+        elif how in ['full', 'outer']:
+            outer = True
         else:
-            raise ValueError('join type not supported: {}, only left and right'.format(how))
+            raise ValueError('join type not supported: {}, only left, right, inner and full'.format(how))
         left = left if inplace else left.copy()
 
         left_on = left_on or on
         right_on = right_on or on
+        combined = isinstance(left_on, (list, tuple)) or isinstance(right_on, (list, tuple))
+        left_keys = [_ensure_string_from_expression(k) for k in _ensure_list(left_on)] if left_on is not None else []
+        right_keys = [_ensure_string_from_expression(k) for k in _ensure_list(right_on)] if right_on is not None else []
+        if combined and len(left_keys) != len(right_keys):
+            raise ValueError('left_on and right_on should have the same number of keys')
+        # the names of the join columns on the left, a column on the right with the same name is not added
+        left_key_names = [lprefix + k + lsuffix for k in left_keys]
         for name in right:
-            if left_on and (rprefix + name + rsuffix == lprefix + left_on + lsuffix):
+            if rprefix + name + rsuffix in left_key_names:
                 continue  # it's ok when we join on the same column name
             if name in left and rprefix + name + rsuffix == lprefix + name + lsuffix:
                 raise ValueError('column name collision: {} exists in both column, and no proper suffix given'
@@ -5475,53 +5580,78 @@ class DataFrameLocal(DataFrame):
         else:
             df = left
             # we index the right side, this assumes right is smaller in size
-            index = right._index(right_on)
-            lookup = np.zeros(left._length_original, dtype=np.int64)
-            lookup_extra_chunks = []
-            dtype = left.dtype(left_on)
+            if combined:
+                # both sides should encode the values of a key the same way, e.g. integers as floats when joined with floats
+                from .hash import combined_key_kind
+                kinds = ''
+                for left_key, right_key in zip(left_keys, right_keys):
+                    kind_pair = {combined_key_kind(left.dtype(left_key)), combined_key_kind(right.dtype(right_key))}
+                    if len(kind_pair) > 1 and 's' in kind_pair:
+                        raise ValueError('cannot join strings ({}) with numbers ({})'.format(left_key, right_key))
+                    kinds += 'f' if 'f' in kind_pair else kind_pair.pop()
+                index = right._index_combined(right_keys, kinds)
+            else:
+                index = right._index(right_on)
+                dtype = left.dtype(left_on)
             duplicates_right = index.has_duplicates
 
             if duplicates_right and not allow_duplication:
                 raise ValueError('This join will lead to duplication of rows which is disabled, pass allow_duplication=True')
 
+            # the hash index gives the left and right row indices of the matching rows for each chunk
+            # of the left side, where a left row without a match (not for inner) pairs with right row -1
             from vaex.column import _to_string_sequence
+            chunks = {}
+            keep_unmatched = not inner
+            def map_combined(thread_index, i1, i2, *arrays):
+                from .hash import combined_keys_from
+                chunks[i1] = index.join(combined_keys_from(arrays, kinds), i1, keep_unmatched)
             def map(thread_index, i1, i2, ar):
                 if dtype == str_type:
-                    previous_ar = ar
                     ar = _to_string_sequence(ar)
                 if np.ma.isMaskedArray(ar):
                     mask = np.ma.getmaskarray(ar)
-                    lookup[i1:i2] = index.map_index(ar.data, mask)
-                    if duplicates_right:
-                        extra = index.map_index_duplicates(ar.data, mask, i1)
-                        lookup_extra_chunks.append(extra)
+                    chunks[i1] = index.join(ar.data, mask, i1, keep_unmatched)
                 else:
-                    lookup[i1:i2] = index.map_index(ar)
-                    if duplicates_right:
-                        extra = index.map_index_duplicates(ar, i1)
-                        lookup_extra_chunks.append(extra)
+                    chunks[i1] = index.join(ar, i1, keep_unmatched)
             def reduce(a, b):
                 pass
-            left.map_reduce(map, reduce, [left_on], delay=False, name='fill looking', info=True, to_numpy=False, ignore_filter=True)
-            if len(lookup_extra_chunks):
-                # if the right has duplicates, we increase the left of left, and the lookup array
-                lookup_left = np.concatenate([k[0] for k in lookup_extra_chunks])
-                lookup_right = np.concatenate([k[1] for k in lookup_extra_chunks])
-                left = left.concat(left.take(lookup_left))
-                lookup = np.concatenate([lookup, lookup_right])
-
-            if inner:
-                left_mask_matched = lookup != -1  # all the places where we found a match to the right
-                lookup = lookup[left_mask_matched]  # filter the lookup table to the right
-                left_indices_matched = np.where(left_mask_matched)[0]  # convert mask to indices for the left
+            left.map_reduce(map_combined if combined else map, reduce, left_keys, delay=False, name='join', info=True, to_numpy=False, ignore_filter=True)
+            starts = sorted(chunks)
+            left_indices = np.concatenate([chunks[i1][0] for i1 in starts] + [np.zeros(0, dtype=np.int64)])
+            lookup = np.concatenate([chunks[i1][1] for i1 in starts] + [np.zeros(0, dtype=np.int64)])
+            right_unmatched = None
+            if outer:
+                # the right rows that did not match are added at the end, with missing values for the left columns
+                matched = np.zeros(N_other, dtype=np.bool_)
+                matched[lookup[lookup != -1]] = True
+                right_unmatched = np.where(~matched)[0]
+                left_indices = np.concatenate([left_indices, np.full(len(right_unmatched), -1, dtype=np.int64)])
+                lookup = np.concatenate([lookup, right_unmatched])
+
+            # without duplicates, N pairs means each left row occurs once (in order), so we do not need to take the rows
+            if len(left_indices) != N or (inner and duplicates_right):
+                left_original = left
+                left_missing = left_indices == -1
+                left_lookup = left_indices
+                if left_missing.any():
+                    left_lookup = np.ma.array(np.where(left_missing, 0, left_indices), mask=left_missing)
                 # indices can still refer to filtered rows, so do not drop the filter
-                left = left.take(left_indices_matched, filtered=False, dropfilter=False)
-            else:
-                lookup = np.ma.array(lookup, mask=lookup==-1)
+                left = left.take(left_lookup, filtered=False, dropfilter=False)
+                if outer and len(right_unmatched):
+                    keys_left = left_original.take(left_indices[~left_missing], filtered=False)
+                    keys_right = right.take(right_unmatched)
+                    for left_key, right_key in zip(left_keys, right_keys):
+                        if left_key in left_original.get_column_names(virtual=False) and rprefix + right_key + rsuffix == lprefix + left_key + lsuffix:
+                            # the join column is shared, so we fill in the keys of the rows that only exist on the right
+                            left.columns[left_key] = ColumnConcatenatedLazy([keys_left[left_key], keys_right[right_key]])
+            right_missing = lookup == -1
+            if right_missing.any():
+                lookup = np.ma.array(np.where(right_missing, 0, lookup), mask=right_missing)
             direct_indices_map = {}  # for performance, keeps a cache of two levels of indirection of indices
             for name in right:
-                if rprefix + name + rsuffix == lprefix + left_on + lsuffix:
-                    continue  # skip when it's the join column
+                if rprefix + name + rsuffix in left_key_names:
+                    continue  # skip when it's a join column
                 right_name = name
                 if name in left:
                     left.rename_column(name, lprefix + name + lsuffix)
@@ -5596,7 +5726,7 @@ class DataFrameLocal(DataFrame):
         import vaex_arrow.export
         vaex_arrow.export.export_parquet(self, path, column_names, byteorder, shuffle, selection, progress=progress, virtual=virtual, sort=sort, ascending=ascending)
 
-    def export_hdf5(self, path, column_names=None, byteorder="=", shuffle=False, selection=False, progress=None, virtual=False, sort=None, ascending=True):
+    def export_hdf5(self, path, column_names=None, byteorder="=", shuffle=False, selection=False, progress=None, virtual=False, sort=None, ascending=True, string_hashes=False):
         """Exports the DataFrame to a vaex hdf5 file
 
         :param DataFrameLocal df: DataFrame to export
@@ -5610,10 +5740,11 @@ class DataFrameLocal(DataFrame):
         :param: bool virtual: When True, export virtual columns
         :param str sort: expression used for sorting the output
         :param bool ascending: sort ascending (True) or descending
+        :param bool string_hashes: store the hash of each string next to string columns, which speeds up unique, value_counts, isin and joins after opening
         :return:
         """
         import vaex.export
-        vaex.export.export_hdf5(self, path, column_names, byteorder, shuffle, selection, progress=progress, virtual=virtual, sort=sort, ascending=ascending)
+        vaex.export.export_hdf5(self, path, column_names, byteorder, shuffle, selection, progress=progress, virtual=virtual, sort=sort, ascending=ascending, string_hashes=string_hashes)
 
     def export_fits(self, path, column_names=None, shuffle=False, selection=False, progress=None, virtual=False, sort=None, ascending=True):
         """Exports the DataFrame to a fits file that is compatible with TOPCAT colfits format
@@ -5655,9 +5786,12 @@ class DataFrameLocal(DataFrame):
     #     self._has_selection = mask is not None
     #     # self.signal_selection_changed.emit(self)
 
-    def groupby(self, by=None, agg=None):
+    def groupby(self, by=None, agg=None, sparse=None):
         """Return a :class:`GroupBy` or :class:`DataFrame` object when agg is not None
 
+        Groups come in order of appearance, except for integer columns whose values fill most of a small
+        range, which are grouped by value directly and come sorted by value.
+
         Examples:
 
         >>> import vaex
@@ -5668,22 +5802,22 @@ class DataFrameLocal(DataFrame):
         >>> df = vaex.from_arrays(x=x, y=y)
         >>> df.groupby(df.x, agg='count')
         #    x    y_count
-        0    3          4
-        1    4          2
-        2    1          3
-        3    2          1
+        0    1          3
+        1    2          1
+        2    3          4
+        3    4          2
         >>> df.groupby(df.x, agg=[vaex.agg.count('y'), vaex.agg.mean('y')])
         #    x    y_count    y_mean
-        0    3          4         9
-        1    4          2        16
-        2    1          3         1
-        3    2          1         4
+        0    1          3         1
+        1    2          1         4
+        2    3          4         9
+        3    4          2        16
         >>> df.groupby(df.x, agg={'z': [vaex.agg.count('y'), vaex.agg.mean('y')]})
         #    x    z_count    z_mean
-        0    3          4         9
-        1    4          2        16
-        2    1          3         1
-        3    2          1         4
+        0    1          3         1
+        1    2          1         4
+        2    3          4         9
+        3    4          2        16
 
         Example using datetime:
 
@@ -5704,10 +5838,12 @@ class DataFrameLocal(DataFrame):
         :param dict, list or agg agg: Aggregate operation in the form of a string, vaex.agg object, a dictionary
             where the keys indicate the target column names, and the values the operations, or the a list of aggregates.
             When not given, it will return the groupby object.
+        :param bool sparse: Only keep track of the combinations of groups that occur, instead of all combinations. Useful
+            when grouping by several columns with many unique values. When None, this is decided based on the number of combinations.
         :return: :class:`DataFrame` or :class:`GroupBy` object.
         """
         from .groupby import GroupBy
-        groupby = GroupBy(self, by=by)
+        groupby = GroupBy(self, by=by, sparse=sparse)
         if agg is None:
             return groupby
         else:
@@ -305,7 +305,7 @@ def export_hdf5_v1(dataset, path, column_names=None, byteorder="=", shuffle=Fals
     vaex.hdf5.export.export_hdf5_v1(**kwargs)
 
 
-def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False, selection=False, progress=None, virtual=True, sort=None, ascending=True):
+def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False, selection=False, progress=None, virtual=True, sort=None, ascending=True, string_hashes=False):
     kwargs = locals()
     import vaex.hdf5.export
     vaex.hdf5.export.export_hdf5(**kwargs)
@@ -13,7 +13,7 @@ import tabulate
 
 from vaex.utils import _ensure_strings_from_expressions, _ensure_string_from_expression
 from vaex.column import ColumnString, _to_string_sequence, str_type
-from .hash import counter_type_from_dtype
+from .hash import counter_type_from_dtype, typed_from_objects
 import vaex.serialize
 from . import expresso
 
@@ -571,7 +571,20 @@ class Expression(with_metaclass(Meta)):
 
         counter_type = counter_type_from_dtype(self.dtype, transient)
         counters = [None] * self.ds.executor.thread_pool.nthreads
+        # for dtype=object, chunks with only str, int or float values are counted by type, without the GIL
+        counters_typed = [{} for i in range(self.ds.executor.thread_pool.nthreads)]
         def map(thread_index, i1, i2, ar):
+            if dtype == object:
+                dtype_typed, ar_typed = typed_from_objects(ar)
+                if dtype_typed is not None:
+                    if dtype_typed not in counters_typed[thread_index]:
+                        counters_typed[thread_index][dtype_typed] = counter_type_from_dtype(dtype_typed)()
+                    counter = counters_typed[thread_index][dtype_typed]
+                    if np.ma.isMaskedArray(ar_typed):
+                        counter.update(ar_typed.data, np.ma.getmaskarray(ar_typed))
+                    else:
+                        counter.update(ar_typed)
+                    return 0
             if counters[thread_index] is None:
                 counters[thread_index] = counter_type()
             if dtype == str_type:
@@ -589,10 +602,28 @@ class Expression(with_metaclass(Meta)):
             return a+b
         self.ds.map_reduce(map, reduce, [self.expression], delay=False, progress=progress, name='value_counts', info=True, to_numpy=False)
         counters = [k for k in counters if k is not None]
+        for dtype_typed in set(key for counters_thread in counters_typed for key in counters_thread):
+            counters.append(None)
+            for counters_thread in counters_typed:
+                if dtype_typed in counters_thread:
+                    if counters[-1] is None:
+                        counters[-1] = counters_thread[dtype_typed]
+                    else:
+                        counters[-1].merge(counters_thread[dtype_typed])
         counter0 = counters[0]
         for other in counters[1:]:
-            counter0.merge(other)
+            if type(other) == type(counter0):
+                counter0.merge(other)
         value_counts = counter0.extract()
+        nan_count = counter0.nan_count
+        null_count = counter0.null_count
+        # counters of different types (for dtype=object), equal keys (e.g. 1 and 1.0) are combined like in a dict
+        for other in counters[1:]:
+            if type(other) != type(counter0):
+                for key, count in other.extract().items():
+                    value_counts[key] = value_counts.get(key, 0) + count
+                nan_count += other.nan_count
+                null_count += other.null_count
         index = np.array(list(value_counts.keys()))
         counts = np.array(list(value_counts.values()))
 
@@ -623,12 +654,12 @@ class Expression(with_metaclass(Meta)):
         if not dropna or not dropnan or not dropmissing:
             index = index.tolist()
             counts = counts.tolist()
-            if not (dropnan or dropna) and counter0.nan_count:
+            if not (dropnan or dropna) and nan_count:
                 index = [np.nan] + index
-                counts = [counter0.nan_count] + counts
-            if not (dropmissing or dropna) and counter0.null_count:
+                counts = [nan_count] + counts
+            if not (dropmissing or dropna) and null_count:
                 index = ['missing'] + index
-                counts = [counter0.null_count] + counts
+                counts = [null_count] + counts
 
         return Series(counts, index=index)
 
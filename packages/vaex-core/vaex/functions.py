@@ -2067,8 +2067,20 @@ def _ordinal_values(x, ordered_set):
         isinstance(ordered_set, vaex.superutils.ordered_set_string):
         # sometimes the dtype can be object, but seen as an string array
         x = _to_string_sequence(x)
+    elif x.dtype == object and not isinstance(ordered_set, vaex.superutils.ordered_set_object):
+        # the set of an object column holding only int or float values is typed, see DataFrame._set
+        dtype = np.dtype(np.int64 if isinstance(ordered_set, vaex.superutils.ordered_set_int64) else np.float64)
+        x = np.ma.getdata(x)
+        # masked values can be anything (e.g. None), their ordinal does not matter
+        x = np.where(x == None, 0, x).astype(dtype)
     return ordered_set.map_ordinal(x)
 
+@register_function()
+def _ordinal_values_combined(ordered_set, kinds, *arrays):
+    from vaex.hash import combined_keys_from
+    # the ordinal of the combination of values of each row, see DataFrame._set_combined
+    return ordered_set.map_ordinal(combined_keys_from(arrays, kinds))
+
 @register_function()
 def _choose(ar, choices, default=None):
     from vaex.column import _to_string_sequence
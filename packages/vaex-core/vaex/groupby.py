@@ -8,7 +8,7 @@ try:
 except AttributeError:
     collections_abc = collections
 
-__all__ = ['GroupBy', 'Grouper', 'BinnerTime']
+__all__ = ['GroupBy', 'Grouper', 'GrouperInteger', 'GrouperHash', 'GrouperCombined', 'BinnerTime', 'BinnerEdges', 'AggregationIncremental']
 
 _USE_DELAY = True
 
@@ -53,11 +53,26 @@ class BinnerTime(BinnerBase):
         # divide by every, and round up
         self.N = (self.N + every - 1) // every
         self.bin_values = np.arange(self.tmin.astype(self.resolution_type), self.tmax.astype(self.resolution_type)+1, every)
-        # TODO: we modify the dataframe in place, this is not nice
-        self.begin_name = self.df.add_variable('t_begin', self.tmin.astype(self.resolution_type), unique=True)
-        # TODO: import integer from future?
-        self.binby_expression = str(self.df['%s - %s' % (self.expression.astype(self.resolution_type), self.begin_name)].astype('int') // every)
-        self.binner = self.df._binner_ordinal(self.binby_expression, self.N)
+        dtype = self.df.dtype(self.expression)
+        unit, count = np.datetime_data(dtype)
+        name = 'BinnerTime_' + unit
+        if dtype.byteorder not in "<=|":
+            name += '_non_native'
+        self.binner = None
+        if count == 1 and hasattr(vaex.superagg, name):
+            # bins the datetime values directly
+            self.binby_expression = str(self.expression)
+            begin = self.tmin.astype(self.resolution_type).astype(np.int64).item()
+            try:
+                self.binner = getattr(vaex.superagg, name)(self.binby_expression, self.resolution, every, begin, self.N)
+            except RuntimeError:
+                pass  # e.g. a resolution finer than the unit of the data
+        if self.binner is None:
+            # TODO: we modify the dataframe in place, this is not nice
+            self.begin_name = self.df.add_variable('t_begin', self.tmin.astype(self.resolution_type), unique=True)
+            # TODO: import integer from future?
+            self.binby_expression = str(self.df['%s - %s' % (self.expression.astype(self.resolution_type), self.begin_name)].astype('int') // every)
+            self.binner = self.df._binner_ordinal(self.binby_expression, self.N)
 
     @classmethod
     def per_day(cls, expression, df=None):
@@ -80,23 +95,54 @@ class BinnerTime(BinnerBase):
         return cls(expression, 'Y', df)
 
 
+class BinnerEdges(BinnerBase):
+    """Bins an expression using a sorted array of edges, e.g. for logarithmic or quantile based bins.
+
+    Bin i holds the values in [edges[i], edges[i+1]), and is labeled by its left edge. Values outside
+    the edges are left out.
+
+    Example:
+
+    >>> df.groupby(vaex.BinnerEdges(df.x, np.logspace(0, 3, 4)), agg='count')
+    """
+    def __init__(self, expression, edges, df=None):
+        self.df = df or expression.ds
+        # make sure it's an expression
+        self.expression = self.df[str(expression)]
+        self.edges = np.asarray(edges, dtype=np.float64)
+        self.N = len(self.edges) - 1
+        self.bin_values = self.edges[:-1]
+        self.binby_expression = str(self.expression)
+        type = vaex.utils.find_type_from_dtype(vaex.superagg, "BinnerEdges_", self.df.dtype(self.expression))
+        self.binner = type(self.binby_expression, self.edges)
+
+
 class Grouper(BinnerBase):
-    """Bins an expression to a set of unique bins."""
-    def __init__(self, expression, df=None):
+    """Bins an expression to a set of unique bins.
+
+    :param partitions: number of partitions of the set (see :func:`vaex.hash.partition_count`), by default
+        based on the length of the DataFrame. Merging into a set with more than one partition changes the
+        ordinals of the keys in later partitions, so :meth:`Grouper._update` needs a single partition.
+    :param set: the set of the values of expression, when already computed
+    """
+    def __init__(self, expression, df=None, partitions=None, set=None):
         self.df = df or expression.ds
         self.expression = expression
         # make sure it's an expression
         self.expression = self.df[str(self.expression)]
-        self.set = self.df._set(self.expression)
+        self.set = self.df._set(self.expression, partitions=partitions) if set is None else set
+        self.partitions = getattr(self.set, 'partitions', 1)
 
         # TODO: we modify the dataframe in place, this is not nice
         basename = 'set_%s' % vaex.utils.find_valid_name(str(expression))
         self.setname = self.df.add_variable(basename, self.set, unique=True)
+        self.binby_expression = '_ordinal_values(%s, %s)' % (self.expression, self.setname)
+        self._update_bins()
 
+    def _update_bins(self):
         keys = self.set.keys()
         self.bin_values = keys
-        self.binby_expression = '_ordinal_values(%s, %s)' % (self.expression, self.setname)
-        self.N = len(self.set.keys())
+        self.N = len(keys)
         if self.set.has_null:
             self.N += 1
             self.bin_values = ['null'] + self.bin_values
@@ -105,9 +151,138 @@ class Grouper(BinnerBase):
             self.bin_values = [np.nan] + self.bin_values
         self.binner = self.df._binner_ordinal(self.binby_expression, self.N)
 
+    def _update(self, df):
+        """Adds the values of df to the set, values already present keep their ordinal.
+
+        Returns an array that maps the old bins to the new bins.
+        """
+        if self.partitions > 1:
+            raise ValueError('cannot add values to a set with %d partitions, since that changes the ordinals of existing values' % self.partitions)
+        N, has_nan, has_null = self.N, self.set.has_nan, self.set.has_null
+        other = df._set(str(self.expression), partitions=1)
+        if type(other) != type(self.set):
+            # an object column can give sets of different types, see DataFrame._set
+            self.set = vaex.hash.object_set_from([self.set, other])
+            self.df.add_variable(self.setname, self.set, unique=False)
+        else:
+            self.set.merge(other)
+        self._update_bins()
+        # nan and null come first (if present), which shifts the ordinals of the keys
+        offset = int(has_nan) + int(has_null)
+        offset_new = int(self.set.has_nan) + int(self.set.has_null)
+        mapping = np.arange(N + 3)
+        mapping[2:N + 2] += offset_new - offset
+        if has_nan:
+            mapping[2] = 2
+        if has_null:
+            mapping[2 + int(has_nan)] = 2 + int(self.set.has_nan)
+        mapping[N + 2] = self.N + 2  # overflow
+        return mapping
+
+
+class GrouperInteger(BinnerBase):
+    """Bins an integer expression with a small range of values, without finding the unique values first.
+
+    Each value between the minimum and maximum gets a bin, and the values are binned directly (no hashing).
+    :meth:`DataFrame.groupby` uses this for integer columns whose values fill most of a small range, groups
+    without rows are left out. Unlike :class:`Grouper`, the groups are sorted by value, not in order of appearance.
+    """
+    def __init__(self, expression, df=None, min_value=None, max_value=None):
+        self.df = df or expression.ds
+        # make sure it's an expression
+        self.expression = self.df[str(expression)]
+        if min_value is None or max_value is None:
+            min_value, max_value = self.expression.minmax()
+        self.min_value, self.max_value = int(min_value), int(max_value)
+        self.N = self.max_value - self.min_value + 1
+        self.bin_values = np.arange(self.min_value, self.max_value + 1, dtype=self.df.dtype(self.expression))
+        self.binby_expression = str(self.expression)
+        self.binner = self.df._binner_ordinal(self.binby_expression, self.N, self.min_value)
+
+
+class GrouperHash(BinnerBase):
+    """Bins an expression to a set of unique bins, in a single pass over the data.
+
+    Different from :class:`Grouper`, the unique values are not found up front, but each new value gets
+    a bin while aggregating, which requires a sparse grid. With a single thread (or data that fits in a
+    single chunk) the groups are in order of appearance, otherwise the order depends on which thread
+    saw a value first.
+
+    Example:
+
+    >>> df.groupby(vaex.GrouperHash(df.x), agg='count')
+    """
+    def __init__(self, expression, df=None):
+        self.df = df or expression.ds
+        # make sure it's an expression
+        self.expression = self.df[str(expression)]
+        # we cannot have more groups than rows
+        self.N = self.df.length_unfiltered()
+        self.binby_expression = str(self.expression)
+        type = vaex.utils.find_type_from_dtype(vaex.superagg, "BinnerHash_", self.df.dtype(self.expression))
+        self.binner = type(self.binby_expression, self.N)
+        # only known after aggregating, see _update_bins
+        self.bin_values = None
+
+    def _update_bins(self, binner):
+        """Takes the values of the bins from the binner used for aggregating (all threads reduced into it)"""
+        keys = binner.keys()
+        dtype = self.df.dtype(self.expression)
+        if isinstance(keys, np.ndarray) and dtype.kind in 'mM':
+            keys = keys.view(dtype)
+        bin_values = list(keys)
+        if binner.nan_bin:
+            bin_values[binner.nan_bin - 2] = np.nan
+        if binner.null_bin:
+            # same as Grouper
+            bin_values[binner.null_bin - 2] = 'null'
+        self.bin_values = bin_values
+
+
+class GrouperCombined(BinnerBase):
+    """Bins a combination of expressions to a set of the unique combinations of their values.
+
+    Different from grouping by each expression (a :class:`Grouper` per expression), the values of a row are
+    hashed as a single key, so there is a bin per combination that occurs in the data, instead of a grid of
+    all combinations. Numbers and strings can be mixed.
+
+    Example:
+
+    >>> df.groupby(vaex.GrouperCombined([df.city, df.year]), agg='count')
+    """
+    def __init__(self, expressions, df=None):
+        self.df = df or expressions[0].ds
+        # make sure they are expressions
+        self.expressions = [self.df[str(expression)] for expression in expressions]
+        self.dtypes = [self.df.dtype(expression) for expression in self.expressions]
+        self.kinds = ''.join(vaex.hash.combined_key_kind(dtype) for dtype in self.dtypes)
+        self.set = self.df._set_combined(self.expressions, self.kinds)
+
+        # TODO: we modify the dataframe in place, this is not nice
+        basename = 'set_%s' % '_'.join(vaex.utils.find_valid_name(str(expression)) for expression in self.expressions)
+        self.setname = self.df.add_variable(basename, self.set, unique=True)
+        self.binby_expression = '_ordinal_values_combined(%s, %r, %s)' % (self.setname, self.kinds, ', '.join(map(str, self.expressions)))
+        # the bins are the ordinals of the combinations, their values are only decoded for the labels
+        self.N = self.set.count
+        self.bin_values = np.arange(self.N)
+        self.values = vaex.hash.combined_values(self.set, self.kinds, self.dtypes)
+        self.binner = self.df._binner_ordinal(self.binby_expression, self.N)
+
+    def labels(self, bins):
+        """The values of each expression for the combinations with the given ordinals"""
+        return {str(expression): values[bins] for expression, values in zip(self.expressions, self.values)}
+
+
+# above this number of cells (combinations of groups), GroupBy uses a sparse grid
+_SPARSE_CELLS_MIN = 1e7
+# integer columns with at most this number of values between the minimum and maximum use GrouperInteger,
+# when at least this fraction of those values occurs (otherwise most bins would be empty)
+_GROUPER_INTEGER_RANGE_MAX = 2**16
+_GROUPER_INTEGER_FILL_MIN = 0.25
+
 
 class GroupByBase(object):
-    def __init__(self, df, by):
+    def __init__(self, df, by, sparse=False):
         self.df = df
 
         if not isinstance(by, collections_abc.Iterable)\
@@ -117,7 +292,7 @@ class GroupByBase(object):
         self.by = []
         for by_value in by:
             if not isinstance(by_value, BinnerBase):
-                by_value = Grouper(df[str(by_value)])
+                by_value = self._grouper(df[str(by_value)])
             self.by.append(by_value)
         # self._waslist, [self.by, ] = vaex.utils.listify(by)
         self.coords1d = [k.bin_values for k in self.by]
@@ -125,13 +300,32 @@ class GroupByBase(object):
         # binby may be an expression based on self.by.expression
         # if we want to have all columns, minus the columns grouped by
         # we should keep track of the original expressions, but binby
-        self.groupby_expression = [str(by.expression) for by in self.by]
+        self.groupby_expression = [str(expression) for by in self.by for expression in getattr(by, 'expressions', [by.expression])]
         self.binners = [by.binner for by in self.by]
-        self.grid = vaex.superagg.Grid(self.binners)
         self.shape = [by.N for by in self.by]
+        if any(isinstance(by, GrouperHash) for by in self.by):
+            if sparse is False:
+                raise ValueError('grouping with GrouperHash requires a sparse grid')
+            sparse = True
+        if sparse is None:
+            # count the edges (missing, underflow and overflow) as well
+            cells = np.prod([N + 3 for N in self.shape], dtype=float)
+            sparse = cells > _SPARSE_CELLS_MIN
+        self.sparse = sparse
+        self.grid = vaex.superagg.Grid(self.binners, self.sparse)
         self.dims = self.groupby_expression[:]
 
+    def _grouper(self, expression):
+        return Grouper(expression)
+
     def _agg(self, actions):
+        grids = {}
+        for column_name, aggregate in self._parse_actions(actions):
+            grids[column_name] = self.df._agg(aggregate, self.grid, delay=_USE_DELAY)
+        return grids
+
+    def _parse_actions(self, actions):
+        """Returns a list of (column_name, aggregator descriptor)"""
         df = self.df
         if isinstance(actions, collections_abc.Mapping):
             actions = list(actions.items())
@@ -139,14 +333,12 @@ class GroupByBase(object):
             or isinstance(actions, six.string_types):
             actions = [actions]
 
-
-        grids = {}
+        parsed = []
 
         def add(aggregate, column_name=None, override_name=None):
             if column_name is None or override_name is not None:
                 column_name = aggregate.pretty_name(override_name)
-            values = df._agg(aggregate, self.grid, delay=_USE_DELAY)
-            grids[column_name] = values
+            parsed.append((column_name, aggregate))
 
         for item in actions:
             override_name = None
@@ -181,7 +373,7 @@ class GroupByBase(object):
                             add(aggregate(name), name, override_name=override_name)
                     else:
                         add(aggregate, name, override_name=override_name)
-        return grids
+        return parsed
 
 class BinBy(GroupByBase):
     """Implementation of the binning and aggregation of data, see :method:`binby`."""
@@ -215,30 +407,180 @@ class BinBy(GroupByBase):
 
 class GroupBy(GroupByBase):
     """Implementation of the binning and aggregation of data, see :method:`groupby`."""
-    def __init__(self, df, by):
-        super(GroupBy, self).__init__(df, by)
+    def __init__(self, df, by, sparse=None):
+        super(GroupBy, self).__init__(df, by, sparse=sparse)
+
+    def _grouper(self, expression):
+        """Groups by the unique values (Grouper), or integers with values that fill most of a small range by value
+        directly (GrouperInteger), which bins without hashing, but gives the groups sorted by value"""
+        set = self.df._set(expression)
+        dtype = self.df.dtype(expression)
+        # 8 and 16 bit integers are already counted in an array by Grouper (no hashing)
+        if dtype != vaex.column.str_type and dtype.kind in 'iu' and dtype.itemsize >= 4 and not self.df.is_masked(expression):
+            # the set gives the range, so this does not need another pass over the data
+            keys = np.asarray(set.keys())
+            if len(keys):
+                min_value, max_value = keys.min(), keys.max()
+                values = int(max_value) - int(min_value) + 1
+                if values <= _GROUPER_INTEGER_RANGE_MAX and len(keys) >= _GROUPER_INTEGER_FILL_MIN * values:
+                    return GrouperInteger(expression, min_value=min_value, max_value=max_value)
+        return Grouper(expression, set=set)
 
     def agg(self, actions):
-        # TODO: this basically forms a cartesian product, we can do better, use a
-        # 'multistage' hashmap
+        # unless sparse, this forms a cartesian product of all groups
         arrays = super(GroupBy, self)._agg(actions)
         # we don't want non-existing pairs (e.g. Amsterdam in France does not exist)
         count_agg = vaex.agg.count()
         counts = self.df._agg(count_agg, self.grid, delay=_USE_DELAY)
+        task_agg = self.df._get_task_agg(self.grid)
         self.df.execute()
         if _USE_DELAY:
             arrays = {key: value.get() for key, value in arrays.items()}
             counts = counts.get()
+        # all results are reduced into the grid of the first thread
+        return self._finish(arrays, counts, task_agg.grids[0])
+
+    def incremental(self, actions):
+        """Returns an :class:`AggregationIncremental` that keeps the aggregated state, so rows can be added later.
+
+        Example:
+
+        >>> agg = df.groupby(df.x).incremental({'y': 'sum'})
+        >>> df_grouped = agg.update()  # aggregates all rows
+        >>> df = df.concat(df_new)
+        >>> df_grouped = agg.update(df=df)  # only aggregates the rows of df_new
+        """
+        # the range of GrouperInteger is fixed, so new values need a set of values (Grouper), which
+        # should have a single partition to keep the ordinals of existing values, see Grouper._update
+        by = [Grouper(by.expression, partitions=1) if isinstance(by, GrouperInteger) or (isinstance(by, Grouper) and by.partitions > 1) else by for by in self.by]
+        groupby = GroupBy(self.df, by, sparse=self.sparse) if by != self.by else self
+        return AggregationIncremental(groupby, actions)
+
+    def _finish(self, arrays, counts, grid):
+        """Turns the aggregated grids (including edges) into a DataFrame with a row per non empty group"""
+        if self.sparse:
+            return self._agg_sparse(arrays, counts, grid)
         # take out the edges
         arrays = {key: vaex.utils.extract_central_part(value) for key, value in arrays.items()}
         counts = vaex.utils.extract_central_part(counts)
         mask = counts > 0
         coords = [coord[mask] for coord in np.meshgrid(*self.coords1d, indexing='ij')]
-        labels = {str(by.expression): coord for by, coord in zip(self.by, coords)}
-        df_grouped = vaex.from_dict(labels)
+        df_grouped = vaex.from_dict(self._labels(coords))
         for key, value in arrays.items():
             df_grouped[key] = value[mask]
+        return df_grouped
+
+    def _labels(self, coords):
+        """The columns with the values grouped by, from the bin values of each group (per binner)"""
+        labels = {}
+        for by, coord in zip(self.by, coords):
+            if isinstance(by, GrouperCombined):
+                labels.update(by.labels(coord))
+            else:
+                labels[str(by.expression)] = coord
+        return labels
+
+    def _agg_sparse(self, arrays, counts, grid):
+        for by, binner in zip(self.by, grid.binners):
+            if isinstance(by, GrouperHash):
+                by._update_bins(binner)
+        # the grid holds the bins of each cell
+        bins = grid.sparse_bins()
+        # leave out the edges, and give the same order as the dense case
+        mask = counts > 0
+        for N, dim_bins in zip(self.shape, bins):
+            mask &= (dim_bins >= 2) & (dim_bins < N + 2)
+        bins = bins[:, mask]
+        order = np.lexsort(bins[::-1])
+        bins = bins[:, order]
+        df_grouped = vaex.from_dict(self._labels([np.asarray(by.bin_values)[dim_bins - 2] for by, dim_bins in zip(self.by, bins)]))
         for key, value in arrays.items():
-            df_grouped[key] = value[mask]
+            df_grouped[key] = value[mask][order]
         return df_grouped
 
+
+class AggregationIncremental(object):
+    """Persistent state of a groupby aggregation, to which rows can be added, see :meth:`GroupBy.incremental`.
+
+    On each update only the new rows are binned and aggregated, and folded into the state kept so far. New
+    groups are added to the sets of the groupers, which keep the ordinals of existing groups, and the state
+    is moved to a larger grid when needed.
+    """
+    def __init__(self, groupby, actions):
+        for by in groupby.by:
+            if not isinstance(by, Grouper):
+                raise ValueError('incremental aggregation only supports grouping by value, not by %r' % by)
+        self.groupby = groupby
+        self.aggregates = groupby._parse_actions(actions)
+        # we don't want non-existing pairs, see GroupBy.agg
+        self.aggregates_all = [aggregate for name, aggregate in self.aggregates] + [vaex.agg.count()]
+        self.aggregators = None
+        self.grid = None
+        self.length = 0
+
+    def update(self, i1=None, i2=None, df=None):
+        """Aggregates rows [i1, i2) of df, and returns the aggregated DataFrame of all rows seen so far.
+
+        :param i1: first row, by default the row after the last aggregated row
+        :param i2: end row (exclusive), by default the length of df
+        :param df: DataFrame to take the rows from, by default the DataFrame that was grouped. This can be
+            a DataFrame with rows appended (e.g. using :meth:`DataFrame.concat`).
+        """
+        df = self.groupby.df if df is None else df
+        i1 = self.length if i1 is None else i1
+        i2 = len(df) if i2 is None else i2
+        if i1 < i2:
+            df = df[i1:i2]
+            mappings = []
+            for by in self.groupby.by:
+                mappings.append(by._update(df))
+                df.add_variable(by.setname, by.set, unique=False)
+            self.groupby.coords1d = [by.bin_values for by in self.groupby.by]
+            shape = [by.N for by in self.groupby.by]
+            if self.grid is not None and shape != self.groupby.shape:
+                self._regrid(mappings, shape)
+            self.groupby.shape = shape
+
+            # aggregate the new rows as usual, and fold in the result of the first thread
+            grid = vaex.superagg.Grid([by.binner for by in self.groupby.by], self.groupby.sparse)
+            for aggregate in self.aggregates_all:
+                df._agg(aggregate, grid, delay=True)
+            task_agg = df._get_task_agg(grid)
+            df.execute()
+            aggregators = [aggregation2d[0][0] for agg_desc, selections, aggregation2d, selection_waslist, edges, task in task_agg.aggregations]
+            if self.aggregators is None:
+                self.aggregators = aggregators
+                self.grid = task_agg.grids[0]
+            else:
+                for aggregator, aggregator_new in zip(self.aggregators, aggregators):
+                    aggregator.reduce([aggregator_new])
+            self.length = i2
+        return self._result()
+
+    def _regrid(self, mappings, shape):
+        grid = vaex.superagg.Grid([by.binner for by in self.groupby.by], self.groupby.sparse)
+        if self.groupby.sparse:
+            # we add the cells in the same order, so the cell numbers do not change
+            bins = self.grid.sparse_bins()
+            mapping = grid.add_cells(np.array([mapping[dim_bins] for mapping, dim_bins in zip(mappings, bins)]))
+        else:
+            # dense grids have the first dimension varying fastest
+            shape_new = [N + 3 for N in shape]
+            strides = np.cumprod([1] + shape_new[:-1])
+            bins = np.meshgrid(*mappings, indexing='ij')
+            mapping = np.sum([dim_bins * stride for dim_bins, stride in zip(bins, strides)], axis=0).ravel(order='F')
+        for aggregator in self.aggregators:
+            aggregator.regrid(grid, mapping)
+        self.grid = grid
+
+    def _result(self):
+        if self.aggregators is None:
+            raise ValueError('no rows aggregated yet')
+        arrays = {}
+        for (name, aggregate), aggregator in zip(self.aggregates, self.aggregators):
+            value = np.asarray(aggregator)
+            if aggregate.dtype_out != vaex.column.str_type:
+                value = value.view(vaex.utils.to_native_dtype(aggregate.dtype_out))
+            arrays[name] = aggregate.finish(value)
+        counts = np.asarray(self.aggregators[-1])
+        return self.groupby._finish(arrays, counts, self.grid)
@@ -1,5 +1,6 @@
 import os
-from .column import str_type
+import numpy as np
+from .column import str_type, _to_string_sequence
 
 
 on_rtd = os.environ.get('READTHEDOCS', None) == 'True'
@@ -48,6 +49,118 @@ def index_type_from_dtype(dtype, transient=True):
     name = 'index_hash_' + postfix
     return globals()[name]
 
+# below this many rows, merging the sets of the threads is cheap, and a single partition keeps the order of insertion
+PARTITIONS_MIN_LENGTH = 1000000
+
+
+def partition_count(hash_type, length, nthreads):
+    """Number of partitions for a set/index of hash_type, such that the sets built by nthreads threads can be merged in parallel.
+
+    Only the primitive types support partitioning, for others this returns 1. Types with a small domain (bool,
+    8 and 16 bit integers) directly index an array instead of hashing, and are not partitioned either.
+    """
+    if nthreads > 1 and length >= PARTITIONS_MIN_LENGTH and hasattr(hash_type, 'partitions') and not hash_type.dense:
+        return nthreads
+    return 1
+
+
+def merge(hashes):
+    """Merges the hashes (counters, sets or indices of the same type) into the first, per partition in parallel when partitioned"""
+    hash0 = hashes[0]
+    if len(hashes) > 1 and getattr(hash0, 'partitions', 1) > 1:
+        hash0.merge(hashes[1:])
+    else:
+        for other in hashes[1:]:
+            hash0.merge(other)
+    return hash0
+
+
+def typed_from_objects(ar):
+    """Converts an object array holding only str, only int or only float values to a string sequence, int64 or float64 array.
+
+    Returns (dtype, array), or (None, ar) for other object arrays. The typed versions can be hashed and aggregated
+    without holding the GIL, object arrays cannot.
+    """
+    mask = np.ma.getmaskarray(ar) if np.ma.isMaskedArray(ar) else None
+    data = ar.data if mask is not None else ar
+    kind = classify_objects(data) if mask is None else classify_objects(data, mask)
+    if kind == 'str':
+        return str_type, _to_string_sequence(ar)
+    elif kind in ['int', 'float']:
+        dtype = np.dtype(np.int64 if kind == 'int' else np.float64)
+        if mask is not None:
+            # masked values can be anything
+            data = data.copy()
+            data[mask] = 0
+            return dtype, np.ma.array(data.astype(dtype), mask=mask)
+        return dtype, data.astype(dtype)
+    return None, ar
+
+
+def object_set_from(sets):
+    """Combines ordered sets of any type into an ordered_set_object"""
+    result = ordered_set_object()
+    for set in sets:
+        if isinstance(set, ordered_set_object):
+            result.merge(set)
+            continue
+        result.update(np.array(set.keys() + [None] * set.has_null, dtype=object), np.array([False] * len(set.keys()) + [True] * set.has_null))
+        if set.has_nan:
+            result.update(np.array([np.nan], dtype=object))
+    return result
+
+
+def combined_key_kind(dtype):
+    """The kind of key a column of dtype has in :class:`combined_keys`: 'i' (integers, bools and datetimes), 'f' or 's'"""
+    if dtype == str_type:
+        return 's'
+    if dtype.kind == 'f':
+        return 'f'
+    if dtype.kind in 'biumM':
+        return 'i'
+    raise TypeError('cannot combine keys of type %s' % dtype)
+
+
+def combined_keys_from(arrays, kinds):
+    """Encodes the rows of the key columns (arrays, of the given kinds) as :class:`combined_keys`
+
+    The result can be hashed and compared with the string sets and indices (e.g. ordered_set_string).
+    """
+    keys = combined_keys(len(arrays[0]))
+    for ar, kind in zip(arrays, kinds):
+        if kind == 's':
+            keys.add_string(_to_string_sequence(ar))
+            continue
+        mask = np.ma.getmaskarray(ar) if np.ma.isMaskedArray(ar) else None
+        data = np.ma.getdata(ar)
+        if kind == 'f':
+            keys.add_float64(np.ascontiguousarray(data, dtype=np.float64), mask)
+        else:
+            if data.dtype.kind in 'mM' or data.dtype == np.uint64:
+                # same bits, so the values can be decoded again
+                data = data.astype(data.dtype.newbyteorder('='), copy=False).view(np.int64)
+            keys.add_int64(np.ascontiguousarray(data, dtype=np.int64), mask)
+    keys.encode()
+    return keys
+
+
+def combined_values(ordered_set, kinds, dtypes):
+    """The values of the key columns (of the given kinds and dtypes) of the combined keys in ordered_set, in order of ordinal"""
+    values = []
+    for decoded, kind, dtype in zip(decode_combined_keys(ordered_set, kinds), kinds, dtypes):
+        if kind == 's':
+            # None for missing values, like an object column of strings
+            values.append(np.array(decoded, dtype=object))
+            continue
+        data, mask = decoded
+        if dtype.kind in 'mM' or dtype == np.uint64:
+            data = data.view(dtype.newbyteorder('='))
+        else:
+            data = data.astype(dtype)
+        values.append(np.ma.array(data, mask=mask) if mask.any() else data)
+    return values
+
+
 # from numpy import *
 # import IPython
 # IPython.embed()
\ No newline at end of file
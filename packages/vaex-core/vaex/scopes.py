@@ -188,6 +188,8 @@ class _BlockScopeSelection(ScopeBase):
 
                 # logger.debug("mask for %r is %r", variable, mask)
                 if selection_in_cache == selection:
+                    # the mask is bit packed, so we do not keep the chunk in the cache
+                    mask = full_mask.get(self.i1, self.i2)
                     if self.filter_mask is not None:
                         return mask[self.filter_mask]
                     return mask
@@ -196,18 +198,16 @@ class _BlockScopeSelection(ScopeBase):
                     return self.df.variables[variable]
                 mask_values = selection.evaluate(self.df, variable, self.i1, self.i2, self.filter_mask)
                     
-                # get a view on a subset of the mask
-                sub_mask = full_mask.view(self.i1, self.i2)
-                sub_mask_array = np.asarray(sub_mask)
-                # and update it
+                sub_mask_array = np.zeros(self.i2 - self.i1, dtype=bool)
                 if self.filter_mask is not None:  # if we have a mask, the selection we evaluated is also filtered
-                    sub_mask_array[:] = 0
-                    sub_mask_array[:][self.filter_mask] = mask_values
+                    sub_mask_array[self.filter_mask] = mask_values
                 else:
                     sub_mask_array[:] = mask_values
+                # and put it in the (bit packed) mask
+                full_mask.set(self.i1, sub_mask_array)
                 # logger.debug("put selection in mask with key %r" % (key,))
                 if self.store_in_cache:
-                    cache[key] = selection, sub_mask_array
+                    cache[key] = selection, None
                     # cache[key] = selection, mask_values
                 if self.filter_mask is not None:
                     return sub_mask_array[self.filter_mask]
@@ -493,7 +493,7 @@ class TaskAggregate(Task):
         self.parent_grid = grid
         self.nthreads = self.df.executor.thread_pool.nthreads
         # for each thread, we have 1 grid and a set of binners
-        self.grids = [vaex.superagg.Grid([binner.copy() for binner in grid.binners]) for i in range(self.nthreads)]
+        self.grids = [vaex.superagg.Grid([binner.copy() for binner in grid.binners], grid.sparse) for i in range(self.nthreads)]
         self.aggregations = []
         # self.grids = []
 
@@ -503,8 +503,17 @@ class TaskAggregate(Task):
         def create_aggregator(thread_index):
             # for each selection, we have a separate aggregator, sharing the grid and binners
             return [aggregator_descriptor._create_operation(self.df, self.grids[thread_index]) for selection in selections]
+        aggregation2d = None
+        if 1 < len(selections) <= vaex.agg._multi_selection_max:
+            # if supported, a single aggregator handles all selections in one pass, which gets
+            # a bitmask per row (see map), we recognize this by having 1 aggregator for multiple selections
+            aggregator = aggregator_descriptor._create_operation_multi(self.df, self.grids[0], len(selections))
+            if aggregator is not None:
+                aggregation2d = [[aggregator]] + [[aggregator_descriptor._create_operation_multi(self.df, self.grids[i], len(selections))] for i in range(1, self.nthreads)]
+        if aggregation2d is None:
+            aggregation2d = [create_aggregator(i) for i in range(self.nthreads)]
         task = Task(self.df, [], "--")
-        self.aggregations.append((aggregator_descriptor, selections, [create_aggregator(i) for i in range(self.nthreads)], selection_waslist, edges, task))
+        self.aggregations.append((aggregator_descriptor, selections, aggregation2d, selection_waslist, edges, task))
         self.expressions_all.extend(aggregator_descriptor.expressions)
         self.expressions_all = list(set(self.expressions_all))
         self.dtypes = {expr: self.df.dtype(expr) for expr in self.expressions_all}
@@ -546,8 +555,58 @@ class TaskAggregate(Task):
             else:
                 binner.set_data(block)
                 references.extend([block])
+        N = i2 - i1
+        if filter_mask is not None:
+            N = filter_mask.astype(np.uint8).sum()
+        def set_data(agg, agg_desc, selection_mask):
+            if agg_desc.expressions:
+                assert len(agg_desc.expressions) in [1,2], "only length 1 or 2 supported for now"
+                for i, expression in enumerate(agg_desc.expressions):
+                    block = block_map[agg_desc.expressions[i]]
+                    dtype = self.dtypes[agg_desc.expressions[i]]
+                    # we have data for the aggregator as well
+                    if np.ma.isMaskedArray(block):
+                        block, mask = block.data, np.ma.getmaskarray(block)
+                        block = check_array(block, dtype)
+                        agg.set_data(block, i)
+                        references.extend([block])
+                        if selection_mask is None:
+                            selection_mask = ~mask
+                        else:
+                            selection_mask = selection_mask & ~mask
+                    else:
+                        block = check_array(block, dtype)
+                        agg.set_data(block, i)
+                        references.extend([block])
+            # we only have 1 data mask, since it's locally combined
+            if selection_mask is not None:
+                agg.set_data_mask(selection_mask)
+                references.extend([selection_mask])
+        # the bitmask of each list of selections, bit i is set when a row is in selection i
+        selection_bits_cache = {}
+        def selection_bits(selections):
+            key = tuple(map(str, selections))
+            if key not in selection_bits_cache:
+                bits = np.zeros(N, dtype=np.uint64)
+                for selection_index, selection in enumerate(selections):
+                    bit = np.uint64(1) << np.uint64(selection_index)
+                    if selection:
+                        selection_mask = self.df.evaluate_selection_mask(selection, i1=i1, i2=i2, cache=True)
+                        bits |= selection_mask.astype(np.uint64) * bit
+                    else:
+                        bits |= bit
+                selection_bits_cache[key] = bits
+                references.append(bits)
+            return selection_bits_cache[key]
         all_aggregators = []
         for agg_desc, selections, aggregation2d, selection_waslist, edges, task in self.aggregations:
+            if len(aggregation2d[thread_index]) != len(selections):
+                # a single aggregator for all selections
+                agg = aggregation2d[thread_index][0]
+                all_aggregators.append(agg)
+                agg.set_selection_bits(selection_bits(selections))
+                set_data(agg, agg_desc, None)
+                continue
             for selection_index, selection in enumerate(selections):
                 agg = aggregation2d[thread_index][selection_index]
                 all_aggregators.append(agg)
@@ -559,44 +618,45 @@ class TaskAggregate(Task):
                     # like nunique, they need to know if they should take the value into account or not
                     if hasattr(agg, 'set_selection_mask'):
                         agg.set_selection_mask(selection_mask)
-                if agg_desc.expressions:
-                    assert len(agg_desc.expressions) in [1,2], "only length 1 or 2 supported for now"
-                    dtype_ref = block = block_map[agg_desc.expressions[0]].dtype
-                    for i, expression in enumerate(agg_desc.expressions):
-                        block = block_map[agg_desc.expressions[i]]
-                        dtype = self.dtypes[agg_desc.expressions[i]]
-                        # we have data for the aggregator as well
-                        if np.ma.isMaskedArray(block):
-                            block, mask = block.data, np.ma.getmaskarray(block)
-                            block = check_array(block, dtype)
-                            agg.set_data(block, i)
-                            references.extend([block])
-                            if selection_mask is None:
-                                selection_mask = ~mask
-                            else:
-                                selection_mask = selection_mask & ~mask
-                        else:
-                            block = check_array(block, dtype)
-                            agg.set_data(block, i)
-                            references.extend([block])
-                # we only have 1 data mask, since it's locally combined
-                if selection_mask is not None:
-                    agg.set_data_mask(selection_mask)
-                    references.extend([selection_mask])
-        N = i2 - i1
-        if filter_mask is not None:
-            N = filter_mask.astype(np.uint8).sum()
+                set_data(agg, agg_desc, selection_mask)
         grid.bin(all_aggregators, N)
 
     def reduce(self, results):
         results = []
         for agg_desc, selections, aggregation2d, selection_waslist, edges, task in self.aggregations:
             grids = []
+            out = None
+            sparse = aggregation2d[0][0].grid.sparse
+            if len(aggregation2d[0]) != len(selections):
+                # a single aggregator for all selections, which already has the selection as first dimension
+                aggs = [k[0] for k in aggregation2d]
+                aggs[0].reduce(aggs[1:])
+                result = np.asarray(aggs[0])
+                if not edges and not sparse:
+                    result = result[(slice(None),) + (slice(2, -1),) * (result.ndim - 1)]
+                result = result.view(vaex.utils.to_native_dtype(agg_desc.dtype_out))
+                task.fulfill(result)
+                results.append(result)
+                continue
+            # reduce all selections into a single array, instead of stacking them afterwards
+            # (sparse grids only know their final shape after reducing)
+            if selection_waslist and agg_desc.dtype_out != str_type and not sparse:
+                shape = tuple(aggregation2d[0][0].grid.shape)
+                dtype = vaex.utils.to_native_dtype(agg_desc.dtype_out)
+                if dtype.kind in 'mM':  # datetimes do not support the buffer protocol, we view it as datetime below
+                    dtype = np.dtype('int64')
+                # the grids are Fortran ordered, and the selection should be the slowest varying dimension
+                out = np.moveaxis(np.empty(shape + (len(selections),), dtype=dtype, order='F'), -1, 0)
             for selection_index, selection in enumerate(selections):
                 aggs = [k[selection_index] for k in aggregation2d]
-                grid = agg_desc.reduce(aggs, edges=edges)
+                grid = agg_desc.reduce(aggs, edges=edges, out=out[selection_index] if out is not None else None)
                 grids.append(grid)
-            result = np.asarray(grids) if selection_waslist else grids[0]
+            if out is not None:
+                result = out
+                if not edges:
+                    result = result[(slice(None),) + (slice(2, -1),) * len(shape)]
+            else:
+                result = np.asarray(grids) if selection_waslist else grids[0]
             if agg_desc.dtype_out != str_type:
                 dtype_out = vaex.utils.to_native_dtype(agg_desc.dtype_out)
                 result = result.view(dtype_out)
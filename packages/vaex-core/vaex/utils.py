@@ -80,8 +80,8 @@ def subdivide_mask(mask, parts=None, max_length=None, logical_length=None):
     `np.sum(mask[i1:i2]) == logical_length` (except for the last element).
     """
     if logical_length is None:
-        logical_length = np.asarray(mask).sum()
-    raw_length = len(np.asarray(mask))
+        logical_length = mask.count()
+    raw_length = mask.length
     if max_length is None:
         max_length = (logical_length + parts - 1) / parts
     full_mask = mask
@@ -334,8 +334,12 @@ class Hdf5MemoryMapped(DatasetMemoryMapped):
                             null_bitmap = self._map_hdf5_array(column['null_bitmap'])
                         else:
                             null_bitmap = None
+                        if "hashes" in column:
+                            hashes = self._map_hdf5_array(column['hashes'])
+                        else:
+                            hashes = None
                         from vaex.column import ColumnStringArrow
-                        self.add_column(column_name, ColumnStringArrow(indices, bytes, null_bitmap=null_bitmap))
+                        self.add_column(column_name, ColumnStringArrow(indices, bytes, null_bitmap=null_bitmap, hashes=hashes))
                     else:
                         shape = data.shape
                         if True:  # len(shape) == 1:
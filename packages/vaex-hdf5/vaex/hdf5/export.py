@@ -105,7 +105,7 @@ def export_hdf5_v1(dataset, path, column_names=None, byteorder="=", shuffle=Fals
     return
 
 
-def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False, selection=False, progress=None, virtual=True, sort=None, ascending=True):
+def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False, selection=False, progress=None, virtual=True, sort=None, ascending=True, string_hashes=False):
     """
     :param DatasetLocal dataset: dataset to export
     :param str path: path for file
@@ -116,6 +116,7 @@ def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False,
     :param progress: progress callback that gets a progress fraction as argument and should return True to continue,
             or a default progress bar when progress=True
     :param: bool virtual: When True, export virtual columns
+    :param bool string_hashes: store the hash of each string next to string columns, so they do not need to be computed again
     :return:
     """
 
@@ -183,6 +184,10 @@ def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False,
                     null_bitmap_array = h5column_output.require_dataset('null_bitmap', shape=null_shape, dtype='u1')
                     null_bitmap_array[0] = null_bitmap_array[0]  # make sure the array really exists
 
+                if string_hashes:
+                    hashes_array = h5column_output.require_dataset('hashes', shape=(N, ), dtype='u8')
+                    hashes_array[0] = hashes_array[0]  # make sure the array really exists
+
                 array.attrs["dtype"] = 'str'
                 # TODO: masked support ala arrow?
             else:
@@ -245,6 +250,12 @@ def export_hdf5(dataset, path, column_names=None, byteorder="=", shuffle=False,
     column_names = vaex.export._export(dataset_input=dataset, dataset_output=dataset_output, path=path, random_index_column=random_index_name,
                                        column_names=column_names, selection=selection, shuffle=shuffle, byteorder=byteorder,
                                        progress=progress, sort=sort, ascending=ascending)
+    if string_hashes:
+        # the strings are written now, so we can hash them into the memory mapped hashes
+        for column_name in column_names:
+            column = dataset_output.columns.get(column_name)
+            if isinstance(column, ColumnStringArrow) and column.hashes is not None:
+                column.hashes[:] = column.string_sequence.hash_values()
     import getpass
     import datetime
     user = getpass.getuser()
@@ -161,6 +161,23 @@ def test_nunique():
     assert items == [(0, 3), (1, 2), (2, 1)]
 
 
+def test_nunique_approximate():
+    s = ['aap', 'aap', 'noot', 'mies', None, 'mies', 'kees', 'mies', 'aap']
+    x = [0,     0,     0,      0,      0,     1,      1,     1,      2]
+    df = vaex.from_arrays(x=x, s=s)
+    dfg = df.groupby(df.x, agg={'nunique': vaex.agg.nunique(df.s, approximate=True)}).sort(df.x)
+    assert dfg.nunique.tolist() == [4, 2, 1]
+    dfg = df.groupby(df.x, agg={'nunique': vaex.agg.nunique(df.s, dropmissing=True, approximate=True)}).sort(df.x)
+    assert dfg.nunique.tolist() == [3, 2, 1]
+
+    x = np.arange(100000) % 3
+    y = np.arange(100000) // 7
+    df = vaex.from_arrays(x=x, y=y)
+    dfg = df.groupby(df.x, agg={'nunique': vaex.agg.nunique(df.y, approximate=True, precision=12)}).sort(df.x)
+    exact = [len(np.unique(y[x == i])) for i in range(3)]
+    assert dfg.nunique.tolist() == pytest.approx(exact, rel=0.05)
+
+
 def test_nunique_filtered():
     s = ['aap', 'aap', 'noot', 'mies', None, 'mies', 'kees', 'mies', 'aap']
     x = [0,     0,     0,      0,      0,     1,      1,     1,      2]
@@ -227,3 +244,78 @@ def test_agg_filtered_df_invalid_data():
     df_filtered['y'] = df_filtered.func.custom_function(df_filtered.x)
     # assert df_filtered.y.tolist() == [0, 1, 4, 9, 25, 36, 49, 64, 81]
     assert df_filtered.count(df_filtered.y) == 9
+
+
+def test_mean_var_std_large_offset():
+    x = np.array([1, 2, 3, 4, 5, 6, 7, 8, 9, 10.]) * 1e-3 + 1e9
+    g = np.array([0, 0, 0, 0, 0, 1, 1, 1, 1, 1])
+    df = vaex.from_arrays(x=x, g=g)
+    assert df.x.mean() == pytest.approx(x.mean())
+    assert df.x.var() == pytest.approx(x.var(), rel=1e-4)
+    assert df.x.std() == pytest.approx(x.std(), rel=1e-4)
+    dfg = df.groupby(df.g, agg={'var': vaex.agg.var('x', ddof=1), 'mean': vaex.agg.mean('x')}).sort('g')
+    assert dfg['var'].tolist() == pytest.approx([x[:5].var(ddof=1), x[5:].var(ddof=1)], rel=1e-4)
+    assert dfg['mean'].tolist() == pytest.approx([x[:5].mean(), x[5:].mean()])
+
+
+def test_mean_datetime():
+    t = np.array(['2020-01-01', '2020-01-03', '2020-01-04'], dtype='datetime64[D]').astype('datetime64[ns]')
+    g = np.array([0, 0, 1])
+    df = vaex.from_arrays(t=t, g=g)
+    dfg = df.groupby(df.g, agg={'t': vaex.agg.mean('t')}).sort('g')
+    assert dfg.t.values.tolist() == np.array(['2020-01-02', '2020-01-04'], dtype='datetime64[ns]').tolist()
+
+
+def test_sum_accurate():
+    x = np.array([1e16, 1, -1e16, 1, 1e16, 1, -1e16, 1])
+    g = np.array([0, 0, 0, 0, 1, 1, 1, 1])
+    df = vaex.from_arrays(x=x, g=g)
+    dfg = df.groupby(df.g, agg={'naive': vaex.agg.sum('x'), 'accurate': vaex.agg.sum('x', accurate=True)}).sort('g')
+    assert dfg['accurate'].tolist() == [2, 2]
+    assert dfg['naive'].tolist() != [2, 2]
+
+
+def test_quantile():
+    x = np.arange(1000, dtype='f8')
+    g = np.arange(1000) % 2
+    df = vaex.from_arrays(x=x, g=g)
+    dfg = df.groupby(df.g, agg={'median': vaex.agg.median('x'), 'p99': vaex.agg.quantile('x', 0.99)}).sort('g')
+    assert dfg['median'].tolist() == pytest.approx([np.median(x[::2]), np.median(x[1::2])], rel=0.01)
+    assert dfg['p99'].tolist() == pytest.approx([np.quantile(x[::2], 0.99), np.quantile(x[1::2], 0.99)], rel=0.01)
+    ar = df.binby(by=df.g, agg={'median': 'median'})
+    assert ar.data[0].tolist() == pytest.approx(dfg['median'].tolist())
+
+
+def test_reduce_large_grid_selections():
+    # large enough to reduce in parallel, and selections are reduced into a single array
+    # values are in the middle of the bins
+    x = (np.arange(10000) % 256 + 0.5) / 256
+    y = (np.arange(10000) % 127 + 0.5) / 128
+    df = vaex.from_arrays(x=x, y=y)
+    shape = (256, 128)
+    counts = df.count(binby=[df.x, df.y], limits=[[0, 1], [0, 1]], shape=shape, selection=[None, 'x > 0.5'])
+    assert counts.shape == (2, ) + shape
+    expected = np.histogram2d(x, y, bins=shape, range=[[0, 1], [0, 1]])[0]
+    assert counts[0].tolist() == expected.tolist()
+    assert counts[1].tolist() == np.histogram2d(x[x > 0.5], y[x > 0.5], bins=shape, range=[[0, 1], [0, 1]])[0].tolist()
+    maxes = df.max(df.x, binby=[df.x, df.y], limits=[[0, 1], [0, 1]], shape=shape, selection=[None, 'x > 0.5'])
+    assert maxes.shape == (2, ) + shape
+    assert np.nanmax(maxes[0]) == x.max()
+    assert np.nanmax(maxes[1]) == x.max()
+
+
+def test_multi_selection():
+    # up to 64 selections are handled in one pass by a single aggregator
+    x = np.ma.array(np.arange(100) % 10, mask=np.arange(100) % 13 == 0, dtype='f8')
+    y = np.arange(100.)
+    df = vaex.from_arrays(x=x, y=y)
+    selections = [None] + ['y > %d' % k for k in range(0, 100, 5)]
+    counts = df.count(df.x, binby=df.x, limits=[0, 10], shape=10, selection=selections)
+    sums = df.sum(df.y, binby=df.x, limits=[0, 10], shape=10, selection=selections)
+    mins = df.min(df.y, binby=df.x, limits=[0, 10], shape=10, selection=selections)
+    assert counts.shape == sums.shape == mins.shape == (len(selections), 10)
+    for i, selection in enumerate(selections):
+        assert counts[i].tolist() == df.count(df.x, binby=df.x, limits=[0, 10], shape=10, selection=selection).tolist()
+        assert sums[i].tolist() == df.sum(df.y, binby=df.x, limits=[0, 10], shape=10, selection=selection).tolist()
+        assert mins[i].tolist() == df.min(df.y, binby=df.x, limits=[0, 10], shape=10, selection=selection).tolist()
+    assert df.count(selection=selections).tolist() == [df.count(selection=selection) for selection in selections]
@@ -63,6 +63,20 @@ def test_export_string_mask(tmpdir):
     assert df.s.tolist() == df_arrow.s.tolist()
 
 
+def test_export_string_hashes(tmpdir):
+    df = vaex.from_arrays(s=vaex.string_column(['aap', None, 'mies', 'aap']))
+    path = str(tmpdir.join('test.hdf5'))
+    df.export_hdf5(path, string_hashes=True)
+    df_hdf5 = vaex.open(path)
+    hashes = df_hdf5.columns['s'].hashes
+    assert hashes is not None
+    assert hashes.tolist() == df.columns['s'].string_sequence.hash_values().tolist()
+    assert hashes[0] == hashes[3]
+    assert df.s.tolist() == df_hdf5.s.tolist()
+    assert set(df.s.unique()) == set(df_hdf5.s.unique())
+    assert df_hdf5.s.isin(['mies', None]).tolist() == [False, True, True, False]
+
+
 # N = 2**32+2
 # @pytest.mark.skipif(not os.environ.get('VAEX_EXPORT_BIG', False),
 #                     reason="only runs when the env var VAEX_EXPORT_BIG is defined")
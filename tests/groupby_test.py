@@ -135,6 +135,34 @@ def test_groupby_datetime_quarter():
     assert sum(values) == sum(y)
 
 
+def test_groupby_datetime_month():
+    t = np.arange('1969-11-01T00', '1970-03-01T00', 7, dtype='M8[h]').astype('M8[ns]')
+    y = np.ones(len(t))
+    df = vaex.from_arrays(t=t, y=y)
+    by = vaex.BinnerTime.per_month(df.t)
+    # the datetime values are binned natively, without an expression
+    assert by.binby_expression == 't'
+    dfg = df.groupby(by, agg={'y': 'sum'})
+    months = t.astype('M8[M]')
+    assert dfg.t.tolist() == np.unique(months).tolist()
+    assert dfg.y.tolist() == [np.sum(months == month) for month in np.unique(months)]
+
+
+def test_groupby_edges():
+    x = np.array([0.5, 1, 2, 5, 10, 99, 100, 1000, np.nan])
+    df = vaex.from_arrays(x=x)
+    edges = [1, 10, 100, 1000]
+    dfg = df.groupby(vaex.BinnerEdges(df.x, edges), agg='count')
+    assert dfg.x.tolist() == [1, 10, 100]
+    assert dfg['count'].tolist() == [3, 2, 1]
+    # many edges use a different search
+    edges = np.linspace(0, 1000, 1001)
+    dfg = df.groupby(vaex.BinnerEdges(df.x, edges), agg='count')
+    assert dfg.x.tolist() == [0, 1, 2, 5, 10, 99, 100]
+    with pytest.raises(RuntimeError):
+        vaex.BinnerEdges(df.x, [2, 1])
+
+
 def test_groupby_count():
     # ds = ds_local.extract()
     g = np.array([0, 0, 0, 0, 1, 1, 1, 1, 0, 1], dtype='int32')
@@ -225,3 +253,133 @@ def test_groupby_same_result():
 
         assert vc.values.tolist() == group_sort['count'].values.tolist(), 'counts are not correct.'
         assert vc.index.tolist() == group_sort['h'].values.tolist(), 'the indices of the counts are not correct.'
+
+
+def test_groupby_sparse():
+    x = np.array([0, 1, 1, 2, 5, 5, 5, 7, 9, 9])
+    y = np.array([3, 3, 3, 4, 1, 2, 1, 9, 9, 9])
+    z = np.arange(10.)
+    df = vaex.from_arrays(x=x, y=y, z=z)
+    with small_buffer(df, size=3):
+        dfg_dense = df.groupby(by=[df.x, df.y], agg={'count': 'count', 'z': ['sum', 'mean', 'max']}, sparse=False)
+        dfg_sparse = df.groupby(by=[df.x, df.y], agg={'count': 'count', 'z': ['sum', 'mean', 'max']}, sparse=True)
+    # same order as the dense case, which follows the order of the groups
+    for name in dfg_dense.get_column_names():
+        assert dfg_sparse[name].tolist() == dfg_dense[name].tolist()
+    rows = sorted(zip(dfg_sparse.x.tolist(), dfg_sparse.y.tolist(), dfg_sparse['count'].tolist(), dfg_sparse.z_sum.tolist()))
+    assert rows == [(0, 3, 1, 0), (1, 3, 2, 3), (2, 4, 1, 3), (5, 1, 2, 10), (5, 2, 1, 5), (7, 9, 1, 7), (9, 9, 2, 17)]
+
+
+@pytest.mark.parametrize("sparse", [False, True])
+def test_groupby_incremental(sparse):
+    x = np.array([0, 1, 1, 2, 5, 5, np.nan, 7, 9, 9, 11, 1])
+    y = np.array([3, 3, 3, 4, 1, 2, 1, 9, 9, 9, 3, 4])
+    z = np.arange(12.)
+    df_full = vaex.from_arrays(x=x, y=y, z=z)
+    df = df_full[:6]
+    agg = df.groupby(by=[df.x, df.y], sparse=sparse).incremental({'count': 'count', 'z': ['sum', 'max']})
+
+    def rows(dfg):
+        return sorted(zip(map(str, dfg.x.tolist()), dfg.y.tolist(), dfg['count'].tolist(), dfg.z_sum.tolist(), dfg.z_max.tolist()))
+
+    dfg = agg.update()
+    assert rows(dfg) == rows(df.groupby(by=[df.x, df.y], agg={'count': 'count', 'z': ['sum', 'max']}))
+    # nothing new
+    assert rows(agg.update()) == rows(dfg)
+    # new groups (including nan), and new rows for existing groups
+    dfg = agg.update(df=df_full[:9])
+    assert rows(dfg) == rows(df_full[:9].groupby(by=[df_full.x, df_full.y], agg={'count': 'count', 'z': ['sum', 'max']}))
+    dfg = agg.update(df=df_full)
+    assert rows(dfg) == rows(df_full.groupby(by=[df_full.x, df_full.y], agg={'count': 'count', 'z': ['sum', 'max']}))
+
+
+def test_groupby_incremental_partitioned(monkeypatch):
+    import vaex.hash
+    # large sets are partitioned, merging into those would change the ordinals of existing groups
+    monkeypatch.setattr(vaex.hash, 'PARTITIONS_MIN_LENGTH', 10)
+    x = (np.arange(1000) * 7 % 500).astype('f8')
+    z = np.arange(1000.)
+    df_full = vaex.from_arrays(x=x, z=z)
+    monkeypatch.setattr(df_full.executor, 'buffer_size', 100)
+    monkeypatch.setattr(df_full.executor.thread_pool, 'nthreads', max(2, df_full.executor.thread_pool.nthreads))
+    df = df_full[:400]
+    groupby = df.groupby(df.x)
+    assert groupby.by[0].partitions > 1
+    agg = groupby.incremental({'count': 'count', 'z': ['sum']})
+
+    def rows(dfg):
+        return sorted(zip(dfg.x.tolist(), dfg['count'].tolist(), dfg.z_sum.tolist()))
+
+    for i2 in [400, 700, 1000]:
+        dfg = agg.update(df=df_full[:i2])
+        dff = df_full[:i2]
+        assert rows(dfg) == rows(dff.groupby(dff.x, agg={'count': 'count', 'z': ['sum']}))
+
+
+def test_groupby_hash():
+    x = np.ma.array([0, 1, 1, 2, 5, 5, np.nan, 7, 9, 9, 11, 1], mask=[0] * 11 + [1])
+    s = np.array(['aap', 'noot', 'mies', 'aap', 'aap', 'noot', 'kees', 'mies', 'aap', 'aap', 'kees', 'noot'])
+    z = np.arange(12.)
+    df = vaex.from_arrays(x=x, s=s, z=z)
+
+    def rows(dfg):
+        return sorted(zip(map(str, dfg.x.tolist()), dfg.s.tolist(), dfg['count'].tolist(), dfg.z_sum.tolist()))
+
+    with small_buffer(df, size=3):
+        dfg = df.groupby([df.x, df.s], agg={'count': 'count', 'z': ['sum']})
+        dfg_hash = df.groupby([vaex.GrouperHash(df.x), vaex.GrouperHash(df.s)], agg={'count': 'count', 'z': ['sum']})
+    assert rows(dfg_hash) == rows(dfg)
+    # groups are in order of appearance
+    dfg_hash = df.groupby(vaex.GrouperHash(df.s), agg='count')
+    assert dfg_hash.s.tolist() == ['aap', 'noot', 'mies', 'kees']
+    assert dfg_hash['count'].tolist() == [5, 3, 2, 2]
+    with pytest.raises(ValueError):
+        df.groupby(vaex.GrouperHash(df.s), sparse=False)
+
+
+def test_groupby_combined():
+    x = np.ma.array([0, 1, 1, 2, 5, 5, 3, 7, 9, 9, 11, 1], mask=[0] * 11 + [1])
+    y = np.array([0.5, np.nan, 1.0, 0.5, 0.5, 0.5, 1.0, np.nan, 0.5, 0.5, 1.0, 0.5])
+    s = np.array(['aap', 'noot', 'mies', 'aap', 'aap', 'noot', 'kees', 'mies', 'aap', 'aap', 'kees', 'noot'])
+    z = np.arange(12.)
+    df = vaex.from_arrays(x=x, y=y, s=s, z=z)
+
+    def rows(dfg):
+        # Grouper labels a missing value 'null', GrouperCombined gives a masked value
+        x = ['null' if k is None else str(k) for k in dfg.x.tolist()]
+        return sorted(zip(x, map(str, dfg.y.tolist()), dfg.s.tolist(), dfg['count'].tolist(), dfg.z_sum.tolist()))
+
+    with small_buffer(df, size=3):
+        dfg = df.groupby([df.x, df.y, df.s], agg={'count': 'count', 'z': ['sum']})
+        groupby = df.groupby(vaex.GrouperCombined([df.x, df.y, df.s]))
+        # a single bin per combination that occurs
+        assert groupby.shape == [11]
+        dfg_combined = groupby.agg({'count': 'count', 'z': ['sum']})
+    assert rows(dfg_combined) == rows(dfg)
+    assert df.groupby(vaex.GrouperCombined([df.x, df.y, df.s]), agg={'count': 'count', 'z': ['sum']}, sparse=True).shape == dfg_combined.shape
+
+
+def test_groupby_integer_range():
+    x = np.array([8, 5, 7, 8, 7, 7], dtype=np.int32)
+    w = np.array([-3, 1000, 7, -3, 7, 7], dtype=np.int32)
+    y = np.array([0, 2**40, 1, 0, 1, 1], dtype=np.int64)
+    c = np.array([-1, 3, 3, 100, -128, 3], dtype=np.int8)
+    z = np.arange(6.)
+    df = vaex.from_arrays(x=x, w=w, y=y, c=c, z=z)
+    # values that fill most of a small range are binned directly, otherwise we fall back to hashing
+    groupby = df.groupby([df.x, df.w, df.y])
+    assert isinstance(groupby.by[0], vaex.GrouperInteger)
+    assert isinstance(groupby.by[1], vaex.Grouper)
+    assert isinstance(groupby.by[2], vaex.Grouper)
+    dfg = groupby.agg({'z': 'sum'}).sort('w')
+    assert dfg.w.tolist() == [-3, 7, 1000]
+    assert dfg.x.tolist() == [8, 7, 5]
+    assert dfg.z.tolist() == [3, 9, 1]
+    # binned directly, so sorted by value instead of in order of appearance
+    dfg = df.groupby(df.x, agg={'z': 'sum'})
+    assert dfg.x.tolist() == [5, 7, 8]
+    assert dfg.z.tolist() == [1, 11, 3]
+    dfg = df.groupby(df.c, agg='count').sort('c')
+    assert dfg.c.tolist() == [-128, -1, 3, 100]
+    assert dfg['count'].tolist() == [1, 1, 3, 1]
+    assert df.c.value_counts().to_dict() == {3: 3, -1: 1, 100: 1, -128: 1}
@@ -35,4 +35,51 @@ def test_chunking():
             part = full_mask[i1:i2]
             total += part.sum()
             assert part.sum() <= n
-        assert total == 7
\ No newline at end of file
+        assert total == 7
+
+def test_mask_bit_packed():
+    values = np.arange(100) % 3 == 0
+    mask = vaex.superutils.Mask(len(values))
+    assert mask.is_dirty()
+    mask.set(0, values[:37])
+    assert mask.is_dirty()
+    mask.set(37, values[37:])
+    assert not mask.is_dirty()
+    assert np.asarray(mask).tolist() == values.tolist()
+    assert mask.count() == values.sum()
+    assert mask.first(5).tolist() == np.where(values)[0][:5].tolist()
+    assert mask.last(5).tolist() == np.where(values)[0][-5:].tolist()
+    # views do not need to start at a byte/word boundary
+    view = mask.view(5, 77)
+    assert view.get(0, 72).tolist() == values[5:77].tolist()
+    assert view.count() == values[5:77].sum()
+    assert view.raw_offset(3) == np.where(values[5:77])[0][2]
+    assert mask.indices(2, 10) == tuple(np.where(values)[0][[2, 10]])
+    copy = view.copy()
+    view.reset()
+    assert mask.is_dirty()
+    assert mask.count() == values[:5].sum() + values[77:].sum()
+    assert copy.get(0, 72).tolist() == values[5:77].tolist()
+
+
+def test_mask_rank_select():
+    values = np.random.RandomState(42).random_sample(10000) < 0.3
+    indices = np.where(values)[0]
+    mask = vaex.superutils.Mask(len(values))
+    mask.set(0, values)
+    for i in [0, 1, 100, len(indices) // 2, len(indices) - 1]:
+        assert mask.raw_offset(i + 1) == indices[i]
+    assert mask.indices(10, len(indices) - 1) == (indices[10], indices[-1])
+    view = mask.view(1001, 9003)
+    view_indices = np.where(values[1001:9003])[0]
+    assert view.count() == len(view_indices)
+    assert view.indices(0, len(view_indices) - 1) == (view_indices[0], view_indices[-1])
+    # the index is rebuilt when the mask changes
+    mask.set(0, ~values)
+    assert mask.count() == len(values) - len(indices)
+    assert mask.raw_offset(1) == np.where(~values)[0][0]
+    # the words in between are cleared without the GIL, the words at the edges are shared with the rest
+    view.reset()
+    expected = ~values
+    expected[1001:9003] = False
+    assert np.asarray(mask).tolist() == expected.tolist()
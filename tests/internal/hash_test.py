@@ -24,6 +24,21 @@ def test_counter_string(counter_cls):
     assert counts["mies"] == 1
 
 
+def test_ordered_set_string_merge():
+    long = 'x' * 100000
+    strings = vaex.strings.array(['aap', '', long, 'aap', None])
+    set1 = ordered_set_string()
+    set1.update(strings)
+    set2 = ordered_set_string()
+    set2.update(vaex.strings.array(['noot', long]))
+    del strings
+    set1.merge(set2)
+    assert set1.keys() == ['aap', '', long, 'noot']
+    assert set1.has_null
+    ordinals = set1.map_ordinal(vaex.strings.array([long, 'noot', 'mies', None]))
+    assert ordinals.tolist() == [3, 4, -1, 0]
+
+
 def test_counter_float64():
     ar = np.arange(3, dtype='f8')
     counter = counter_float64()
@@ -66,6 +81,65 @@ def test_counter_float64():
     assert counts[10] == 1
     assert counts[1] == 1
 
+def test_counter_int64_blocks():
+    # more values than a single hash block, with a presized map
+    ar = np.arange(1000, dtype='i8') % 300
+    mask = ar == 7
+    counter = counter_int64()
+    counter.reserve(300)
+    counter.update(ar, mask)
+    counts = counter.extract()
+    assert len(counts) == 299
+    assert counts[0] == 4
+    assert counts[299] == 3
+    assert counter.null_count == 4
+
+    oset = ordered_set_int64()
+    oset.reserve(10)  # too small, so it has to grow
+    oset.update(ar)
+    assert oset.map_ordinal(ar[:300]).tolist() == list(range(300))
+
+
+def test_ordered_set_partitioned():
+    ar = np.arange(1000, dtype='i8') % 300
+    sets = [ordered_set_int64(4) for i in range(3)]
+    for i, ordered_set in enumerate(sets):
+        ordered_set.update(ar[i::3])
+    sets[0].update([np.nan])
+    set0 = sets[0]
+    assert set0.partitions == 4
+    set0.merge(sets[1:])
+    keys = set0.keys()
+    assert sorted(keys) == list(range(300))
+    assert set0.map_ordinal(np.array(keys)).tolist() == list(range(300))
+    assert set0.extract() == {key: i for i, key in enumerate(keys)}
+
+    index = index_hash_int64(4)
+    index.update(ar)
+    index2 = index_hash_int64(2)  # different partitioning
+    index2.update(ar, 1000)
+    index.merge([index2])
+    assert len(index) == 2000
+    assert index.has_duplicates
+    indices, matches = index.map_index_duplicates(np.array([299]), 0)
+    assert sorted(matches.tolist() + [index.map_index(np.array([299]))[0]]) == [299, 599, 899, 1299, 1599, 1899]
+
+
+def test_unique_partitioned(monkeypatch):
+    import vaex.hash
+    monkeypatch.setattr(vaex.hash, 'PARTITIONS_MIN_LENGTH', 10)
+    x = np.arange(1000) % 300
+    df = vaex.from_arrays(x=x)
+    monkeypatch.setattr(df.executor, 'buffer_size', 100)
+    assert sorted(df.x.unique().tolist()) == list(range(300))
+    values, inverse = df.unique(df.x, return_inverse=True)
+    assert values[inverse].tolist() == x.tolist()
+    # small integers index an array directly, which cannot be partitioned by hash
+    assert vaex.hash.partition_count(ordered_set_int16, 10**9, 8) == 1
+    assert ordered_set_int16(8).partitions == 1
+    assert vaex.hash.partition_count(ordered_set_int32, 10**9, 8) == 8
+
+
 def test_ordered_set_object():
     s = str("hi there!!")
     ar = np.array([0, 1.5, s, None, s], dtype='O')
@@ -211,6 +285,66 @@ def test_index_multi():
     assert len(index) == 10
 
 
+def test_index_join():
+    index = index_hash_float64()
+    index.update(np.array([1.0, 2.0, 3.0]), 0)
+    index.update(np.array([1.0, 1.0, 10.0, 3.0]), 3)
+    left = np.array([3.0, 5.0, 1.0])
+    left_indices, right_indices = index.join(left, 100, True)
+    assert left_indices.tolist() == [100, 100, 101, 102, 102, 102]
+    assert right_indices[[0, 1]].tolist() == [2, 6]
+    assert right_indices[2] == -1
+    assert sorted(right_indices[3:].tolist()) == [0, 3, 4]
+    left_indices, right_indices = index.join(left, 100, False)
+    assert left_indices.tolist() == [100, 100, 102, 102, 102]
+    # a missing value has no match, since the index has none
+    left_indices, right_indices = index.join(left, np.array([True, False, False]), 0, True)
+    assert left_indices.tolist() == [0, 1, 2, 2, 2]
+    assert right_indices[:2].tolist() == [-1, -1]
+
+    strings = vaex.strings.array(['aap', 'noot', 'aap'])
+    index = index_hash_string()
+    index.update(strings, 0)
+    left_indices, right_indices = index.join(vaex.strings.array(['mies', 'aap']), 0, True)
+    assert left_indices.tolist() == [0, 1, 1]
+    assert right_indices.tolist() == [-1, 0, 2]
+
+
+def test_combined_keys():
+    x = np.ma.array([1, 2, 1, 1, 7], mask=[False, False, False, False, True])
+    y = np.array([0.5, np.nan, 0.5, -0.0, 0.0])
+    s = vaex.strings.array(['aap', 'noot', 'aap', 'aap', None])
+    keys = combined_keys(5)
+    keys.add_int64(x.data, np.ma.getmaskarray(x))
+    keys.add_float64(y)
+    keys.add_string(s)
+    keys.encode()
+    assert keys.kinds == 'ifs'
+    ordered_set = ordered_set_string()
+    ordered_set.update(keys)
+    assert ordered_set.count == 4
+    ordinals = ordered_set.map_ordinal(keys)
+    assert ordinals[0] == ordinals[2]
+    assert len(set(ordinals[[0, 1, 3, 4]].tolist())) == 4
+    (xs, xmask), (ys, ymask), ss = decode_combined_keys(ordered_set, keys.kinds)
+    assert xs[ordinals[0]] == 1 and xmask[ordinals[4]] and not xmask[ordinals[0]]
+    assert np.isnan(ys[ordinals[1]]) and ys[ordinals[3]] == 0
+    assert ss[ordinals[1]] == 'noot' and ss[ordinals[4]] is None
+
+    # -0 and 0 are the same key, and the index can join on it
+    index = index_hash_string()
+    index.update(keys, 0)
+    left = combined_keys(2)
+    left.add_int64(np.array([1, 1]))
+    left.add_float64(np.array([0.0, 0.5]))
+    left.add_string(vaex.strings.array(['aap', 'aap']))
+    left.encode()
+    left_indices, right_indices = index.join(left, 0, True)
+    assert left_indices.tolist() == [0, 1, 1]
+    assert right_indices[0] == 3
+    assert sorted(right_indices[1:].tolist()) == [0, 2]
+
+
 def test_index_multi_float64():
     floats = np.array([1.0, 2.0, 3.0])
     index = index_hash_float64()
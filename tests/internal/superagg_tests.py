@@ -1,4 +1,5 @@
 import vaex.superagg
+import vaex.utils
 import numpy as np
 import sys
 
@@ -129,4 +130,51 @@ def test_count_1d_object():
     agg_data = np.asarray(agg)
     agg.set_data(y, 0)
     grid.bin([agg])
-    assert agg_data.tolist() == [0, 2, 1, 0, 1, 0, 0, 1]
\ No newline at end of file
+    assert agg_data.tolist() == [0, 2, 1, 0, 1, 0, 0, 1]
+
+
+def test_binner_scalar_vectorized():
+    # long enough to go through the vectorized path, with a tail
+    x = np.arange(-3, 2000 - 3, dtype='f8') / 100
+    x[7] = np.nan
+    mask = (np.arange(len(x)) % 11) == 0
+    for dtype in ['f8', 'f4', 'i8', 'i4', 'u4', 'i2', 'u1']:
+        values = x.astype(dtype) if dtype.startswith('f') else np.nan_to_num(x * 10).astype(dtype)
+        binner = vaex.utils.find_type_from_dtype(vaex.superagg, 'BinnerScalar_', values.dtype)('x', 0, 10, 7)
+        binner.set_data(values)
+        binner.set_data_mask(mask)
+        grid = vaex.superagg.Grid([binner])
+        agg = vaex.superagg.AggCount_float64(grid)
+        grid.bin([agg])
+        values = values.astype('f8')
+        missing = mask | np.isnan(values)
+        scaled = (values[~missing] - 0) * (1 / 10.)
+        bins = np.where(scaled < 0, 1, np.where(scaled >= 1, 7 + 2, np.floor(scaled * 7) + 2)).astype('i8')
+        expected = np.bincount(bins, minlength=7 + 3)
+        expected[0] = missing.sum()
+        assert np.asarray(agg).tolist() == expected.tolist(), dtype
+
+
+def test_fused_ordinal_2d():
+    # a single aggregator takes the fused path, two aggregators the generic path
+    x = np.arange(-2, 3000 - 2, dtype='i8') % 13 - 2
+    y = (np.arange(3000) % 7).astype('i4')
+    v = np.arange(3000, dtype='f8')
+    v[5] = np.nan
+    mask = (np.arange(3000) % 5) != 0
+    def bin(aggs_types):
+        binner1 = vaex.superagg.BinnerOrdinal_int64('x', 9, 0)
+        binner2 = vaex.superagg.BinnerOrdinal_int32('y', 5, 0)
+        binner1.set_data(x)
+        binner2.set_data(y)
+        grid = vaex.superagg.Grid([binner1, binner2])
+        aggs = [agg_type(grid) for agg_type in aggs_types]
+        for agg in aggs:
+            agg.set_data(v, 0)
+            agg.set_data_mask(mask)
+        grid.bin(aggs)
+        return [np.asarray(agg).tolist() for agg in aggs]
+    for agg_type in [vaex.superagg.AggCount_float64, vaex.superagg.AggSum_float64, vaex.superagg.AggMax_float64]:
+        fused, = bin([agg_type])
+        generic, _ = bin([agg_type, vaex.superagg.AggCount_float64])
+        assert fused == generic
@@ -17,3 +17,9 @@ def test_isin():
     assert df.w.isin([2, None]) == [True, False, True]
     assert df.m.isin([1, 2, 3]) == [False, False, True]
     assert df.n.isin([2, np.nan]) == [False, True, False]
+
+
+def test_isin_string_null():
+    df = vaex.from_arrays(s=vaex.string_column(['aap', None, 'mies']))
+    assert df.s.isin(['mies', 'noot']).tolist() == [False, False, True]
+    assert df.s.isin(['mies', None]).tolist() == [False, True, True]
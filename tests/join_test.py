@@ -131,6 +131,22 @@ def test_left_dup():
     # df = df_a.join(df_dup, on='m', rsuffix='_r')
 
 
+def test_inner_dup():
+    df = df_a.join(df_dup, left_on='a', right_on='b', rsuffix='_r', how='inner', allow_duplication=True)
+    # the rows of the left are kept in order
+    assert df.a.tolist() == ['A', 'A', 'B']
+    assert df.b.tolist() == ['A', 'A', 'B']
+    assert df.x_r.tolist() == [2, 2, 1]
+
+
+def test_full_a_b():
+    df = df_a.join(df_b, left_on='a', right_on='b', rsuffix='_r', how='outer')
+    assert df.a.tolist() == ['A', 'B', 'C', None]
+    assert df.b.tolist() == ['A', 'B', None, 'D']
+    assert df.x.tolist() == [0, 1, 2, None]
+    assert df.x_r.tolist() == [2, 1, None, 0]
+
+
 def test_left_a_c():
     df = df_a.join(df_c, left_on='a', right_on='c', how='left')
     assert df.a.tolist() == ['A', 'B', 'C']
@@ -162,7 +178,6 @@ def test_inner_a_d():
     assert df.x2.tolist() == [3.1, 25.]
 
 
-@pytest.mark.skip(reason='full join not supported yet')
 def test_full_a_d():
     df = df_a.join(df_d, on='a', right_on='a', how='full')
     assert df.a.tolist() == ['A', 'B', 'C', 'D']
@@ -174,6 +189,21 @@ def test_full_a_d():
     np.testing.assert_array_equal(np.array(df_d.x2.values), np.array([3.1, 25., np.nan]))
 
 
+def test_join_multiple_keys():
+    df_left = vaex.from_arrays(s=np.array(['a', 'a', 'b', 'b', 'c']), i=np.array([1, 2, 1, 2, 1]), x=np.arange(5))
+    df_right = vaex.from_arrays(t=np.array(['b', 'a', 'a', 'c']), f=np.array([1., 2., 1., 2.]), y=np.array([10, 20, 30, 40]))
+    df = df_left.join(df_right, left_on=['s', 'i'], right_on=['t', 'f'])
+    assert df.x.tolist() == [0, 1, 2, 3, 4]
+    assert df.y.tolist() == [30, 20, 10, None, None]
+    df = df_left.join(df_right, left_on=['s', 'i'], right_on=['t', 'f'], how='inner')
+    assert df.x.tolist() == [0, 1, 2]
+    assert df.y.tolist() == [30, 20, 10]
+    with pytest.raises(ValueError):
+        df_left.join(df_right, left_on=['s', 'i'], right_on=['f', 't'])
+    with pytest.raises(ValueError):
+        df_left.join(df_right, left_on=['s', 'i'], right_on=['t'])
+
+
 def test_left_virtual_filter():
     df = df_a.join(df_d, on='a', how='left', rsuffix='_b')
     df['r'] = df.x + df.x2
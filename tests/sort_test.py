@@ -44,3 +44,68 @@ def test_sort_multikey():
     assert df_sorted_2.x.tolist() ==  [1, 3, 1, 5, 5]
     assert df_sorted_2.y.tolist() ==  [4, 3, 2, 0, 1]
     assert df_sorted_2.z.tolist() == ['cat', 'cat', 'dog', 'dog', 'mouse']
+
+
+def test_sort_descending_stable():
+    x = np.array([1, 2, 1, 2, 3])
+    i = np.arange(5)
+    df = vaex.from_arrays(x=x, i=i)
+    # equal values keep their order, also when descending
+    assert df.sort('x', ascending=False).i.tolist() == [4, 1, 3, 0, 2]
+    assert df.sort(['x', 'i'], ascending=[False, True]).i.tolist() == [4, 1, 3, 0, 2]
+    assert df.sort(['x', 'i'], ascending=[True, False]).i.tolist() == [2, 0, 3, 1, 4]
+
+
+def test_sort_missing():
+    x = np.ma.array([2., np.nan, -1., 5., 0.], mask=[False, False, False, True, False])
+    s = np.array(['b', None, 'ab', 'a', 'b'], dtype=object)
+    t = np.array(['2020-01-02', 'NaT', '2019-12-31', '2020-01-01', '2020-01-01'], dtype='datetime64[D]')
+    i = np.arange(5)
+    df = vaex.from_arrays(x=x, s=s, t=t, i=i)
+    # nan, and then missing values go last (or first)
+    assert df.sort('x').i.tolist() == [2, 4, 0, 1, 3]
+    assert df.sort('x', ascending=False).i.tolist() == [0, 4, 2, 1, 3]
+    assert df.sort('x', na_position='first').i.tolist() == [3, 1, 2, 4, 0]
+    assert df.sort('s').i.tolist() == [3, 2, 0, 4, 1]
+    assert df.sort('s', ascending=False).i.tolist() == [0, 4, 2, 3, 1]
+    assert df.sort('t').i.tolist() == [2, 3, 4, 0, 1]
+    assert df.sort(['s', 'x'], ascending=[True, False]).i.tolist() == [3, 2, 0, 4, 1]
+    with pytest.raises(ValueError):
+        df.sort('x', na_position='middle')
+
+
+def test_sort_object():
+    # objects are sorted by numpy, which cannot sort per expression in a different order, or place missing values
+    o = np.array([3, 1, 2, 0, 1], dtype=object)
+    i = np.arange(5)
+    df = vaex.from_arrays(o=o, i=i)
+    assert df.sort('o').o.tolist() == [0, 1, 1, 2, 3]
+    assert df.sort('o', ascending=False).o.tolist() == [3, 2, 1, 1, 0]
+    with pytest.raises(ValueError):
+        df.sort(['o', 'i'], ascending=[True, False])
+    with pytest.raises(ValueError):
+        df.sort('o', na_position='last')
+
+
+def test_sort_large():
+    # large enough to be sorted by multiple workers, compared to numpy's (stable) lexsort
+    N = 300000
+    rng = np.random.RandomState(42)
+    # strings that only differ after the first 8 bytes (the prefix that is radix sorted)
+    s = np.array(['prefix__%d' % k for k in rng.randint(0, 200, N)])
+    x = rng.randint(-5, 5, N)
+    f = np.round(rng.normal(size=N), 1)
+    f[rng.random_sample(N) < 0.05] = np.nan
+    mask = rng.random_sample(N) < 0.05
+    i = np.arange(N)
+    df = vaex.from_arrays(s=s, x=x, f=np.ma.array(f, mask=mask), i=i)
+
+    # values, then nan, then missing values
+    f_class = np.where(mask, 2, np.where(np.isnan(f), 1, 0))
+    f_value = np.where(f_class == 0, f, 0)
+    expected = np.lexsort((f_value, f_class, -x, s))
+    assert df.sort(['s', 'x', 'f'], ascending=[True, False, True]).i.tolist() == expected.tolist()
+    expected = np.lexsort((f_value, 2 - f_class, -x, s))
+    assert df.sort(['s', 'x', 'f'], ascending=[True, False, True], na_position='first').i.tolist() == expected.tolist()
+    expected = np.lexsort((i, f_value, f_class))
+    assert df.sort('f').i.tolist() == expected.tolist()
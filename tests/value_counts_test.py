@@ -33,6 +33,31 @@ def test_value_counts_object():
     assert len(ds.obj.value_counts(dropmissing=False)) == 18
 
 
+
+def test_value_counts_object_typed():
+    # chunks of 3 rows: only str, only int, only float, and mixed (which are hashed as objects)
+    x = np.array(['aap', 'noot', 'aap', 1, 2, 1, 1.5, np.nan, 2.5, 'noot', 1, None], dtype=object)
+    df = vaex.from_arrays(x=x)
+    assert vaex.superutils.classify_objects(x[:3]) == 'str'
+    assert vaex.superutils.classify_objects(x[3:6]) == 'int'
+    assert vaex.superutils.classify_objects(x[6:9]) == 'float'
+    assert vaex.superutils.classify_objects(x[9:]) == ''
+    assert vaex.superutils.classify_objects(x[9:], np.array([False, False, True])) == ''
+    assert vaex.superutils.classify_objects(x[9:], np.array([False, True, True])) == 'str'
+    with small_buffer(df, size=3):
+        counts = df.x.value_counts(dropnan=True)
+        assert counts.to_dict() == {'aap': 2, 'noot': 2, 1: 3, 2: 1, 1.5: 1, 2.5: 1, 'missing': 1}
+        assert len(df.x.value_counts()) == 8
+        assert df.count(df.x) == 10
+        dfg = df.groupby(df.x, agg='count')
+        assert sorted(map(str, dfg.x.tolist())) == sorted(map(str, ['aap', 'noot', 1, 2, 1.5, 2.5, np.nan, None]))
+    df = vaex.from_arrays(x=np.array(['aap', 'noot', 'aap', 'mies'], dtype=object))
+    with small_buffer(df, size=3):
+        assert isinstance(df._set(df.x), vaex.superutils.ordered_set_string)
+        dfg = df.groupby(df.x, agg='count').sort('x')
+        assert dfg.x.tolist() == ['aap', 'mies', 'noot']
+        assert dfg['count'].tolist() == [2, 1, 1]
+
 @pytest.mark.parametrize("dropna", [True, False])
 def test_value_counts_with_pandas(ds_local, dropna):
     ds = ds_local